@@ -0,0 +1,230 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "Rational.h"
+#include "RationalAccumulator.h"
+#include "Overflow.h"
+using namespace std;
+
+namespace RationalAtomics {
+
+/* An unsigned integer type holding two T, so that the numerator and the
+   denominator are read and written together */
+template <size_t Size>
+struct PackedWord;
+template <>
+struct PackedWord<1> {
+  typedef uint16_t Type;
+};
+template <>
+struct PackedWord<2> {
+  typedef uint32_t Type;
+};
+template <>
+struct PackedWord<4> {
+  typedef uint64_t Type;
+};
+
+/* Which thread this is, 0, 1, 2... in the order threads first ask */
+inline size_t ThreadIndex() {
+  static atomic<size_t> next(0);
+  static thread_local size_t index = next.fetch_add(1, memory_order_relaxed);
+  return index;
+}
+
+}
+
+/*
+ * A Rational<T> that threads can update concurrently without a lock. The
+ * numerator and the denominator are packed into one word that is replaced
+ * with a compare and swap, so T can be at most 32 bits wide (64 bit types
+ * would need a 128 bit compare and swap, which isn't lock-free everywhere).
+ *
+ * Adding a value with the same denominator as the stored one adds the
+ * numerators and nothing else, leaving the sum unreduced. Otherwise adding
+ * first tries the Rational operator on the stored value, reduced, so the sum
+ * is reduced. If another thread changed the value in the meantime, the
+ * retries skip the reduction and store the sum unreduced as long as it fits
+ * in T, so that the time between reading and swapping is as short as
+ * possible. Load() always returns the value reduced. Where an unreduced sum
+ * doesn't fit, the stored value is reduced first, and the result is that of
+ * the Rational operator.
+ */
+template <typename T>
+class AtomicRational {
+  static_assert(sizeof(T) <= 4, "AtomicRational: T can be at most 32 bits wide");
+  typedef typename RationalAtomics::PackedWord<sizeof(T)>::Type Word;
+  typedef typename IntTraits::Unsigned<T>::Type UnsignedType;
+  static const int Bits = 8 * sizeof(T);
+
+private:
+  atomic<Word> word;
+
+  static Word Pack(T numerator, T denominator) {
+    return Word(Word(UnsignedType(numerator)) << Bits | Word(UnsignedType(denominator)));
+  }
+  static T Numerator(Word w) { return T(UnsignedType(w >> Bits)); }
+  static T Denominator(Word w) { return T(UnsignedType(w)); }
+  static Word Pack(const Rational<T>& r) { return Pack(r.numerator, r.denominator); }
+  /* The value of w, reduced */
+  static Rational<T> Unpack(Word w) { return Rational<T>(Numerator(w), Denominator(w)); }
+
+  /* n/d + c/e unreduced, false if it doesn't fit. d and e are positive. */
+  static bool AddUnreduced(Word w, T c, T e, Word& out) {
+    T n = Numerator(w), d = Denominator(w), sum, x, y, den;
+    if (d == e) {
+      if (Overflow::Add(n, c, sum))
+        return false;
+      out = Pack(sum, d);
+      return true;
+    }
+    if (Overflow::Mul(n, e, x) || Overflow::Mul(c, d, y) ||
+        Overflow::Add(x, y, sum) || Overflow::Mul(d, e, den))
+      return false;
+    out = Pack(sum, den);
+    return true;
+  }
+
+  /* w + r by the Rational operator, on w reduced first: the operator only
+     gives a reduced result that fits for reduced operands */
+  static Word Reduced(Word w, const Rational<T>& r) {
+    Rational<T> sum = Unpack(w);
+    sum += r;
+    return Pack(sum);
+  }
+
+  /* Adds r and returns the previous value, as it was stored */
+  Word Update(const Rational<T>& r, memory_order order) {
+    // Over an equal denominator the numerators are just added. Otherwise the
+    // first attempt reduces, so that the stored value stays reduced while
+    // there is no contention.
+    Word current = word.load(memory_order_relaxed), next;
+    if (Denominator(current) != r.denominator ||
+        !AddUnreduced(current, r.numerator, r.denominator, next))
+      next = Reduced(current, r);
+    while (!word.compare_exchange_weak(current, next, order, memory_order_relaxed))
+      if (!AddUnreduced(current, r.numerator, r.denominator, next))
+        next = Reduced(current, r);
+    return current;
+  }
+public:
+  /* Constructors */
+  AtomicRational(const Rational<T>& r = Rational<T>()): word(Pack(r)) { }
+  AtomicRational(const AtomicRational&) = delete;
+  AtomicRational& operator=(const AtomicRational&) = delete;
+
+  bool IsLockFree() const { return word.is_lock_free(); }
+
+  Rational<T> Load(memory_order order = memory_order_seq_cst) const {
+    return Unpack(word.load(order));
+  }
+  operator Rational<T>() const { return Load(); }
+
+  void Store(const Rational<T>& r, memory_order order = memory_order_seq_cst) {
+    word.store(Pack(r), order);
+  }
+  AtomicRational& operator=(const Rational<T>& r) {
+    Store(r);
+    return *this;
+  }
+
+  /* Replaces the value by r and returns the previous one */
+  Rational<T> Exchange(const Rational<T>& r, memory_order order = memory_order_seq_cst) {
+    return Unpack(word.exchange(Pack(r), order));
+  }
+
+  /*
+   * Replaces the value by desired if it equals expected and returns true.
+   * Otherwise sets expected to the value and returns false. The values are
+   * compared, not their representations, so an unreduced value that equals
+   * expected is replaced.
+   */
+  bool CompareExchange(Rational<T>& expected, const Rational<T>& desired,
+                       memory_order order = memory_order_seq_cst) {
+    Word current = word.load(memory_order_relaxed);
+    for (;;) {
+      Rational<T> value = Unpack(current);
+      if (value != expected) {
+        expected = value;
+        return false;
+      }
+      if (word.compare_exchange_weak(current, Pack(desired), order, memory_order_relaxed))
+        return true;
+    }
+  }
+
+  /* Adds r and returns the previous value */
+  Rational<T> FetchAdd(const Rational<T>& r, memory_order order = memory_order_seq_cst) {
+    return Unpack(Update(r, order));
+  }
+
+  /* Adds r, without reducing the previous value to return it */
+  void Add(const Rational<T>& r, memory_order order = memory_order_seq_cst) {
+    Update(r, order);
+  }
+
+  /* Subtracts r and returns the previous value */
+  Rational<T> FetchSub(const Rational<T>& r, memory_order order = memory_order_seq_cst) {
+    return FetchAdd(-r, order);
+  }
+
+  /* Return the new value, like the operators of atomic */
+  Rational<T> operator+=(const Rational<T>& r) { return FetchAdd(r) + r; }
+  Rational<T> operator-=(const Rational<T>& r) { return FetchSub(r) - r; }
+};
+
+/*
+ * A sum that many threads add to, kept as Shards separate AtomicRationals
+ * on their own cache lines. Each thread adds to the shard of its thread
+ * index, so threads on different cores rarely write to the same line, and
+ * Load() merges the shards. Load() isn't a snapshot: adds that run
+ * concurrently with it may or may not be included.
+ */
+template <typename T, size_t Shards = 16>
+class ShardedRational {
+private:
+  struct alignas(64) Shard {
+    AtomicRational<T> value;
+  };
+  Shard shards[Shards];
+
+  AtomicRational<T>& Local() { return shards[RationalAtomics::ThreadIndex() % Shards].value; }
+public:
+  /* Constructors */
+  ShardedRational(const Rational<T>& r = Rational<T>()) { shards[0].value.Store(r); }
+  ShardedRational(const ShardedRational&) = delete;
+  ShardedRational& operator=(const ShardedRational&) = delete;
+
+  void Add(const Rational<T>& r, memory_order order = memory_order_relaxed) {
+    Local().Add(r, order);
+  }
+  void Subtract(const Rational<T>& r, memory_order order = memory_order_relaxed) {
+    Local().Add(-r, order);
+  }
+  ShardedRational& operator+=(const Rational<T>& r) {
+    Add(r);
+    return *this;
+  }
+  ShardedRational& operator-=(const Rational<T>& r) {
+    Subtract(r);
+    return *this;
+  }
+
+  /* The sum of the shards */
+  Rational<T> Load(memory_order order = memory_order_seq_cst) const {
+    RationalAccumulator<T> sum;
+    for (const Shard& shard : shards)
+      sum += shard.value.Load(order);
+    return sum.Value();
+  }
+  operator Rational<T>() const { return Load(); }
+
+  /* Sets the sum to r. Adds that run concurrently with it may be lost. */
+  void Store(const Rational<T>& r) {
+    for (Shard& shard : shards)
+      shard.value.Store(Rational<T>());
+    shards[0].value.Store(r);
+  }
+};
@@ -0,0 +1,636 @@
+#pragma once
+
+#include <cctype>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Rational.h"
+#include "Overflow.h"
+using namespace std;
+
+/*
+ * Arbitrary precision signed integer. Values that fit in a long long are
+ * stored inline and computed on with the built in operations (with overflow
+ * detection); only values that outgrow a long long spill to a heap allocated
+ * magnitude of 32 bit limbs. Division truncates towards zero and the
+ * remainder takes the sign of the dividend, as for built in integers.
+ *
+ * BigInt provides the operations Rational<T> needs, so Rational<BigInt> (see
+ * BigRational below) is an exact rational number that never overflows.
+ */
+class BigInt {
+public:
+  typedef uint32_t Limb;
+  typedef uint64_t DoubleLimb;
+  typedef vector<Limb> Magnitude;
+
+private:
+  /* The value if limbs is empty */
+  long long small;
+  /* Otherwise the magnitude, least significant limb first, no leading
+     zeros, and the sign. Values that fit in small are never stored here. */
+  Magnitude limbs;
+  bool negative;
+
+  /* Widest built in unsigned type, used to convert from built in integers */
+#ifdef RATIONAL_HAS_INT128
+  typedef IntTraits::UInt128 UWide;
+#else
+  typedef unsigned long long UWide;
+#endif
+
+  bool IsSmall() const { return limbs.empty(); }
+  bool IsNegative() const { return IsSmall() ? small < 0 : negative; }
+
+  /* Sets this to the value with the given sign and magnitude */
+  void Assign(bool negative, UWide magnitude);
+  void Assign(bool negative, Magnitude& magnitude);
+
+  /* The magnitude of the value, in limbs */
+  void GetMagnitude(Magnitude& out) const;
+
+  /* The low bits of the value in two's complement */
+  UWide LowBits() const;
+
+  BigInt& AddSlow(const BigInt& right, bool subtract);
+  BigInt& MulSlow(const BigInt& right);
+  void DivModSlow(const BigInt& right, BigInt* quotient, BigInt* remainder) const;
+
+  /* Magnitude arithmetic */
+  static int CompareMagnitude(const Magnitude& a, const Magnitude& b);
+  static void AddMagnitude(const Magnitude& a, const Magnitude& b, Magnitude& out);
+  static void SubMagnitude(const Magnitude& a, const Magnitude& b, Magnitude& out);
+  static void MulMagnitude(const Magnitude& a, const Magnitude& b, Magnitude& out);
+  static Limb DivModLimb(const Magnitude& a, Limb b, Magnitude& quotient);
+  static void DivModMagnitude(const Magnitude& a, const Magnitude& b,
+                              Magnitude& quotient, Magnitude& remainder);
+  static void Trim(Magnitude& a);
+
+public:
+  /* Constructors. Any built in integer converts implicitly. */
+  BigInt(): small(0), negative(false) { }
+
+  template <typename I>
+  BigInt(I value,
+         typename enable_if<IntTraits::IsInteger<I>::value>::type* = 0):
+    small(0), negative(false) {
+    if (IntTraits::IsSigned<I>::value && value < I(0))
+      Assign(true, UWide(0) - UWide(value));
+    else
+      Assign(false, UWide(value));
+  }
+
+  /* Parses an optionally signed decimal number */
+  explicit BigInt(const string& digits);
+
+  /* Overloaded compound-assignment operators */
+  BigInt& operator+=(const BigInt& right) {
+    long long sum;
+    if (IsSmall() && right.IsSmall() && !Overflow::Add(small, right.small, sum)) {
+      small = sum;
+      return *this;
+    }
+    return AddSlow(right, false);
+  }
+  BigInt& operator-=(const BigInt& right) {
+    long long difference;
+    if (IsSmall() && right.IsSmall() &&
+        !Overflow::Sub(small, right.small, difference)) {
+      small = difference;
+      return *this;
+    }
+    return AddSlow(right, true);
+  }
+  BigInt& operator*=(const BigInt& right) {
+    long long product;
+    if (IsSmall() && right.IsSmall() &&
+        !Overflow::Mul(small, right.small, product)) {
+      small = product;
+      return *this;
+    }
+    return MulSlow(right);
+  }
+  BigInt& operator/=(const BigInt& right) {
+    if (IsSmall() && right.IsSmall() && right.small != 0 &&
+        !(right.small == -1 && small == numeric_limits<long long>::min())) {
+      small /= right.small;
+      return *this;
+    }
+    DivModSlow(right, this, 0);
+    return *this;
+  }
+  BigInt& operator%=(const BigInt& right) {
+    if (IsSmall() && right.IsSmall() && right.small != 0) {
+      small = right.small == -1 ? 0 : small % right.small;
+      return *this;
+    }
+    DivModSlow(right, 0, this);
+    return *this;
+  }
+
+  BigInt operator-() const {
+    BigInt out = *this;
+    if (out.IsSmall() && out.small != numeric_limits<long long>::min())
+      out.small = -out.small;
+    else if (out.IsSmall())
+      out.Assign(false, UWide(1) << 63);
+    else
+      out.negative = !out.negative;
+    return out;
+  }
+
+  /* Comparison, returns a negative value, zero or a positive value */
+  int Compare(const BigInt& right) const;
+
+  /* Sign of the value: -1, 0 or 1 */
+  int Sign() const {
+    if (IsSmall())
+      return small < 0 ? -1 : (small > 0 ? 1 : 0);
+    return negative ? -1 : 1;
+  }
+
+  /* Hash of the value, for std::hash<BigInt>. Values are stored in only one
+     form, so equal values hash the same. */
+  size_t Hash() const;
+
+  /* True if the value is stored inline (fits in a long long) */
+  bool FitsInline() const { return IsSmall(); }
+
+  /* Number of significant bits of the magnitude */
+  int BitLength() const;
+
+  /* Decimal representation */
+  string ToString() const;
+
+  /* Conversions. Conversion to built in integers keeps the low bits, like a
+     conversion between built in integers does. */
+  template <typename I,
+            typename = typename enable_if<IntTraits::IsInteger<I>::value>::type>
+  explicit operator I() const { return I(LowBits()); }
+  explicit operator double() const;
+
+  friend BigInt operator+(BigInt left, const BigInt& right) { return left += right; }
+  friend BigInt operator-(BigInt left, const BigInt& right) { return left -= right; }
+  friend BigInt operator*(BigInt left, const BigInt& right) { return left *= right; }
+  friend BigInt operator/(BigInt left, const BigInt& right) { return left /= right; }
+  friend BigInt operator%(BigInt left, const BigInt& right) { return left %= right; }
+
+  friend bool operator==(const BigInt& left, const BigInt& right) {
+    if (left.IsSmall() || right.IsSmall())
+      return left.IsSmall() && right.IsSmall() && left.small == right.small;
+    return left.negative == right.negative && left.limbs == right.limbs;
+  }
+  friend bool operator!=(const BigInt& left, const BigInt& right) { return !(left == right); }
+  friend bool operator<(const BigInt& left, const BigInt& right) { return left.Compare(right) < 0; }
+  friend bool operator>(const BigInt& left, const BigInt& right) { return left.Compare(right) > 0; }
+  friend bool operator<=(const BigInt& left, const BigInt& right) { return left.Compare(right) <= 0; }
+  friend bool operator>=(const BigInt& left, const BigInt& right) { return left.Compare(right) >= 0; }
+};
+
+inline void BigInt::Assign(bool negative, UWide magnitude) {
+  limbs.clear();
+  if (negative ? magnitude <= (UWide(1) << 63)
+               : magnitude <= UWide(numeric_limits<long long>::max())) {
+    unsigned long long low = (unsigned long long) magnitude;
+    small = (long long) (negative ? 0 - low : low);
+    return;
+  }
+  for (; magnitude != 0; magnitude >>= 32)
+    limbs.push_back(Limb(magnitude));
+  this->negative = negative;
+}
+
+inline void BigInt::Assign(bool negative, Magnitude& magnitude) {
+  Trim(magnitude);
+  if (magnitude.size() <= 2) {
+    UWide value = 0;
+    for (size_t i = magnitude.size(); i-- > 0;)
+      value = (value << 32) | magnitude[i];
+    Assign(negative, value);
+    return;
+  }
+  limbs.swap(magnitude);
+  this->negative = negative;
+}
+
+inline void BigInt::GetMagnitude(Magnitude& out) const {
+  if (!IsSmall()) {
+    out = limbs;
+    return;
+  }
+  out.clear();
+  unsigned long long magnitude = small < 0 ? 0 - (unsigned long long) small
+                                           : (unsigned long long) small;
+  for (; magnitude != 0; magnitude >>= 32)
+    out.push_back(Limb(magnitude));
+}
+
+inline BigInt::UWide BigInt::LowBits() const {
+  if (IsSmall())
+    return UWide(small);
+  UWide value = 0;
+  for (size_t i = limbs.size() < sizeof(UWide) / sizeof(Limb)
+                    ? limbs.size() : sizeof(UWide) / sizeof(Limb); i-- > 0;)
+    value = (value << 32) | limbs[i];
+  return negative ? 0 - value : value;
+}
+
+inline BigInt::BigInt(const string& digits): small(0), negative(false) {
+  size_t i = 0;
+  bool minus = false;
+  if (i < digits.size() && (digits[i] == '-' || digits[i] == '+'))
+    minus = digits[i++] == '-';
+  if (i == digits.size())
+    throw invalid_argument("BigInt: no digits");
+
+  // Nine digits at a time
+  Magnitude magnitude;
+  for (; i < digits.size();) {
+    Limb chunk = 0, scale = 1;
+    for (int n = 0; n < 9 && i < digits.size(); ++n, ++i) {
+      if (!isdigit((unsigned char) digits[i]))
+        throw invalid_argument("BigInt: not a digit");
+      chunk = chunk * 10 + Limb(digits[i] - '0');
+      scale *= 10;
+    }
+    DoubleLimb carry = chunk;
+    for (size_t k = 0; k < magnitude.size(); ++k) {
+      carry += DoubleLimb(magnitude[k]) * scale;
+      magnitude[k] = Limb(carry);
+      carry >>= 32;
+    }
+    if (carry != 0)
+      magnitude.push_back(Limb(carry));
+  }
+  Assign(minus, magnitude);
+}
+
+inline int BigInt::Compare(const BigInt& right) const {
+  if (IsSmall() && right.IsSmall())
+    return small < right.small ? -1 : (small > right.small ? 1 : 0);
+  // A large value is always further from zero than a small one
+  bool leftNegative = IsNegative(), rightNegative = right.IsNegative();
+  if (leftNegative != rightNegative)
+    return leftNegative ? -1 : 1;
+  int magnitude;
+  if (IsSmall())
+    magnitude = -1;
+  else if (right.IsSmall())
+    magnitude = 1;
+  else
+    magnitude = CompareMagnitude(limbs, right.limbs);
+  return leftNegative ? -magnitude : magnitude;
+}
+
+inline int BigInt::BitLength() const {
+  Magnitude magnitude;
+  GetMagnitude(magnitude);
+  if (magnitude.empty())
+    return 0;
+  int bits = 32 * int(magnitude.size() - 1);
+  for (Limb top = magnitude.back(); top != 0; top >>= 1)
+    ++bits;
+  return bits;
+}
+
+inline string BigInt::ToString() const {
+  if (IsSmall())
+    return to_string(small);
+  // Nine digits at a time, least significant first
+  Magnitude magnitude = limbs, quotient;
+  string reversed;
+  while (!magnitude.empty()) {
+    Limb chunk = DivModLimb(magnitude, 1000000000, quotient);
+    magnitude.swap(quotient);
+    for (int n = 0; n < 9 && (chunk != 0 || !magnitude.empty()); ++n) {
+      reversed += char('0' + chunk % 10);
+      chunk /= 10;
+    }
+  }
+  if (negative)
+    reversed += '-';
+  return string(reversed.rbegin(), reversed.rend());
+}
+
+inline BigInt::operator double() const {
+  if (IsSmall())
+    return (double) small;
+  double value = 0;
+  for (size_t i = limbs.size(); i-- > 0;)
+    value = value * 4294967296.0 + limbs[i];
+  return negative ? -value : value;
+}
+
+inline BigInt& BigInt::AddSlow(const BigInt& right, bool subtract) {
+  Magnitude a, b, out;
+  GetMagnitude(a);
+  right.GetMagnitude(b);
+  bool leftNegative = IsNegative();
+  bool rightNegative = right.IsNegative() != subtract;
+  if (leftNegative == rightNegative) {
+    AddMagnitude(a, b, out);
+    Assign(leftNegative, out);
+  }
+  else if (CompareMagnitude(a, b) >= 0) {
+    SubMagnitude(a, b, out);
+    Assign(leftNegative, out);
+  }
+  else {
+    SubMagnitude(b, a, out);
+    Assign(rightNegative, out);
+  }
+  return *this;
+}
+
+inline BigInt& BigInt::MulSlow(const BigInt& right) {
+  Magnitude a, b, out;
+  GetMagnitude(a);
+  right.GetMagnitude(b);
+  MulMagnitude(a, b, out);
+  Assign(IsNegative() != right.IsNegative(), out);
+  return *this;
+}
+
+inline void BigInt::DivModSlow(const BigInt& right, BigInt* quotient,
+                               BigInt* remainder) const {
+  if (right.Sign() == 0)
+    throw domain_error("BigInt: division by zero");
+  Magnitude a, b, q, r;
+  GetMagnitude(a);
+  right.GetMagnitude(b);
+  DivModMagnitude(a, b, q, r);
+  bool leftNegative = IsNegative(), rightNegative = right.IsNegative();
+  if (quotient)
+    quotient->Assign(leftNegative != rightNegative, q);
+  if (remainder)
+    remainder->Assign(leftNegative, r);
+}
+
+inline void BigInt::Trim(Magnitude& a) {
+  while (!a.empty() && a.back() == 0)
+    a.pop_back();
+}
+
+inline int BigInt::CompareMagnitude(const Magnitude& a, const Magnitude& b) {
+  if (a.size() != b.size())
+    return a.size() < b.size() ? -1 : 1;
+  for (size_t i = a.size(); i-- > 0;)
+    if (a[i] != b[i])
+      return a[i] < b[i] ? -1 : 1;
+  return 0;
+}
+
+inline void BigInt::AddMagnitude(const Magnitude& a, const Magnitude& b,
+                                 Magnitude& out) {
+  const Magnitude& longer = a.size() >= b.size() ? a : b;
+  const Magnitude& shorter = a.size() >= b.size() ? b : a;
+  out.resize(longer.size() + 1);
+  DoubleLimb carry = 0;
+  for (size_t i = 0; i < longer.size(); ++i) {
+    carry += DoubleLimb(longer[i]) + (i < shorter.size() ? shorter[i] : 0);
+    out[i] = Limb(carry);
+    carry >>= 32;
+  }
+  out[longer.size()] = Limb(carry);
+  Trim(out);
+}
+
+/* a >= b */
+inline void BigInt::SubMagnitude(const Magnitude& a, const Magnitude& b,
+                                 Magnitude& out) {
+  out.resize(a.size());
+  DoubleLimb borrow = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    DoubleLimb subtrahend = (i < b.size() ? b[i] : 0) + borrow;
+    borrow = DoubleLimb(a[i]) < subtrahend ? 1 : 0;
+    out[i] = Limb(DoubleLimb(a[i]) - subtrahend);
+  }
+  Trim(out);
+}
+
+inline void BigInt::MulMagnitude(const Magnitude& a, const Magnitude& b,
+                                 Magnitude& out) {
+  out.assign(a.size() + b.size(), 0);
+  for (size_t i = 0; i < a.size(); ++i) {
+    DoubleLimb carry = 0;
+    for (size_t j = 0; j < b.size(); ++j) {
+      carry += DoubleLimb(a[i]) * b[j] + out[i + j];
+      out[i + j] = Limb(carry);
+      carry >>= 32;
+    }
+    out[i + b.size()] = Limb(carry);
+  }
+  Trim(out);
+}
+
+inline BigInt::Limb BigInt::DivModLimb(const Magnitude& a, Limb b,
+                                       Magnitude& quotient) {
+  quotient.resize(a.size());
+  DoubleLimb remainder = 0;
+  for (size_t i = a.size(); i-- > 0;) {
+    remainder = (remainder << 32) | a[i];
+    quotient[i] = Limb(remainder / b);
+    remainder %= b;
+  }
+  Trim(quotient);
+  return Limb(remainder);
+}
+
+/*
+ * Long division of magnitudes (Knuth, TAOCP 4.3.1, algorithm D).
+ */
+inline void BigInt::DivModMagnitude(const Magnitude& a, const Magnitude& b,
+                                    Magnitude& quotient, Magnitude& remainder) {
+  if (CompareMagnitude(a, b) < 0) {
+    quotient.clear();
+    remainder = a;
+    return;
+  }
+  if (b.size() == 1) {
+    Limb r = DivModLimb(a, b[0], quotient);
+    remainder.clear();
+    if (r != 0)
+      remainder.push_back(r);
+    return;
+  }
+
+  // Normalize so that the top bit of the divisor is set
+  size_t n = b.size(), m = a.size() - n;
+  int shift = 0;
+  for (Limb top = b.back(); !(top & 0x80000000u); top <<= 1)
+    ++shift;
+  Magnitude v(n), u(a.size() + 1);
+  for (size_t i = n; i-- > 0;)
+    v[i] = (b[i] << shift) | (shift && i ? b[i - 1] >> (32 - shift) : 0);
+  u[a.size()] = shift ? a.back() >> (32 - shift) : 0;
+  for (size_t i = a.size(); i-- > 0;)
+    u[i] = (a[i] << shift) | (shift && i ? a[i - 1] >> (32 - shift) : 0);
+
+  quotient.assign(m + 1, 0);
+  const DoubleLimb base = DoubleLimb(1) << 32;
+  for (size_t j = m + 1; j-- > 0;) {
+    // Estimate the quotient digit from the top two limbs
+    DoubleLimb top = (DoubleLimb(u[j + n]) << 32) | u[j + n - 1];
+    DoubleLimb qhat = top / v[n - 1], rhat = top % v[n - 1];
+    while (qhat >= base ||
+           qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])) {
+      --qhat;
+      rhat += v[n - 1];
+      if (rhat >= base)
+        break;
+    }
+
+    // Multiply and subtract
+    long long borrow = 0, t;
+    for (size_t i = 0; i < n; ++i) {
+      DoubleLimb p = qhat * v[i];
+      t = (long long) u[i + j] - borrow - (long long) (p & 0xFFFFFFFFu);
+      u[i + j] = Limb(t);
+      borrow = (long long) (p >> 32) - (t >> 32);
+    }
+    t = (long long) u[j + n] - borrow;
+    u[j + n] = Limb(t);
+
+    // Add back if the estimate was one too large
+    quotient[j] = Limb(qhat);
+    if (t < 0) {
+      --quotient[j];
+      DoubleLimb carry = 0;
+      for (size_t i = 0; i < n; ++i) {
+        carry += DoubleLimb(u[i + j]) + v[i];
+        u[i + j] = Limb(carry);
+        carry >>= 32;
+      }
+      u[j + n] = Limb(u[j + n] + carry);
+    }
+  }
+  Trim(quotient);
+
+  // Unnormalize the remainder
+  remainder.resize(n);
+  for (size_t i = 0; i < n; ++i)
+    remainder[i] = (u[i] >> shift) | (shift ? u[i + 1] << (32 - shift) : 0);
+  Trim(remainder);
+}
+
+inline size_t BigInt::Hash() const {
+  if (IsSmall())
+    return size_t(RationalHashing::Mix((unsigned long long) small));
+  unsigned long long h = negative ? 1 : 0;
+  for (Limb limb : limbs)
+    h = RationalHashing::Mix(h ^ limb);
+  return size_t(h);
+}
+
+// Overloaded stream operators
+// ===========================
+
+inline ostream& operator<<(ostream& os, const BigInt& value) {
+  return os << value.ToString();
+}
+
+inline istream& operator>>(istream& is, BigInt& value) {
+  string digits;
+  is >> ws;
+  if (is.peek() == '-' || is.peek() == '+')
+    digits += char(is.get());
+  while (isdigit(is.peek()))
+    digits += char(is.get());
+  if (digits.empty() || !isdigit((unsigned char) digits[digits.size() - 1])) {
+    is.setstate(ios::failbit);
+    return is;
+  }
+  value = BigInt(digits);
+  return is;
+}
+
+// Traits
+// ======
+
+namespace std {
+
+template <>
+class numeric_limits<BigInt> {
+public:
+  static const bool is_specialized = true;
+  static const bool is_signed = true;
+  static const bool is_integer = true;
+  static const bool is_exact = true;
+  static const bool is_bounded = false;
+  static const bool is_modulo = false;
+  static const int radix = 2;
+  static const int digits = 0;
+  static const int digits10 = 0;
+};
+
+template <>
+struct hash<BigInt> {
+  size_t operator()(const BigInt& value) const { return value.Hash(); }
+};
+
+}
+
+namespace IntTraits {
+
+/* BigInt is the largest type of any pair it is part of, whether the other
+   type is signed or not */
+template <typename U>
+struct LargestType<BigInt, U, false> {
+  typedef BigInt Type;
+};
+template <typename U>
+struct LargestType<BigInt, U, true> {
+  typedef BigInt Type;
+};
+template <typename T>
+struct LargestType<T, BigInt, false> {
+  typedef BigInt Type;
+};
+template <typename T>
+struct LargestType<T, BigInt, true> {
+  typedef BigInt Type;
+};
+template <>
+struct LargestType<BigInt, BigInt, false> {
+  typedef BigInt Type;
+};
+
+}
+
+namespace GcdTraits {
+
+/* GCD for BigInt: binary GCD on the magnitudes while both operands are
+   stored inline, Euclid (on the BigInt operations, which shrink back to the
+   inline representation as the remainders get small) otherwise */
+struct BigIntGcd {
+  static BigInt Gcd(BigInt a, BigInt b) {
+    while (!a.FitsInline() || !b.FitsInline()) {
+      if (b.Sign() == 0)
+        return a.Sign() < 0 ? -a : a;
+      BigInt temp = a % b;
+      a = b;
+      b = temp;
+    }
+    long long x = (long long) a, y = (long long) b;
+    unsigned long long u = x < 0 ? 0 - (unsigned long long) x : (unsigned long long) x;
+    unsigned long long v = y < 0 ? 0 - (unsigned long long) y : (unsigned long long) y;
+    return BinaryGcd(u, v);
+  }
+};
+
+template <>
+struct Engine<BigInt> {
+  typedef BigIntGcd Type;
+};
+
+}
+
+/*
+ * An exact rational number of arbitrary size. Uses the Rational template and
+ * its operators unchanged.
+ */
+typedef Rational<BigInt> BigRational;
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <iostream>
+#include <stdexcept>
+#include "Rational.h"
+#include "Overflow.h"
+using namespace std;
+
+/*
+ * Overflow policies for CheckedRational. A policy is a base class of the
+ * CheckedRational and is told about every overflow through Overflowed(). The
+ * value of a CheckedRational after an overflow is what the unchecked Rational
+ * would have produced.
+ */
+namespace OverflowPolicy {
+
+/* Throws overflow_error. Costs nothing in size. */
+struct Throw {
+  void OnOverflow() { throw overflow_error("Rational overflow"); }
+  void Merge(const Throw&) { }
+  bool Overflowed() const { return false; }
+};
+
+/* Sets a sticky flag, which is carried over to the results of arithmetic with
+   the flagged value */
+struct Flag {
+  Flag(): overflowed(false) { }
+  void OnOverflow() { overflowed = true; }
+  void Merge(const Flag& other) { overflowed = overflowed || other.overflowed; }
+  bool Overflowed() const { return overflowed; }
+  void ClearOverflow() { overflowed = false; }
+private:
+  bool overflowed;
+};
+
+}
+
+/*
+ * A Rational that detects overflow instead of silently truncating. The same
+ * algorithms as Rational are used (cross cancelling and Knuth's addition, see
+ * Rational.h), but each step that may not fit in T is checked, and Policy is
+ * notified if it doesn't. Products of two T values are computed in NextType,
+ * so where a wider type exists the only checks left in the common case are
+ * the final narrowing to T. Where NextType is T itself the detection is
+ * conservative: an intermediate product that overflows is reported even if
+ * the reduced result would have fitted. Division by zero is reported as an
+ * overflow too.
+ */
+template <typename T, typename Policy = OverflowPolicy::Throw>
+class CheckedRational: public Policy {
+  typedef typename IntTraits::NextType<T>::Type NextType;
+
+private:
+  Rational<T> value;
+
+  /* Notifies the policy if overflow is true */
+  void Check(bool overflow) {
+    if (overflow)
+      this->OnOverflow();
+  }
+
+  /* Stores n/d, which must already be reduced. The sign is moved to the
+     numerator, as a Gcd() engine may return a negative GCD. */
+  CheckedRational& AssignReduced(T n, T d) {
+    if (d < 0) {
+      Check(Overflow::Sub(T(0), n, n));
+      Check(Overflow::Sub(T(0), d, d));
+    }
+    value.numerator = n;
+    value.denominator = d;
+    return *this;
+  }
+
+  /* Adds c/d (d positive) to this, see Rational<T>::Add() */
+  CheckedRational& Add(NextType c, T d);
+public:
+  /* Constructors. Simplification can overflow only when the sign is moved
+     to a numerator that is the minimum value of T. A denominator of 0 is
+     reported, and the value is left as Rational would leave it. */
+  CheckedRational(T numerator = 0, T denominator = 1);
+
+  CheckedRational(const Rational<T>& r): value(r) { }
+
+  /* Sets the numerator and denominator of this CheckedRational */
+  CheckedRational& Set(T numerator, T denominator) {
+    return *this = CheckedRational(numerator, denominator);
+  }
+
+  /* Overloaded compound-assignment operators */
+  CheckedRational& operator+=(const CheckedRational& right) {
+    this->Merge(right);
+    return Add(right.value.numerator, right.value.denominator);
+  }
+  CheckedRational& operator-=(const CheckedRational& right) {
+    this->Merge(right);
+    NextType c;
+    Check(Overflow::Sub(NextType(0), right.value.numerator, c));
+    return Add(c, right.value.denominator);
+  }
+  CheckedRational& operator*=(const CheckedRational& right);
+  CheckedRational& operator/=(const CheckedRational& right);
+
+  CheckedRational operator-() const {
+    CheckedRational out = *this;
+    out.Check(Overflow::Sub(T(0), value.numerator, out.value.numerator));
+    return out;
+  }
+
+  T Numerator() const { return value.Numerator(); }
+  T Denominator() const { return value.Denominator(); }
+
+  /* The checked value as a plain Rational */
+  const Rational<T>& Value() const { return value; }
+  operator const Rational<T>&() const { return value; }
+};
+
+template <typename T, typename Policy>
+CheckedRational<T, Policy>::CheckedRational(T numerator, T denominator) {
+  if (denominator == 0) {
+    value = Rational<T>(numerator, denominator);
+    Check(true);
+    return;
+  }
+  if (numerator == 0) {
+    AssignReduced(0, 1);
+    return;
+  }
+  T g = Gcd(numerator, denominator);
+  AssignReduced(numerator / g, denominator / g);
+}
+
+template <typename T, typename Policy>
+CheckedRational<T, Policy>&
+CheckedRational<T, Policy>::Add(NextType c, T d) {
+  T a = value.numerator, b = value.denominator;
+  T g = Gcd(b, d);
+  NextType ad, cb, t;
+  T n, den;
+  if (g == 1) {
+    bool overflow = Overflow::Mul(a, d, ad);
+    overflow |= Overflow::Mul(c, b, cb);
+    overflow |= Overflow::Add(ad, cb, t);
+    overflow |= Overflow::Add(t, 0, n);
+    overflow |= Overflow::Mul(b, d, den);
+    Check(overflow);
+    return AssignReduced(n, den);
+  }
+
+  T bg = b / g;
+  bool overflow = Overflow::Mul(a, d / g, ad);
+  overflow |= Overflow::Mul(c, bg, cb);
+  overflow |= Overflow::Add(ad, cb, t);
+  if (t == 0) {
+    Check(overflow);
+    return AssignReduced(0, 1);
+  }
+  NextType g2 = Gcd(t, NextType(g));
+  overflow |= Overflow::Add(t / g2, 0, n);
+  overflow |= Overflow::Mul(bg, T(d / g2), den);
+  Check(overflow);
+  return AssignReduced(n, den);
+}
+
+template <typename T, typename Policy>
+CheckedRational<T, Policy>&
+CheckedRational<T, Policy>::operator*=(const CheckedRational& right) {
+  this->Merge(right);
+  T a = value.numerator, b = value.denominator;
+  T c = right.value.numerator, d = right.value.denominator;
+  if (a == 0 || c == 0)
+    return AssignReduced(0, 1);
+
+  T g1 = Gcd(a, d), g2 = Gcd(c, b);
+  T n, den;
+  bool overflow = Overflow::Mul(a / g1, c / g2, n);
+  overflow |= Overflow::Mul(b / g2, d / g1, den);
+  Check(overflow);
+  return AssignReduced(n, den);
+}
+
+template <typename T, typename Policy>
+CheckedRational<T, Policy>&
+CheckedRational<T, Policy>::operator/=(const CheckedRational& right) {
+  this->Merge(right);
+  T a = value.numerator, b = value.denominator;
+  T c = right.value.numerator, d = right.value.denominator;
+  if (c == 0) {
+    // Reported as overflow, the value is left as Rational would leave it
+    Check(true);
+    value /= right.value;
+    return *this;
+  }
+  if (a == 0)
+    return AssignReduced(0, 1);
+
+  T g1 = Gcd(a, c), g2 = Gcd(b, d);
+  NextType n, den;
+  T nt, dt;
+  bool overflow = Overflow::Mul(a / g1, d / g2, n);
+  overflow |= Overflow::Mul(b / g2, c / g1, den);
+  if (den < 0) {
+    overflow |= Overflow::Sub(NextType(0), n, n);
+    overflow |= Overflow::Sub(NextType(0), den, den);
+  }
+  overflow |= Overflow::Add(n, 0, nt);
+  overflow |= Overflow::Add(den, 0, dt);
+  Check(overflow);
+  return AssignReduced(nt, dt);
+}
+
+// Overloaded arithmetic operators
+// ===============================
+
+template <typename T, typename Policy>
+CheckedRational<T, Policy>
+operator+(CheckedRational<T, Policy> left, const CheckedRational<T, Policy>& right) {
+  return left += right;
+}
+
+template <typename T, typename Policy>
+CheckedRational<T, Policy>
+operator-(CheckedRational<T, Policy> left, const CheckedRational<T, Policy>& right) {
+  return left -= right;
+}
+
+template <typename T, typename Policy>
+CheckedRational<T, Policy>
+operator*(CheckedRational<T, Policy> left, const CheckedRational<T, Policy>& right) {
+  return left *= right;
+}
+
+template <typename T, typename Policy>
+CheckedRational<T, Policy>
+operator/(CheckedRational<T, Policy> left, const CheckedRational<T, Policy>& right) {
+  return left /= right;
+}
+
+// Overloaded relational operators
+// ===============================
+// Compare the values only, the overflow state is not taken into account.
+
+template <typename T, typename Policy>
+bool operator==(const CheckedRational<T, Policy>& left, const CheckedRational<T, Policy>& right) {
+  return left.Value() == right.Value();
+}
+
+template <typename T, typename Policy>
+bool operator!=(const CheckedRational<T, Policy>& left, const CheckedRational<T, Policy>& right) {
+  return left.Value() != right.Value();
+}
+
+template <typename T, typename Policy>
+bool operator<(const CheckedRational<T, Policy>& left, const CheckedRational<T, Policy>& right) {
+  return Compare(left.Value(), right.Value()) < 0;
+}
+
+template <typename T, typename Policy>
+bool operator>(const CheckedRational<T, Policy>& left, const CheckedRational<T, Policy>& right) {
+  return Compare(left.Value(), right.Value()) > 0;
+}
+
+template <typename T, typename Policy>
+bool operator<=(const CheckedRational<T, Policy>& left, const CheckedRational<T, Policy>& right) {
+  return Compare(left.Value(), right.Value()) <= 0;
+}
+
+template <typename T, typename Policy>
+bool operator>=(const CheckedRational<T, Policy>& left, const CheckedRational<T, Policy>& right) {
+  return Compare(left.Value(), right.Value()) >= 0;
+}
+
+// Overloaded stream operator
+// ==========================
+
+template <typename T, typename Policy>
+ostream& operator<<(ostream& os, const CheckedRational<T, Policy>& r) {
+  return os << r.Value();
+}
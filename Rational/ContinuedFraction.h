@@ -0,0 +1,233 @@
+#pragma once
+
+#include <stddef.h>
+#include <iterator>
+#include <stdexcept>
+#include "Rational.h"
+#include "Overflow.h"
+using namespace std;
+
+/*
+ * Continued fractions, lazily and in constant memory. Quotients(r) is the
+ * range of the partial quotients [a0; a1, a2, ...] of r and Convergents(r)
+ * that of its convergents p0/q0, p1/q1, ... up to r itself. Both are
+ * computed term by term from the numerator and the denominator with one
+ * integer division each, and nothing is reduced: the convergents are in
+ * lowest terms by construction. a0 is Floor(r), and the quotients after it
+ * are positive, the last one at least 2 (for r not an integer).
+ *
+ * The other way, ContinuedFractionBuilder<T> takes quotients one at a time,
+ * from a stream for example, and FromContinuedFraction() a whole sequence.
+ *
+ * The quotients are also the run lengths of the path to a positive r in the
+ * Stern-Brocot tree: from 1/1, a0 steps right, a1 left, a2 right and so on,
+ * with one step less in the last run, which ends at r.
+ */
+namespace RationalContinuedFractions {
+
+/* The state of the expansion of n/d = quotient + remainder/d */
+template <typename T>
+struct Expansion {
+  T n, d, quotient, remainder;
+
+  /* n/d with d positive, or d 0 at the end */
+  Expansion(T n, T d): n(n), d(d), quotient(0), remainder(0) { Load(); }
+
+  void Load() {
+    if (d != T(0))
+      RationalParts<T>::FloorDivide(n, d, quotient, remainder);
+  }
+
+  /* Moves on to d/remainder */
+  void Next() {
+    n = d;
+    d = remainder;
+    Load();
+  }
+
+  bool operator==(const Expansion& other) const {
+    return d == other.d && (d == T(0) || n == other.n);
+  }
+};
+
+/* The convergents of a quotient sequence: p1/q1 with each quotient added,
+   starting from p0/q0 = 0/1 and p1/q1 = 1/0 */
+template <typename T>
+class Recurrence {
+  typedef typename IntTraits::NextType<T>::Type NextType;
+
+  /* a x + y as a T, overflow_error if it doesn't fit. Checked, as NextType
+     is T itself for the widest types. Unbounded types can't overflow. */
+  static T MulAdd(T a, T x, T y, false_type) {
+    NextType product, sum;
+    T narrow;
+    if (Overflow::Mul(a, x, product) || Overflow::Add(product, y, sum) ||
+        Overflow::Add(sum, 0, narrow))
+      throw overflow_error("ContinuedFraction: the convergent doesn't fit");
+    return narrow;
+  }
+  static T MulAdd(const T& a, const T& x, const T& y, true_type) { return a * x + y; }
+
+  static T MulAdd(const T& a, const T& x, const T& y) {
+    return MulAdd(a, x, y, integral_constant<bool, IntTraits::IsUnbounded<T>::value>());
+  }
+public:
+  T p0, q0, p1, q1;
+
+  Recurrence(): p0(0), q0(1), p1(1), q1(0) { }
+
+  void Push(T a) {
+    T p2 = MulAdd(a, p1, p0), q2 = MulAdd(a, q1, q0);
+    p0 = p1;
+    q0 = q1;
+    p1 = p2;
+    q1 = q2;
+  }
+};
+
+/* Input iterators over an expansion, dereferencing to the quotient or the
+   convergent */
+template <typename T>
+class QuotientIterator {
+private:
+  Expansion<T> state;
+public:
+  typedef input_iterator_tag iterator_category;
+  typedef T value_type;
+  typedef ptrdiff_t difference_type;
+  typedef const T* pointer;
+  typedef const T& reference;
+
+  /* The end */
+  QuotientIterator(): state(0, 0) { }
+  QuotientIterator(T n, T d): state(n, d) { }
+
+  const T& operator*() const { return state.quotient; }
+  const T* operator->() const { return &state.quotient; }
+  QuotientIterator& operator++() {
+    state.Next();
+    return *this;
+  }
+  QuotientIterator operator++(int) {
+    QuotientIterator previous(*this);
+    state.Next();
+    return previous;
+  }
+  bool operator==(const QuotientIterator& other) const { return state == other.state; }
+  bool operator!=(const QuotientIterator& other) const { return !(state == other.state); }
+};
+
+template <typename T>
+class ConvergentIterator {
+private:
+  Expansion<T> state;
+  Recurrence<T> convergents;
+  Rational<T> value;
+
+  void Load() {
+    if (state.d == T(0))
+      return;
+    convergents.Push(state.quotient);
+    value = Rational<T>::FromReducedUnchecked(convergents.p1, convergents.q1);
+  }
+public:
+  typedef input_iterator_tag iterator_category;
+  typedef Rational<T> value_type;
+  typedef ptrdiff_t difference_type;
+  typedef const Rational<T>* pointer;
+  typedef const Rational<T>& reference;
+
+  /* The end */
+  ConvergentIterator(): state(0, 0) { }
+  ConvergentIterator(T n, T d): state(n, d) { Load(); }
+
+  const Rational<T>& operator*() const { return value; }
+  const Rational<T>* operator->() const { return &value; }
+  /* The quotient that gave this convergent */
+  T Quotient() const { return state.quotient; }
+  ConvergentIterator& operator++() {
+    state.Next();
+    Load();
+    return *this;
+  }
+  ConvergentIterator operator++(int) {
+    ConvergentIterator previous(*this);
+    ++*this;
+    return previous;
+  }
+  bool operator==(const ConvergentIterator& other) const { return state == other.state; }
+  bool operator!=(const ConvergentIterator& other) const { return !(state == other.state); }
+};
+
+/* A range of Iterator over the expansion of a Rational<T> */
+template <typename T, typename Iterator>
+class Range {
+private:
+  T n, d;
+public:
+  typedef Iterator iterator;
+  typedef Iterator const_iterator;
+
+  explicit Range(const Rational<T>& r): n(r.Numerator()), d(r.Denominator()) { }
+
+  Iterator begin() const { return Iterator(n, d); }
+  Iterator end() const { return Iterator(); }
+};
+
+}
+
+/* The partial quotients of r, e.g. for (int a : Quotients(r)) */
+template <typename T>
+RationalContinuedFractions::Range<T, RationalContinuedFractions::QuotientIterator<T> >
+Quotients(const Rational<T>& r) {
+  return RationalContinuedFractions::Range<T, RationalContinuedFractions::QuotientIterator<T> >(r);
+}
+
+/* The convergents of r, the last one r itself */
+template <typename T>
+RationalContinuedFractions::Range<T, RationalContinuedFractions::ConvergentIterator<T> >
+Convergents(const Rational<T>& r) {
+  return RationalContinuedFractions::Range<T, RationalContinuedFractions::ConvergentIterator<T> >(r);
+}
+
+/*
+ * The value of a continued fraction given one quotient at a time. All the
+ * quotients after the first must be positive: Push() throws invalid_argument
+ * otherwise, and overflow_error if the convergent doesn't fit in T, leaving
+ * the value as it was.
+ */
+template <typename T>
+class ContinuedFractionBuilder {
+private:
+  RationalContinuedFractions::Recurrence<T> convergents;
+public:
+  /* Adds the next quotient, returns the convergent up to it */
+  Rational<T> Push(T quotient) {
+    if (convergents.q1 != T(0) && !(quotient > T(0)))
+      throw invalid_argument("ContinuedFraction: the quotients after the first must be positive");
+    RationalContinuedFractions::Recurrence<T> next = convergents;
+    next.Push(quotient);
+    convergents = next;
+    return Value();
+  }
+
+  /* No quotient pushed yet */
+  bool Empty() const { return convergents.q1 == T(0); }
+
+  /* The convergent up to the last quotient, 0 if there is none */
+  Rational<T> Value() const {
+    if (Empty())
+      return Rational<T>();
+    return Rational<T>::FromReducedUnchecked(convergents.p1, convergents.q1);
+  }
+};
+
+/* The value of [*first; *(first + 1), ...], see ContinuedFractionBuilder.
+   Reads the quotients once, so first can be an istream_iterator. */
+template <typename T, typename Iterator>
+Rational<T> FromContinuedFraction(Iterator first, Iterator last) {
+  ContinuedFractionBuilder<T> builder;
+  for (; first != last; ++first)
+    builder.Push(T(*first));
+  return builder.Value();
+}
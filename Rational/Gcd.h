@@ -0,0 +1,272 @@
+#pragma once
+#include <type_traits>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include "IntTraits.h"
+#include "RationalCounters.h"
+using namespace std;
+
+/*
+ * Greatest common divisor engines. Rational<T>::Simplify() calls Gcd(), which
+ * forwards to the engine selected by GcdTraits::Engine<T>. Both engines are
+ * also callable directly (EuclidGcd(), BinaryGcd()) so that they can be
+ * benchmarked against each other. The Lookup engine answers small operands
+ * from a table built at compile time.
+ */
+namespace GcdTraits {
+
+/* UnsignedWork trait, the unsigned type the binary engine works in for T.
+   Types narrower than int are promoted to unsigned int, since that is what
+   the arithmetic and the count-trailing-zeros intrinsic operate on anyway. */
+template <typename T>
+struct UnsignedWork {
+  typedef typename conditional<(sizeof(T) < sizeof(unsigned int)),
+    unsigned int, typename IntTraits::Unsigned<T>::Type>::type Type;
+};
+
+/* HasCtz trait, true if a count-trailing-zeros intrinsic exists for the
+   width of UnsignedWork<T>::Type */
+template <typename T>
+struct HasCtz {
+#ifdef RATIONAL_HAS_INT128
+  static const bool value = IntTraits::IsInteger<T>::value &&
+    sizeof(typename UnsignedWork<T>::Type) <= sizeof(IntTraits::UInt128);
+#else
+  static const bool value = IntTraits::IsInteger<T>::value &&
+    sizeof(typename UnsignedWork<T>::Type) <= sizeof(unsigned long long);
+#endif
+};
+
+}
+
+/*
+ * Count trailing zeros by halving, for any unsigned type. Undefined for 0.
+ * Used where no intrinsic can run in a constant expression.
+ */
+template <typename U>
+RATIONAL_CONSTEXPR int CountTrailingZerosPortable(U x) {
+  int count = 0;
+  for (int half = int(sizeof(U) * 4); half > 0; half /= 2)
+    if ((x & ((U(1) << half) - 1)) == 0) {
+      x >>= half;
+      count += half;
+    }
+  return count;
+}
+
+/* The MSVC intrinsics can't be evaluated at compile time, so they are only
+   used where is_constant_evaluated() can keep them out of constant
+   expressions */
+#if defined(_MSC_VER) && defined(__cpp_lib_is_constant_evaluated)
+#define RATIONAL_MSVC_INTRINSICS 1
+#endif
+
+/*
+ * Count trailing zeros, one overload per width. Undefined for 0.
+ */
+inline RATIONAL_CONSTEXPR int CountTrailingZeros(unsigned int x) {
+#if defined(RATIONAL_MSVC_INTRINSICS)
+  if (!is_constant_evaluated()) {
+    unsigned long index = 0;
+    _BitScanForward(&index, x);
+    return (int) index;
+  }
+  return CountTrailingZerosPortable(x);
+#elif defined(_MSC_VER)
+  return CountTrailingZerosPortable(x);
+#else
+  return __builtin_ctz(x);
+#endif
+}
+
+inline RATIONAL_CONSTEXPR int CountTrailingZeros(unsigned long x) {
+#if defined(RATIONAL_MSVC_INTRINSICS)
+  if (!is_constant_evaluated()) {
+    unsigned long index = 0;
+    _BitScanForward(&index, x);
+    return (int) index;
+  }
+  return CountTrailingZerosPortable(x);
+#elif defined(_MSC_VER)
+  return CountTrailingZerosPortable(x);
+#else
+  return __builtin_ctzl(x);
+#endif
+}
+
+inline RATIONAL_CONSTEXPR int CountTrailingZeros(unsigned long long x) {
+#if defined(RATIONAL_MSVC_INTRINSICS) && defined(_WIN64)
+  if (!is_constant_evaluated()) {
+    unsigned long index = 0;
+    _BitScanForward64(&index, x);
+    return (int) index;
+  }
+  return CountTrailingZerosPortable(x);
+#elif defined(RATIONAL_MSVC_INTRINSICS)
+  if (!is_constant_evaluated()) {
+    unsigned long index = 0;
+    if (_BitScanForward(&index, (unsigned long) x))
+      return (int) index;
+    _BitScanForward(&index, (unsigned long) (x >> 32));
+    return (int) index + 32;
+  }
+  return CountTrailingZerosPortable(x);
+#elif defined(_MSC_VER)
+  return CountTrailingZerosPortable(x);
+#else
+  return __builtin_ctzll(x);
+#endif
+}
+
+#ifdef RATIONAL_HAS_INT128
+inline RATIONAL_CONSTEXPR int CountTrailingZeros(IntTraits::UInt128 x) {
+  unsigned long long low = (unsigned long long) x;
+  if (low != 0)
+    return CountTrailingZeros(low);
+  return CountTrailingZeros((unsigned long long) (x >> 64)) + 64;
+}
+#endif
+
+/*
+ * Returns the greatest common devisor (Euclidean algorithm). The sign of the
+ * result follows the operands and is fixed up by the caller.
+ */
+template <typename T>
+RATIONAL_CONSTEXPR T EuclidGcd(T numerator, T denominator) {
+  T temp = 0;
+  unsigned iterations = 0;
+  while (denominator != 0) {
+    temp = denominator;
+    denominator = numerator % denominator;
+    numerator = temp;
+    ++iterations;
+  }
+  RATIONAL_COUNT(GcdIterations, iterations);
+  return numerator;
+}
+
+/*
+ * Returns the greatest common devisor (binary GCD, Stein's algorithm). Works
+ * on the magnitudes of the operands and never divides, the result is always
+ * non-negative. gcd(x, 0) is |x|.
+ */
+template <typename T>
+RATIONAL_CONSTEXPR T BinaryGcd(T numerator, T denominator) {
+  typedef typename GcdTraits::UnsignedWork<T>::Type U;
+
+  // Magnitudes, computed in the unsigned type so that the minimum value of T
+  // doesn't overflow
+  U u = numerator < 0 ? U(0) - U(numerator) : U(numerator);
+  U v = denominator < 0 ? U(0) - U(denominator) : U(denominator);
+  if (u == 0)
+    return (T) v;
+  if (v == 0)
+    return (T) u;
+
+  int shift = CountTrailingZeros(u | v);
+  u >>= CountTrailingZeros(u);
+  unsigned iterations = 0;
+  do {
+    v >>= CountTrailingZeros(v);
+    if (u > v) {
+      U temp = u;
+      u = v;
+      v = temp;
+    }
+    v -= u;
+    ++iterations;
+  } while (v != 0);
+  RATIONAL_COUNT(GcdIterations, iterations);
+  return (T) (u << shift);
+}
+
+namespace GcdTraits {
+
+/* Engines, wrapping the free functions above so they can be passed as
+   a type */
+struct Euclid {
+  template <typename T>
+  static RATIONAL_CONSTEXPR T Gcd(T a, T b) { return EuclidGcd(a, b); }
+};
+struct Binary {
+  template <typename T>
+  static RATIONAL_CONSTEXPR T Gcd(T a, T b) { return BinaryGcd(a, b); }
+};
+
+/* The relaxed constexpr rules of C++14 build the lookup table at compile
+   time. Without them there is no Lookup engine. */
+#if defined(__cpp_constexpr) && __cpp_constexpr >= 201304
+#define RATIONAL_HAS_GCD_TABLE
+
+/* Operands below TableSize are looked up */
+const unsigned TableSize = 256;
+
+/* gcd(a, b) of all a, b below TableSize. Row by row, gcd(a, b) = gcd(b,
+   a mod b) for b <= a is an entry of an earlier row (or gcd(a, 0) = a), so
+   each entry costs a single division. */
+struct GcdTable {
+  unsigned char value[TableSize][TableSize];
+
+  constexpr GcdTable(): value() {
+    for (unsigned a = 0; a < TableSize; ++a) {
+      value[a][0] = (unsigned char) a;
+      for (unsigned b = 1; b <= a; ++b)
+        value[a][b] = value[b][a % b];
+    }
+    for (unsigned a = 0; a < TableSize; ++a)
+      for (unsigned b = a + 1; b < TableSize; ++b)
+        value[a][b] = value[b][a];
+  }
+};
+
+/* The one table, held by a template so that the header can define it */
+template <typename Unused = void>
+struct GcdTableHolder {
+  static constexpr GcdTable table{};
+};
+template <typename Unused>
+constexpr GcdTable GcdTableHolder<Unused>::table;
+
+/* Looks up gcd(a, b) for magnitudes below TableSize (a 64 KB table) and
+   leaves the others to Fallback. The result is non-negative. */
+template <typename Fallback>
+struct Lookup {
+  template <typename T>
+  static RATIONAL_CONSTEXPR T Gcd(T a, T b) {
+    typedef typename UnsignedWork<T>::Type U;
+    U u = a < 0 ? U(0) - U(a) : U(a);
+    U v = b < 0 ? U(0) - U(b) : U(b);
+    if ((u | v) < TableSize)
+      return T(GcdTableHolder<>::table.value[u][v]);
+    return Fallback::Gcd(a, b);
+  }
+};
+
+#endif
+
+/* Engine trait, used to select the GCD algorithm for T. Binary GCD is used
+   wherever a count-trailing-zeros intrinsic is available for the width of T,
+   Euclid otherwise. With RATIONAL_GCD_TABLE defined, small integer operands
+   are looked up first (see Lookup). Specialize to override for a given
+   type, e.g. with Lookup<Binary> for Rational<short> only. */
+template <typename T>
+struct Engine {
+  typedef typename conditional<HasCtz<T>::value, Binary, Euclid>::type Algorithm;
+#if defined(RATIONAL_GCD_TABLE) && defined(RATIONAL_HAS_GCD_TABLE)
+  typedef typename conditional<IntTraits::IsInteger<T>::value,
+    Lookup<Algorithm>, Algorithm>::type Type;
+#else
+  typedef Algorithm Type;
+#endif
+};
+
+}
+
+/*
+ * Returns the greatest common devisor, using the engine selected for T.
+ */
+template <typename T>
+RATIONAL_CONSTEXPR T Gcd(T numerator, T denominator) {
+  return GcdTraits::Engine<T>::Type::Gcd(numerator, denominator);
+}
@@ -1,33 +1,188 @@
 #pragma once
 #include <limits>
+#include <type_traits>
 using namespace std;
 
+/* RATIONAL_HAS_INT128 is defined when the compiler provides a 128 bit integer
+   type. Define RATIONAL_NO_INT128 to never use it. */
+#if defined(__SIZEOF_INT128__) && !defined(RATIONAL_NO_INT128)
+#define RATIONAL_HAS_INT128 1
+#endif
+
+/* RATIONAL_CONSTANT_EVALUATED() is true during constant evaluation, where the
+   compiler can tell (see RationalCounters.h) */
+#if defined(__cpp_lib_is_constant_evaluated)
+#define RATIONAL_CONSTANT_EVALUATED() is_constant_evaluated()
+#elif defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define RATIONAL_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#elif defined(_MSC_VER) && _MSC_VER >= 1925
+#define RATIONAL_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+
+/* RATIONAL_CONSTEXPR marks the functions that can be evaluated at compile
+   time. They need the relaxed constexpr rules of C++14 (loops, assignment),
+   so with older compilers they are ordinary functions. So are they with
+   RATIONAL_COUNTERS if counting can't be skipped in constant expressions. */
+#if defined(__cpp_constexpr) && __cpp_constexpr >= 201304 && \
+    (!defined(RATIONAL_COUNTERS) || defined(RATIONAL_CONSTANT_EVALUATED))
+#define RATIONAL_CONSTEXPR constexpr
+#else
+#define RATIONAL_CONSTEXPR
+#endif
+
 namespace IntTraits {
 
-/* NextType trait, used to get a larger int type */
-// TODO: Handle unsigned and check if type really is larger.
-template <typename intT>
-struct NextType {
-  typedef intT Type;
+#ifdef RATIONAL_HAS_INT128
+__extension__ typedef __int128 Int128;
+__extension__ typedef unsigned __int128 UInt128;
+#endif
+
+/* IsInteger trait, true for all built in integer types including the 128 bit
+   ones (which is_integral only reports in GNU mode) */
+template <typename T>
+struct IsInteger {
+  static const bool value = is_integral<T>::value;
+};
+#ifdef RATIONAL_HAS_INT128
+template <>
+struct IsInteger<Int128> {
+  static const bool value = true;
 };
 template <>
-struct NextType<short> {
-  typedef int Type;
+struct IsInteger<UInt128> {
+  static const bool value = true;
+};
+#endif
+
+/* IsSigned trait, true for the signed integer types. Other types go by
+   numeric_limits. */
+template <typename T, bool = IsInteger<T>::value>
+struct IsSigned {
+  static const bool value = numeric_limits<T>::is_signed;
+};
+template <typename T>
+struct IsSigned<T, true> {
+  static const bool value = T(-1) < T(0);
+};
+
+/* IsUnbounded trait, true for arbitrary precision integer types (those that
+   specialize numeric_limits with is_bounded false). Arithmetic on them can't
+   overflow, so no wider type is needed. */
+template <typename T, bool = IsInteger<T>::value>
+struct IsUnbounded {
+  static const bool value = numeric_limits<T>::is_specialized &&
+    numeric_limits<T>::is_integer && !numeric_limits<T>::is_bounded;
+};
+template <typename T>
+struct IsUnbounded<T, true> {
+  static const bool value = false;
+};
+
+/* Unsigned and Signed traits, used to get the unsigned or signed integer type
+   of the same width as T. Non-integer types map to themselves. */
+template <typename T, bool = IsInteger<T>::value>
+struct Unsigned {
+  typedef T Type;
+};
+template <typename T>
+struct Unsigned<T, true> {
+  typedef typename make_unsigned<T>::type Type;
+};
+template <typename T, bool = IsInteger<T>::value>
+struct Signed {
+  typedef T Type;
+};
+template <typename T>
+struct Signed<T, true> {
+  typedef typename make_signed<T>::type Type;
 };
+// make_unsigned and make_signed only know the 128 bit types in GNU mode
+#ifdef RATIONAL_HAS_INT128
 template <>
-struct NextType<int> {
-  typedef long Type;
+struct Unsigned<Int128, true> {
+  typedef UInt128 Type;
 };
 template <>
-struct NextType<long> {
-  typedef long long Type;
+struct Unsigned<UInt128, true> {
+  typedef UInt128 Type;
 };
+template <>
+struct Signed<Int128, true> {
+  typedef Int128 Type;
+};
+template <>
+struct Signed<UInt128, true> {
+  typedef Int128 Type;
+};
+#endif
 
-/* LargestType trait, used to get the larger of two types */
-// TODO: Handle unsigned types
-template <typename T, typename U>
+/* Promote trait, the integer type of the next rank with the same signedness,
+   or End after the widest one. Note that the next rank is not necessarily
+   wider (int and long are both 32 bits on Windows, long and long long are
+   both 64 bits on LP64 platforms). */
+struct End {};
+
+template <typename intT>
+struct Promote {
+  typedef End Type;
+};
+template <> struct Promote<signed char> { typedef short Type; };
+template <> struct Promote<short> { typedef int Type; };
+template <> struct Promote<int> { typedef long Type; };
+template <> struct Promote<long> { typedef long long Type; };
+template <> struct Promote<unsigned char> { typedef unsigned short Type; };
+template <> struct Promote<unsigned short> { typedef unsigned int Type; };
+template <> struct Promote<unsigned int> { typedef unsigned long Type; };
+template <> struct Promote<unsigned long> { typedef unsigned long long Type; };
+#ifdef RATIONAL_HAS_INT128
+template <> struct Promote<long long> { typedef Int128 Type; };
+template <> struct Promote<unsigned long long> { typedef UInt128 Type; };
+#endif
+
+/* AtLeast trait, walks the Promote chain from Candidate and gives the first
+   type that is at least Bytes wide, or Widest (the last type seen) if the
+   chain ends first */
+template <typename Widest, typename Candidate, size_t Bytes,
+          bool Enough = (sizeof(Candidate) >= Bytes)>
+struct AtLeast {
+  typedef Candidate Type;
+};
+template <typename Widest, typename Candidate, size_t Bytes>
+struct AtLeast<Widest, Candidate, Bytes, false>:
+  AtLeast<Candidate, typename Promote<Candidate>::Type, Bytes> { };
+template <typename Widest, size_t Bytes>
+struct AtLeast<Widest, End, Bytes, false> {
+  typedef Widest Type;
+};
+
+/* NextType trait, used to get a larger int type. Gives the narrowest type of
+   the same signedness that is at least twice as wide as intT, so that the
+   product of two intT fits. If there is no such type the widest type
+   available is used, and intT itself if nothing is wider. */
+template <typename intT>
+struct NextType {
+  typedef typename AtLeast<intT, typename Promote<intT>::Type,
+                           2 * sizeof(intT)>::Type Type;
+};
+
+/* LargestType trait, used to get the larger of two types. If one type is
+   signed and the other is unsigned, the result is a signed type wide enough
+   to hold all values of both (or the widest signed type available). */
+template <typename T, typename U,
+          bool Mixed = (IsSigned<T>::value != IsSigned<U>::value)>
 struct LargestType {
   typedef typename conditional<sizeof(U) <= sizeof(T), T, U>::type Type;
 };
+template <typename T, typename U>
+struct LargestType<T, U, true> {
+  typedef typename conditional<IsSigned<T>::value, T, U>::type S;
+  typedef typename conditional<IsSigned<T>::value, U, T>::type Us;
+  typedef typename Signed<Us>::Type SignedUs;
+  typedef typename conditional<(sizeof(S) > sizeof(Us)), S,
+    typename AtLeast<SignedUs, typename Promote<SignedUs>::Type,
+                     sizeof(Us) + 1>::Type>::type Type;
+};
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <limits>
+#include "IntTraits.h"
+using namespace std;
+
+/*
+ * Overflow checked primitives. Each one stores the (wrapped) result in out
+ * and returns true if the exact result does not fit in R. The operands may be
+ * of any integer types. With GCC and Clang these are the __builtin_*_overflow
+ * intrinsics, which fold to nothing when the operand types can't overflow R
+ * (for example the product of two ints stored in a 64 bit type).
+ */
+namespace Overflow {
+
+#if defined(__GNUC__) || defined(__clang__)
+
+template <typename R, typename A, typename B>
+bool Add(A a, B b, R& out) { return __builtin_add_overflow(a, b, &out); }
+
+template <typename R, typename A, typename B>
+bool Sub(A a, B b, R& out) { return __builtin_sub_overflow(a, b, &out); }
+
+template <typename R, typename A, typename B>
+bool Mul(A a, B b, R& out) { return __builtin_mul_overflow(a, b, &out); }
+
+#else
+
+/* Portable fallback: compute in the widest of the three types, with an
+   explicit range check, and then narrow */
+template <typename R, typename W>
+bool Narrow(W w, R& out) {
+  out = R(w);
+  return W(out) != w || (out < R(0)) != (w < W(0));
+}
+
+template <typename R, typename A, typename B>
+bool Add(A a, B b, R& out) {
+  typedef typename IntTraits::LargestType<
+    typename IntTraits::LargestType<A, B>::Type, R>::Type W;
+  W x = W(a), y = W(b);
+  if ((y > 0 && x > numeric_limits<W>::max() - y) ||
+      (y < 0 && x < numeric_limits<W>::min() - y)) {
+    out = R(x + y);
+    return true;
+  }
+  return Narrow(W(x + y), out);
+}
+
+template <typename R, typename A, typename B>
+bool Sub(A a, B b, R& out) {
+  typedef typename IntTraits::LargestType<
+    typename IntTraits::LargestType<A, B>::Type, R>::Type W;
+  W x = W(a), y = W(b);
+  if ((y < 0 && x > numeric_limits<W>::max() + y) ||
+      (y > 0 && x < numeric_limits<W>::min() + y)) {
+    out = R(x - y);
+    return true;
+  }
+  return Narrow(W(x - y), out);
+}
+
+template <typename R, typename A, typename B>
+bool Mul(A a, B b, R& out) {
+  typedef typename IntTraits::LargestType<
+    typename IntTraits::LargestType<A, B>::Type, R>::Type W;
+  W x = W(a), y = W(b);
+  if (x != 0 && y != 0) {
+    W p = W(x * y);
+    if ((x == -1 && y == numeric_limits<W>::min()) ||
+        (y == -1 && x == numeric_limits<W>::min()) || p / y != x) {
+      out = R(p);
+      return true;
+    }
+  }
+  return Narrow(W(x * y), out);
+}
+
+#endif
+
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Rational.h"
+#include "RationalAccumulator.h"
+#include "RationalVector.h"
+using namespace std;
+
+/*
+ * Parallel sum, product and dot product of Rational<T> sequences. The range
+ * is cut into chunks that idle workers claim from a shared counter, so a
+ * worker that finishes early takes over the rest of the work. Each worker
+ * keeps its partial result in a RationalAccumulator (no GCD per element) and
+ * the partials are reduced and combined once at the end with the Rational
+ * operators. Rational arithmetic is exact, so the result doesn't depend on
+ * how the chunks were shared out, unless T overflows.
+ */
+namespace ParallelReduce {
+
+/* Number of elements claimed at a time */
+const size_t ChunkSize = 4096;
+
+/* Number of workers for count elements, threads requested (0 meaning one
+   per hardware thread) but no more than there are chunks */
+inline unsigned Workers(size_t count, unsigned threads) {
+  if (threads == 0)
+    threads = thread::hardware_concurrency();
+  if (threads == 0)
+    threads = 1;
+  size_t chunks = (count + ChunkSize - 1) / ChunkSize;
+  if (chunks < threads)
+    threads = chunks == 0 ? 1 : unsigned(chunks);
+  return threads;
+}
+
+/*
+ * Runs work(partial, begin, end) over [0, count) on the workers, each one
+ * starting from initial, and returns the partial results. Each worker
+ * accumulates into its own copy and stores it once at the end, so the
+ * workers don't write to the cache lines of each other. The first exception
+ * thrown by a worker is rethrown.
+ */
+template <typename Partial, typename Work>
+vector<Partial> Run(size_t count, unsigned threads, const Partial& initial,
+                    Work work) {
+  unsigned workers = Workers(count, threads);
+  vector<Partial> partials(workers, initial);
+  if (workers == 1) {
+    work(partials[0], size_t(0), count);
+    return partials;
+  }
+
+  atomic<size_t> next(0);
+  vector<exception_ptr> errors(workers);
+  vector<thread> pool;
+  for (unsigned w = 0; w < workers; ++w)
+    pool.push_back(thread([&, w]() {
+      try {
+        Partial partial = initial;
+        size_t begin;
+        while ((begin = next.fetch_add(ChunkSize)) < count)
+          work(partial, begin, begin + ChunkSize < count ? begin + ChunkSize : count);
+        partials[w] = partial;
+      } catch (...) {
+        errors[w] = current_exception();
+      }
+    }));
+  for (thread& t : pool)
+    t.join();
+  for (exception_ptr& e : errors)
+    if (e)
+      rethrow_exception(e);
+  return partials;
+}
+
+/* The accumulated partials added up */
+template <typename T>
+Rational<T> Total(const vector<RationalAccumulator<T> >& partials) {
+  Rational<T> sum;
+  for (const RationalAccumulator<T>& partial : partials)
+    sum += partial.Value();
+  return sum;
+}
+
+/* Sum of the Rational<T> values element(i), i in [0, count) */
+template <typename T, typename Element>
+Rational<T> Sum(size_t count, unsigned threads, Element element) {
+  return Total(Run(count, threads, RationalAccumulator<T>(),
+    [&element](RationalAccumulator<T>& sum, size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        sum += element(i);
+    }));
+}
+
+/* Sum of the products left(i) right(i), each added unreduced */
+template <typename T, typename Left, typename Right>
+Rational<T> Dot(size_t count, unsigned threads, Left left, Right right) {
+  return Total(Run(count, threads, RationalAccumulator<T>(),
+    [&left, &right](RationalAccumulator<T>& sum, size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        sum.AddProduct(left(i), right(i));
+    }));
+}
+
+/* Product of the Rational<T> values element(i), i in [0, count) */
+template <typename T, typename Element>
+Rational<T> Product(size_t count, unsigned threads, Element element) {
+  vector<RationalAccumulator<T> > partials = Run(
+    count, threads, RationalAccumulator<T>(Rational<T>(1)),
+    [&element](RationalAccumulator<T>& product, size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        product *= element(i);
+    });
+  Rational<T> product(1);
+  for (const RationalAccumulator<T>& partial : partials)
+    product *= partial.Value();
+  return product;
+}
+
+}
+
+/*
+ * Parallel reductions. threads is the number of worker threads, 0 for one
+ * per hardware thread. Empty ranges give 0 (sum, dot) or 1 (product).
+ */
+template <typename T>
+Rational<T> ParallelSum(const Rational<T>* values, size_t count,
+                        unsigned threads = 0) {
+  return ParallelReduce::Sum<T>(count, threads,
+    [values](size_t i) { return values[i]; });
+}
+
+template <typename T>
+Rational<T> ParallelProduct(const Rational<T>* values, size_t count,
+                            unsigned threads = 0) {
+  return ParallelReduce::Product<T>(count, threads,
+    [values](size_t i) { return values[i]; });
+}
+
+template <typename T>
+Rational<T> ParallelDot(const Rational<T>* left, const Rational<T>* right,
+                        size_t count, unsigned threads = 0) {
+  return ParallelReduce::Dot<T>(count, threads,
+    [left](size_t i) { return left[i]; }, [right](size_t i) { return right[i]; });
+}
+
+template <typename T>
+Rational<T> ParallelSum(const vector<Rational<T> >& values, unsigned threads = 0) {
+  return ParallelSum(values.data(), values.size(), threads);
+}
+
+template <typename T>
+Rational<T> ParallelProduct(const vector<Rational<T> >& values, unsigned threads = 0) {
+  return ParallelProduct(values.data(), values.size(), threads);
+}
+
+template <typename T>
+Rational<T> ParallelDot(const vector<Rational<T> >& left,
+                        const vector<Rational<T> >& right, unsigned threads = 0) {
+  if (right.size() != left.size())
+    throw invalid_argument("ParallelDot: sizes differ");
+  return ParallelDot(left.data(), right.data(), left.size(), threads);
+}
+
+template <typename T>
+Rational<T> ParallelSum(const RationalVector<T>& values, unsigned threads = 0) {
+  return ParallelReduce::Sum<T>(values.Size(), threads,
+    [&values](size_t i) { return values[i]; });
+}
+
+template <typename T>
+Rational<T> ParallelProduct(const RationalVector<T>& values, unsigned threads = 0) {
+  return ParallelReduce::Product<T>(values.Size(), threads,
+    [&values](size_t i) { return values[i]; });
+}
+
+template <typename T>
+Rational<T> ParallelDot(const RationalVector<T>& left,
+                        const RationalVector<T>& right, unsigned threads = 0) {
+  if (right.Size() != left.Size())
+    throw invalid_argument("ParallelDot: sizes differ");
+  return ParallelReduce::Dot<T>(left.Size(), threads,
+    [&left](size_t i) { return left[i]; }, [&right](size_t i) { return right[i]; });
+}
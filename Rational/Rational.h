@@ -1,7 +1,14 @@
 #pragma once
 
+#include <stddef.h>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include "IntTraits.h"
+#include "Gcd.h"
 using namespace std;
 
 /*
@@ -9,7 +16,8 @@ using namespace std;
  * be simplified as far as possible, will always indicate sign on the numerator
  * and will always represent 0 as 0/1. For example 2/-8 will be represented as 
  * -1/4 and 0/-128 will be represented as 0/1. Calculations are performed in
- * a larger type (see IntTraits.h).
+ * a larger type (see IntTraits.h). Everything but the stream operators can be
+ * used in constant expressions (C++14 and later).
  */
 template <typename T>
 class Rational {
@@ -18,7 +26,24 @@ class Rational {
   typedef typename IntTraits::NextType<T>::Type NextType;
 
   /* Trying to be nice to our friends: */
-  friend Rational<T> operator- <T>(const Rational<T>&);
+  template <typename U>
+  friend RATIONAL_CONSTEXPR Rational<U> operator-(const Rational<U>&);
+  template <typename U, typename Policy>
+  friend class CheckedRational;
+  template <typename U>
+  friend class RationalVector;
+  template <typename U>
+  friend class RationalAccumulator;
+  template <typename U>
+  friend struct RationalChars;
+  template <typename U, typename Slot, typename Hash>
+  friend class RationalTable;
+  template <typename U>
+  friend class AtomicRational;
+  template <typename U>
+  friend struct RationalParts;
+  template <typename U>
+  friend struct RationalLayout;
 
 private:
   T numerator, denominator;
@@ -26,83 +51,194 @@ private:
   /* Divide by greatest common divisor and makes sure sign is indicated on 
    * numerator.
    */
-  void Simplify();
+  RATIONAL_CONSTEXPR void Simplify();
+
+  /* Stores n/d, which must already be reduced, making sure sign is indicated
+   * on numerator. Narrows to T the way the converting constructor does.
+   */
+  RATIONAL_CONSTEXPR Rational& AssignReduced(NextType n, NextType d);
+
+  /* Adds c/d (d positive) to this. c is taken in NextType so that a negated
+   * numerator can be passed for subtraction.
+   */
+  RATIONAL_CONSTEXPR Rational& Add(NextType c, T d);
+
+  /* Integer kernels: this plus c, times c and divided by c. An integer
+   * operand needs at most one GCD, and adding one none at all.
+   */
+  RATIONAL_CONSTEXPR Rational& AddInteger(NextType c);
+  RATIONAL_CONSTEXPR Rational& MultiplyInteger(T c);
+  RATIONAL_CONSTEXPR Rational& DivideInteger(T c);
+
+  /* This times and divided by c/d (d positive), the kernels of *= and /= */
+  RATIONAL_CONSTEXPR Rational& Multiply(T c, T d);
+  RATIONAL_CONSTEXPR Rational& Divide(T c, T d);
+
+  /* True if U is another type than T whose values all fit in T */
+  template <typename U>
+  struct Narrower {
+    static const bool value = !is_same<T, U>::value &&
+      is_same<typename IntTraits::LargestType<T, U>::Type, T>::value;
+  };
+
+  /* Tag of the constructor that doesn't simplify */
+  struct Unchecked { };
+  RATIONAL_CONSTEXPR Rational(T numerator, T denominator, Unchecked):
+    numerator(numerator), denominator(denominator) { }
 public:
   /* Constructors. */
-  Rational(T numerator = 0, T denominator = 1):
+  RATIONAL_CONSTEXPR Rational(T numerator = 0, T denominator = 1):
     numerator(numerator), denominator(denominator) { Simplify(); }
 
   //Rational(int numerator): Rational(numerator) { }
 
+  /* Exact conversion from a floating point value, which is a dyadic fraction
+   * m * 2^e: no rounding takes place. Throws domain_error for NaN and
+   * infinities and overflow_error if the value doesn't fit in Rational<T>
+   * (for example 0.1 needs a denominator of 2^55). See BestApproximation().
+   */
+  template <typename F>
+  explicit Rational(F x, typename enable_if<is_floating_point<F>::value>::type* = 0);
+
   template <typename U>
-  Rational(const Rational<U>& r): 
-    numerator(r.Numerator()), denominator(r.Denominator()) { }
+  RATIONAL_CONSTEXPR Rational(const Rational<U>& r): 
+    numerator(r.Numerator()), denominator(r.Denominator()) {
+    RATIONAL_COUNT(LossyNarrowings,
+      U(numerator) != r.Numerator() || U(denominator) != r.Denominator());
+  }
+
+  /* numerator/denominator as given, without Simplify(), for values that are
+   * known to be in lowest terms with a positive denominator (0 as 0/1), such
+   * as those read back from a Rational. Other values break the invariants the
+   * operators rely on.
+   */
+  static RATIONAL_CONSTEXPR Rational FromReducedUnchecked(T numerator, T denominator) {
+    return Rational(numerator, denominator, Unchecked());
+  }
 
   /* Sets the numerator and denominator of this Rational */
-  Rational& Set(T numerator, T denominator);
+  RATIONAL_CONSTEXPR Rational& Set(T numerator, T denominator);
+
+  /* Overloaded compound-assignment operators. The operands are cross
+   * cancelled before multiplying so that no GCD runs on the wide products
+   * (see Add()).
+   */
+  RATIONAL_CONSTEXPR Rational& operator+=(const Rational& right) {
+    return Add(right.numerator, right.denominator);
+  }
+  RATIONAL_CONSTEXPR Rational& operator-=(const Rational& right) {
+    return Add(-NextType(right.numerator), right.denominator);
+  }
+  RATIONAL_CONSTEXPR Rational& operator*=(const Rational& right) {
+    return Multiply(right.numerator, right.denominator);
+  }
+  RATIONAL_CONSTEXPR Rational& operator/=(const Rational& right) {
+    return Divide(right.numerator, right.denominator);
+  }
 
-  /* Overloaded compound-assignment operators */
-  Rational& operator+=(const Rational& right) {
-    return *this = Rational<NextType>(
-      right.denominator * numerator + denominator * right.numerator,
-      denominator * right.denominator);
+  /* The same with a narrower Rational<U>, whose every value is also one of
+   * Rational<T>: its numerator and denominator go to the kernels as they
+   * are, without converting it to a Rational<T> first. The products are
+   * computed in NextType, which is the narrowest type that holds them: T
+   * and U have power of two sizes with U no wider than T, so a product of
+   * the two needs more than sizeof(T) bytes, and the next size is twice
+   * that.
+   */
+  template <typename U>
+  RATIONAL_CONSTEXPR typename enable_if<Narrower<U>::value, Rational&>::type
+  operator+=(const Rational<U>& right) {
+    return Add(right.Numerator(), T(right.Denominator()));
   }
-  Rational& operator-=(const Rational& right) {
-    return *this =  Rational<NextType>(
-      right.denominator * numerator - denominator * right.numerator,
-      denominator * right.denominator);
+  template <typename U>
+  RATIONAL_CONSTEXPR typename enable_if<Narrower<U>::value, Rational&>::type
+  operator-=(const Rational<U>& right) {
+    return Add(-NextType(right.Numerator()), T(right.Denominator()));
   }
-  Rational& operator*=(const Rational& right) {
-    return *this =  Rational<NextType>(
-      numerator * right.numerator, denominator * right.denominator);
+  template <typename U>
+  RATIONAL_CONSTEXPR typename enable_if<Narrower<U>::value, Rational&>::type
+  operator*=(const Rational<U>& right) {
+    return Multiply(right.Numerator(), right.Denominator());
   }
-  Rational& operator/=(const Rational& right) {
-    return *this = Rational<NextType>(
-      right.denominator * numerator, right.numerator * denominator);
+  template <typename U>
+  RATIONAL_CONSTEXPR typename enable_if<Narrower<U>::value, Rational&>::type
+  operator/=(const Rational<U>& right) {
+    return Divide(right.Numerator(), right.Denominator());
+  }
+
+  /* The same with an integer, without making a Rational of it first */
+  RATIONAL_CONSTEXPR Rational& operator+=(const T& right) {
+    return AddInteger(right);
+  }
+  RATIONAL_CONSTEXPR Rational& operator-=(const T& right) {
+    return AddInteger(-NextType(right));
+  }
+  RATIONAL_CONSTEXPR Rational& operator*=(const T& right) {
+    return MultiplyInteger(right);
+  }
+  RATIONAL_CONSTEXPR Rational& operator/=(const T& right) {
+    return DivideInteger(right);
   }
 
   /* Note: Arithmetic and relational operators are overloaded as non-members. */
 
   /* Postfix increment */
-  Rational operator++(int a) { 
+  RATIONAL_CONSTEXPR Rational operator++(int) { 
     Rational<T> rval(*this);
     Set(numerator + denominator, denominator);
     return rval;
   }
   /* Postfix decrement */
-  Rational operator--(int a) { 
+  RATIONAL_CONSTEXPR Rational operator--(int) { 
     Rational<T> rval(*this);
     Set(numerator - denominator, denominator); 
     return rval;
   }
   /* Prefix increment */
-  Rational& operator++() { return Set(numerator + denominator, denominator); }
+  RATIONAL_CONSTEXPR Rational& operator++() { return Set(numerator + denominator, denominator); }
   /* Prefix decrement */
-  Rational& operator--() { return Set(numerator - denominator, denominator); }
+  RATIONAL_CONSTEXPR Rational& operator--() { return Set(numerator - denominator, denominator); }
 
-  T Numerator() const { return numerator; }
-  T Denominator() const { return denominator; }
+  RATIONAL_CONSTEXPR T Numerator() const { return numerator; }
+  RATIONAL_CONSTEXPR T Denominator() const { return denominator; }
 
-  explicit operator int() const { return numerator / denominator; }
-  explicit operator double() const { return ((double) numerator) / denominator; }
+  RATIONAL_CONSTEXPR explicit operator int() const { return (int) (numerator / denominator); }
+  /* Conversions to floating point, correctly rounded (to nearest, ties to
+   * even) for integer types, see ToFloatingPoint() */
+  RATIONAL_CONSTEXPR explicit operator double() const;
+  RATIONAL_CONSTEXPR explicit operator float() const;
 };
 
 /*
- * Returns the greatest common devisor (Euclidean algorithm).
+ * Layout. Rational<T> of an integer type is trivially copyable and standard
+ * layout: the numerator and then the denominator, with no padding and
+ * nothing else, so it can be copied with memcpy() and arrays of it read as
+ * pairs of T (see RationalSpan.h).
  */
 template <typename T>
-T Gcd(T numerator, T denominator) {
-  T temp;
-  while (denominator != 0) {
-    temp = denominator;
-    denominator = numerator % denominator;
-    numerator = temp;
-  }
-  return numerator;
+struct RationalLayout {
+  static const bool value = is_trivially_copyable<Rational<T> >::value &&
+    is_standard_layout<Rational<T> >::value &&
+    sizeof(Rational<T>) == 2 * sizeof(T) &&
+    offsetof(Rational<T>, numerator) == 0 &&
+    offsetof(Rational<T>, denominator) == sizeof(T);
+};
+
+static_assert(RationalLayout<signed char>::value && RationalLayout<short>::value &&
+              RationalLayout<int>::value && RationalLayout<long>::value &&
+              RationalLayout<long long>::value && RationalLayout<unsigned>::value &&
+              RationalLayout<unsigned long long>::value,
+              "Rational<T> must be a trivially copyable pair of T");
+
+/* True for 1 and -1, the GCDs that don't reduce anything (the sign of a
+   GCD follows the engine) */
+template <typename T>
+RATIONAL_CONSTEXPR bool IsUnit(const T& g) {
+  return g == 1 || (IntTraits::IsSigned<T>::value && -g == 1);
 }
 
 template <typename T>
-void Rational<T>::Simplify() {
+RATIONAL_CONSTEXPR void Rational<T>::Simplify() {
+  RATIONAL_COUNT(Simplifications, 1);
   // Always represent 0 as 0/1
   if (numerator == 0) {
     denominator = 1;
@@ -111,6 +247,7 @@ void Rational<T>::Simplify() {
 
   // Divide by greatest common divisor
   T gcd = Gcd(numerator, denominator);
+  RATIONAL_COUNT(TrivialReductions, IsUnit(gcd));
   numerator /= gcd;
   denominator /= gcd;
 
@@ -122,20 +259,137 @@ void Rational<T>::Simplify() {
 }
 
 template <typename T>
-Rational<T>& Rational<T>::Set(T numerator, T denominator) {
+RATIONAL_CONSTEXPR Rational<T>& Rational<T>::Set(T numerator, T denominator) {
   this->numerator = numerator;
   this->denominator = denominator;
   Simplify();
   return *this;
 }
 
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T>& Rational<T>::AssignReduced(NextType n, NextType d) {
+  if (d < 0) {
+    n = -n;
+    d = -d;
+  }
+  numerator = T(n);
+  denominator = T(d);
+  RATIONAL_COUNT(LossyNarrowings, NextType(numerator) != n || NextType(denominator) != d);
+  return *this;
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T>& Rational<T>::Add(NextType c, T d) {
+  // Integers and equal denominators first, as they need fewer GCDs
+  if (d == 1)
+    return AddInteger(c);
+  if (denominator == 1)
+    return AssignReduced(NextType(numerator) * d + c, d);
+  if (d == denominator) {
+    NextType t = NextType(numerator) + c;
+    if (t == 0)
+      return AssignReduced(0, 1);
+    NextType g = Gcd(t, NextType(d));
+    RATIONAL_COUNT(TrivialReductions, IsUnit(g));
+    return AssignReduced(t / g, NextType(d) / g);
+  }
+
+  // a/b + c/d with g = gcd(b, d) (Knuth, TAOCP 4.5.1). If b and d are
+  // coprime the sum is already reduced.
+  T g = Gcd(denominator, d);
+  RATIONAL_COUNT(TrivialReductions, g == 1);
+  if (g == 1)
+    return AssignReduced(NextType(numerator) * d + c * denominator,
+                         NextType(denominator) * d);
+
+  // Otherwise only a factor of g can be left to cancel
+  T b = denominator / g;
+  NextType t = NextType(numerator) * (d / g) + c * b;
+  if (t == 0)
+    return AssignReduced(0, 1);
+  NextType g2 = Gcd(t, NextType(g));
+  RATIONAL_COUNT(TrivialReductions, g2 == 1);
+  return AssignReduced(t / g2, NextType(b) * (d / g2));
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T>& Rational<T>::Multiply(T c, T d) {
+  if (numerator == 0 || c == 0)
+    return AssignReduced(0, 1);
+  if (d == 1)
+    return MultiplyInteger(c);
+  if (denominator == 1) {
+    T g = Gcd(numerator, d);
+    RATIONAL_COUNT(TrivialReductions, IsUnit(g));
+    return AssignReduced(NextType(numerator / g) * c, NextType(d / g));
+  }
+
+  // (a/b) * (c/d): cancel gcd(a, d) and gcd(c, b) first, the product of the
+  // remaining factors is already reduced
+  T g1 = Gcd(numerator, d);
+  T g2 = Gcd(c, denominator);
+  RATIONAL_COUNT(TrivialReductions, IsUnit(g1) + IsUnit(g2));
+  return AssignReduced(
+    NextType(numerator / g1) * (c / g2),
+    NextType(denominator / g2) * (d / g1));
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T>& Rational<T>::Divide(T c, T d) {
+  // Zero on either side: nothing to cancel, keep the general path
+  if (numerator == 0 || c == 0)
+    return *this = Rational<NextType>(NextType(d) * numerator, NextType(c) * denominator);
+  if (d == 1)
+    return DivideInteger(c);
+  if (denominator == 1) {
+    T g = Gcd(numerator, c);
+    RATIONAL_COUNT(TrivialReductions, IsUnit(g));
+    return AssignReduced(NextType(numerator / g) * d, NextType(c / g));
+  }
+
+  // (a/b) / (c/d): cancel gcd(a, c) and gcd(b, d) first
+  T g1 = Gcd(numerator, c);
+  T g2 = Gcd(denominator, d);
+  RATIONAL_COUNT(TrivialReductions, IsUnit(g1) + IsUnit(g2));
+  return AssignReduced(
+    NextType(numerator / g1) * (d / g2),
+    NextType(denominator / g2) * (c / g1));
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T>& Rational<T>::AddInteger(NextType c) {
+  // a/b + c = (a + c*b)/b, and gcd(a + c*b, b) = gcd(a, b) = 1
+  return AssignReduced(NextType(numerator) + c * denominator, denominator);
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T>& Rational<T>::MultiplyInteger(T c) {
+  if (numerator == 0 || c == 0)
+    return AssignReduced(0, 1);
+  // (a/b) * c: only gcd(c, b) can cancel
+  T g = Gcd(c, denominator);
+  RATIONAL_COUNT(TrivialReductions, IsUnit(g));
+  return AssignReduced(NextType(numerator) * (c / g), NextType(denominator / g));
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T>& Rational<T>::DivideInteger(T c) {
+  // Zero on either side takes the general path
+  if (numerator == 0 || c == 0)
+    return Divide(c, 1);
+  // (a/b) / c: only gcd(a, c) can cancel
+  T g = Gcd(numerator, c);
+  RATIONAL_COUNT(TrivialReductions, IsUnit(g));
+  return AssignReduced(NextType(numerator / g), NextType(denominator) * (c / g));
+}
+
 // Overloaded arithmetic operators
 // ===============================
 
 // +
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator+(const Rational<T>& left, const Rational<U>& right) {
   Rational<typename IntTraits::LargestType<T, U>::Type> sum = left;
   sum += right;
@@ -143,14 +397,15 @@ operator+(const Rational<T>& left, const Rational<U>& right) {
 }
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator+(const Rational<T>& left, const U& right) {
-  Rational<IntTraits::LargestType<T, U>::Type> sum = left;
-  return sum += right;
+  typedef typename IntTraits::LargestType<T, U>::Type L;
+  Rational<L> sum = left;
+  return sum += L(right);
 }
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator+(const U& left, const Rational<T>& right) {
   return right + left;
 }
@@ -158,14 +413,14 @@ operator+(const U& left, const Rational<T>& right) {
 // -
 
 template <typename T>
-Rational<T> operator-(const Rational<T>& in) {
+RATIONAL_CONSTEXPR Rational<T> operator-(const Rational<T>& in) {
   Rational<T> out = in;
   out.numerator = -out.numerator;
   return out;
 }
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator-(const Rational<T>& left, const Rational<U>& right) {
   Rational<typename IntTraits::LargestType<T, U>::Type> sum = left;
   sum -= right;
@@ -173,14 +428,15 @@ operator-(const Rational<T>& left, const Rational<U>& right) {
 }
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator-(const Rational<T>& left, const U& right) {
-  Rational<IntTraits::LargestType<T, U>::Type> sum = left;
-  return sum -= right;
+  typedef typename IntTraits::LargestType<T, U>::Type L;
+  Rational<L> sum = left;
+  return sum -= L(right);
 }
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator-(const U& left, const Rational<T>& right) {
   return (-right) + left;
 }
@@ -188,21 +444,22 @@ operator-(const U& left, const Rational<T>& right) {
 // *
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator*(const Rational<T>& left, const Rational<U>& right) {
-  Rational<IntTraits::LargestType<T, U>::Type> product = left;
+  Rational<typename IntTraits::LargestType<T, U>::Type> product = left;
   return product *= right;
 }
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator*(const Rational<T>& left, const U& right) {
-  Rational<IntTraits::LargestType<T, U>::Type> product = left;
-  return product *= right;
+  typedef typename IntTraits::LargestType<T, U>::Type L;
+  Rational<L> product = left;
+  return product *= L(right);
 }
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator*(const U& left, const Rational<T>& right) {
   return right * left;
 }
@@ -210,132 +467,758 @@ operator*(const U& left, const Rational<T>& right) {
 // /
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator/(const Rational<T>& left, const Rational<U>& right) {
-  Rational<IntTraits::LargestType<T, U>::Type> quotient = left;
+  Rational<typename IntTraits::LargestType<T, U>::Type> quotient = left;
   return quotient /= right;
 }
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator/(const Rational<T>& left, const U& right) {
-  Rational<IntTraits::LargestType<T, U>::Type> quotient = left;
-  return quotient /= right;
+  typedef typename IntTraits::LargestType<T, U>::Type L;
+  Rational<L> quotient = left;
+  return quotient /= L(right);
 }
 
 template <typename T, typename U>
-Rational<typename IntTraits::LargestType<T, U>::Type>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
 operator/(const U& left, const Rational<T>& right) {
-  Rational<IntTraits::LargestType<T, U>::Type> quotient = left;
+  Rational<typename IntTraits::LargestType<T, U>::Type> quotient(left);
   return quotient /= right;
 }
 
+// Temporary left operands
+// ========================
+// A left operand that is a temporary of the result type is reused rather
+// than copied, which for BigRational saves an allocation per operator (as
+// in a * b + c).
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T> operator+(Rational<T>&& left, const Rational<T>& right) {
+  left += right;
+  return std::move(left);
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T> operator-(Rational<T>&& left, const Rational<T>& right) {
+  left -= right;
+  return std::move(left);
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T> operator*(Rational<T>&& left, const Rational<T>& right) {
+  left *= right;
+  return std::move(left);
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T> operator/(Rational<T>&& left, const Rational<T>& right) {
+  left /= right;
+  return std::move(left);
+}
+
+// Comparison
+// ==========
+
+/*
+ * Three-way comparison of a/b and c/d (b and d positive) by continued fraction
+ * expansion. Compares the integer parts and, while they are equal, the
+ * reciprocals of the fractional parts, so no intermediate value exceeds the
+ * operands. Used where no wider type is available for cross-multiplication.
+ */
+template <typename T>
+RATIONAL_CONSTEXPR int CompareFractions(T a, T b, T c, T d) {
+  // Integer parts, rounded towards negative infinity
+  T q1 = a / b, r1 = a % b;
+  if (r1 < 0) { r1 += b; --q1; }
+  T q2 = c / d, r2 = c % d;
+  if (r2 < 0) { r2 += d; --q2; }
+
+  // From here on a/b and c/d are positive, and the sense of the comparison
+  // flips with every reciprocal
+  bool flipped = false;
+  for (;;) {
+    if (q1 != q2)
+      return (q1 < q2) != flipped ? -1 : 1;
+    if (r1 == 0 || r2 == 0) {
+      if (r1 == r2)
+        return 0;
+      return (r1 == 0) != flipped ? -1 : 1;
+    }
+    // Compare b/r1 and d/r2
+    a = b; b = r1;
+    c = d; d = r2;
+    q1 = a / b; r1 = a % b;
+    q2 = c / d; r2 = c % d;
+    flipped = !flipped;
+  }
+}
+
+template <typename T, typename U, typename W>
+RATIONAL_CONSTEXPR int CompareImpl(const Rational<T>& left, const Rational<U>& right, W*, true_type) {
+  // Cross-multiplication in a type wide enough to hold the products
+  W lhs = W(left.Numerator()) * W(right.Denominator());
+  W rhs = W(right.Numerator()) * W(left.Denominator());
+  return lhs < rhs ? -1 : (rhs < lhs ? 1 : 0);
+}
+
+template <typename T, typename U, typename W>
+RATIONAL_CONSTEXPR int CompareImpl(const Rational<T>& left, const Rational<U>& right, W*, false_type) {
+  typedef typename IntTraits::LargestType<T, U>::Type L;
+  return CompareFractions<L>(left.Numerator(), left.Denominator(),
+    right.Numerator(), right.Denominator());
+}
+
+/*
+ * Returns a negative value, zero or a positive value if left is less than,
+ * equal to or greater than right. Computes a*d and c*b in the NextType of the
+ * larger operand type (or in the type itself if it is unbounded) without
+ * reducing anything, falling back to CompareFractions() when no wider type
+ * exists.
+ */
+template <typename T, typename U>
+RATIONAL_CONSTEXPR int Compare(const Rational<T>& left, const Rational<U>& right) {
+  typedef typename IntTraits::LargestType<T, U>::Type L;
+  typedef typename IntTraits::NextType<L>::Type W;
+  RATIONAL_COUNT(Comparisons, 1);
+  return CompareImpl(left, right, (W*) 0,
+    integral_constant<bool, (sizeof(W) > sizeof(L)) ||
+                            IntTraits::IsUnbounded<L>::value>());
+}
+
 // Overloaded relational operators
 // ===============================
 
 // ==
 
 template <typename T, typename U>
-bool operator==(const Rational<T>& left, const Rational<U>& right) {
+RATIONAL_CONSTEXPR bool operator==(const Rational<T>& left, const Rational<U>& right) {
+  RATIONAL_COUNT(Comparisons, 1);
   return left.Numerator() == right.Numerator() && left.Denominator() == right.Denominator();
 }
 
 template <typename T, typename U>
-bool operator==(const Rational<T>& left, const U& right) {
+RATIONAL_CONSTEXPR bool operator==(const Rational<T>& left, const U& right) {
   return left.Denominator() == 1 && left.Numerator() == right;
 }
 
 template <typename T, typename U>
-bool operator==(const U& left, const Rational<T>& right) {
+RATIONAL_CONSTEXPR bool operator==(const U& left, const Rational<T>& right) {
   return right == left;
 }
 
 // !=
 
 template <typename T, typename U>
-bool operator!=(const Rational<T>& left, const Rational<U>& right) {
+RATIONAL_CONSTEXPR bool operator!=(const Rational<T>& left, const Rational<U>& right) {
   return !(left == right);
 }
 
 template <typename T, typename U>
-bool operator!=(const Rational<T>& left, const U& right) {
+RATIONAL_CONSTEXPR bool operator!=(const Rational<T>& left, const U& right) {
   return !(left == right);
 }
 
 template <typename T, typename U>
-bool operator!=(const T& left, const Rational<U>& right) {
+RATIONAL_CONSTEXPR bool operator!=(const T& left, const Rational<U>& right) {
   return !(right == left);
 }
 
 // <
 
 template <typename T, typename U>
-bool operator<(const Rational<T>& left, const Rational<U>& right) {
-  return (right - left).Numerator() > 0;
+RATIONAL_CONSTEXPR bool operator<(const Rational<T>& left, const Rational<U>& right) {
+  return Compare(left, right) < 0;
 }
 
 template <typename T, typename U>
-bool operator<(const Rational<T>& left, const U& right) {
+RATIONAL_CONSTEXPR bool operator<(const Rational<T>& left, const U& right) {
   return left < Rational<U>(right);
 }
 
 template <typename T, typename U>
-bool operator<(const T& left, const Rational<U>& right) {
+RATIONAL_CONSTEXPR bool operator<(const T& left, const Rational<U>& right) {
   return Rational<T>(left) < right;
 }
 
 // >
 
 template <typename T, typename U>
-bool operator>(const Rational<T>& left, const Rational<U>& right) {
-  return (left - right).Numerator() > 0;
+RATIONAL_CONSTEXPR bool operator>(const Rational<T>& left, const Rational<U>& right) {
+  return Compare(left, right) > 0;
 }
 
 template <typename T, typename U>
-bool operator>(const Rational<T>& left, const U& right) {
+RATIONAL_CONSTEXPR bool operator>(const Rational<T>& left, const U& right) {
   return left > Rational<U>(right);
 }
 
 template <typename T, typename U>
-bool operator>(const T& left, const Rational<U>& right) {
+RATIONAL_CONSTEXPR bool operator>(const T& left, const Rational<U>& right) {
   return Rational<T>(left) > right;
 }
 
 // <=
 
 template <typename T, typename U>
-bool operator<=(const Rational<T>& left, const Rational<U>& right) {
+RATIONAL_CONSTEXPR bool operator<=(const Rational<T>& left, const Rational<U>& right) {
   return !(left > right);
 }
 
 template <typename T, typename U>
-bool operator<=(const Rational<T>& left, const U& right) {
+RATIONAL_CONSTEXPR bool operator<=(const Rational<T>& left, const U& right) {
   return left <= Rational<U>(right);
 }
 
 template <typename T, typename U>
-bool operator<=(const T& left, const Rational<U>& right) {
+RATIONAL_CONSTEXPR bool operator<=(const T& left, const Rational<U>& right) {
   return Rational<T>(left) <= right;
 }
 
 // >=
 
 template <typename T, typename U>
-bool operator>=(const Rational<T>& left, const Rational<U>& right) {
+RATIONAL_CONSTEXPR bool operator>=(const Rational<T>& left, const Rational<U>& right) {
   return !(left < right);
 }
 
 template <typename T, typename U>
-bool operator>=(const Rational<T>& left, const U& right) {
+RATIONAL_CONSTEXPR bool operator>=(const Rational<T>& left, const U& right) {
   return left >= Rational<U>(right);
 }
 
 template <typename T, typename U>
-bool operator>=(const T& left, const Rational<U>& right) {
+RATIONAL_CONSTEXPR bool operator>=(const T& left, const Rational<U>& right) {
   return Rational<T>(left) >= right;
 }
 
 
+// Integer parts and remainders
+// ============================
+// Each of these takes a single integer division (the quotient and remainder
+// of the same operands are one instruction) and no GCD, except DivMod() and
+// %, which reduce their remainder once.
+
+/* Rounding modes of Round() */
+enum RoundingMode {
+  /* Toward negative infinity, as Floor() */
+  RoundDown,
+  /* Toward positive infinity, as Ceil() */
+  RoundUp,
+  /* As Trunc() */
+  RoundTowardZero,
+  RoundAwayFromZero,
+  /* To the nearest integer, ties to even (banker's rounding) */
+  RoundHalfEven,
+  /* To the nearest integer, ties toward positive infinity */
+  RoundHalfUp,
+  /* To the nearest integer, ties toward negative infinity */
+  RoundHalfDown,
+  RoundHalfAwayFromZero,
+  RoundHalfTowardZero
+};
+
+/* The integer quotient and the remainder of DivMod() */
+template <typename T>
+struct RationalDivision {
+  T quotient;
+  Rational<T> remainder;
+};
+
+template <typename T>
+struct RationalParts {
+  /* n = q d + r with 0 <= r < d, for d positive */
+  static RATIONAL_CONSTEXPR void FloorDivide(T n, T d, T& q, T& r) {
+    q = n / d;
+    r = n % d;
+    if (IntTraits::IsSigned<T>::value && r < T(0)) {
+      q -= T(1);
+      r += d;
+    }
+  }
+
+  /* q + r/d rounded as mode says, for 0 <= r < d. Without branches when
+     mode is a constant. */
+  static RATIONAL_CONSTEXPR T Rounded(T q, T r, T d, RoundingMode mode) {
+    // For the nearest modes, r/d against 1/2 as r against d - r, which can't
+    // overflow
+    T rest = d - r;
+    bool up = false;
+    switch (mode) {
+    case RoundDown:
+      up = false;
+      break;
+    case RoundUp:
+      up = r != 0;
+      break;
+    case RoundTowardZero:
+      up = r != 0 && q < T(0);
+      break;
+    case RoundAwayFromZero:
+      up = r != 0 && !(q < T(0));
+      break;
+    case RoundHalfEven:
+      up = r > rest || (r == rest && q % 2 != 0);
+      break;
+    case RoundHalfUp:
+      up = r >= rest;
+      break;
+    case RoundHalfDown:
+      up = r > rest;
+      break;
+    case RoundHalfAwayFromZero:
+      up = r > rest || (r == rest && !(q < T(0)));
+      break;
+    case RoundHalfTowardZero:
+      up = r > rest || (r == rest && q < T(0));
+      break;
+    }
+    return up ? T(q + 1) : q;
+  }
+
+  /* r - Trunc(r). n % d and d have no common factor if n and d have none. */
+  static RATIONAL_CONSTEXPR Rational<T> Frac(const Rational<T>& r) {
+    Rational<T> frac;
+    frac.numerator = r.numerator % r.denominator;
+    if (frac.numerator != 0)
+      frac.denominator = r.denominator;
+    return frac;
+  }
+
+  /* a/b = (an bd)/(ad bn) = q + rem/(ad |bn|), so a - q b = ±rem/(ad bd) */
+  static RATIONAL_CONSTEXPR RationalDivision<T> DivMod(const Rational<T>& a, const Rational<T>& b) {
+    typedef typename IntTraits::NextType<T>::Type W;
+    if (b.numerator == 0)
+      throw domain_error("Rational: division by zero");
+    RationalDivision<T> result = { T(0), Rational<T>() };
+    if (a.denominator == 1 && b.denominator == 1) {
+      // The quotient of the minimum by -1 doesn't fit, and dividing traps
+      if (IntTraits::IsSigned<T>::value && b.numerator == T(-1)) {
+        result.quotient = T(-W(a.numerator));
+        RATIONAL_COUNT(LossyNarrowings, W(result.quotient) != -W(a.numerator));
+        return result;
+      }
+      result.quotient = a.numerator / b.numerator;
+      result.remainder.numerator = a.numerator % b.numerator;
+      return result;
+    }
+    W n = W(a.numerator) * W(b.denominator), d = W(a.denominator) * W(b.numerator);
+    bool negative = d < W(0);
+    if (negative) {
+      n = -n;
+      d = -d;
+    }
+    W q = n / d, rem = n % d;
+    result.quotient = T(q);
+    RATIONAL_COUNT(LossyNarrowings, W(result.quotient) != q);
+    if (rem != 0) {
+      W den = W(a.denominator) * W(b.denominator);
+      W g = Gcd(rem, den);
+      RATIONAL_COUNT(TrivialReductions, IsUnit(g));
+      result.remainder.AssignReduced(negative ? -(rem / g) : rem / g, den / g);
+    }
+    return result;
+  }
+};
+
+/* The largest integer not greater than r */
+template <typename T>
+RATIONAL_CONSTEXPR T Floor(const Rational<T>& r) {
+  T q = 0, rem = 0;
+  RationalParts<T>::FloorDivide(r.Numerator(), r.Denominator(), q, rem);
+  return q;
+}
+
+/* The smallest integer not less than r */
+template <typename T>
+RATIONAL_CONSTEXPR T Ceil(const Rational<T>& r) {
+  T q = 0, rem = 0;
+  RationalParts<T>::FloorDivide(r.Numerator(), r.Denominator(), q, rem);
+  return rem == 0 ? q : q + 1;
+}
+
+/* r rounded toward zero, the integer part of the mixed number */
+template <typename T>
+RATIONAL_CONSTEXPR T Trunc(const Rational<T>& r) {
+  return r.Numerator() / r.Denominator();
+}
+
+/* r rounded to an integer, by default to the nearest with ties to even */
+template <typename T>
+RATIONAL_CONSTEXPR T Round(const Rational<T>& r, RoundingMode mode = RoundHalfEven) {
+  T q = 0, rem = 0;
+  RationalParts<T>::FloorDivide(r.Numerator(), r.Denominator(), q, rem);
+  return RationalParts<T>::Rounded(q, rem, r.Denominator(), mode);
+}
+
+/* r - Trunc(r), the fractional part of the mixed number, with the sign of r
+   (as modf()) */
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T> Frac(const Rational<T>& r) {
+  return RationalParts<T>::Frac(r);
+}
+
+/*
+ * The quotient of a / b truncated toward zero and the remainder a - q b,
+ * which has the sign of a, as for built-in integers. Throws domain_error if
+ * b is zero. The quotient is narrowed to T like the results of the
+ * operators.
+ */
+template <typename T>
+RATIONAL_CONSTEXPR RationalDivision<T> DivMod(const Rational<T>& a, const Rational<T>& b) {
+  return RationalParts<T>::DivMod(a, b);
+}
+
+// %
+
+template <typename T, typename U>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
+operator%(const Rational<T>& left, const Rational<U>& right) {
+  typedef typename IntTraits::LargestType<T, U>::Type L;
+  return DivMod(Rational<L>(left), Rational<L>(right)).remainder;
+}
+
+template <typename T, typename U>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
+operator%(const Rational<T>& left, const U& right) {
+  typedef typename IntTraits::LargestType<T, U>::Type L;
+  return DivMod(Rational<L>(left), Rational<L>(right)).remainder;
+}
+
+template <typename T, typename U>
+RATIONAL_CONSTEXPR Rational<typename IntTraits::LargestType<T, U>::Type>
+operator%(const U& left, const Rational<T>& right) {
+  typedef typename IntTraits::LargestType<T, U>::Type L;
+  return DivMod(Rational<L>(left), Rational<L>(right)).remainder;
+}
+
+// Conversion to floating point
+// ============================
+
+/* Number of significant bits of x */
+template <typename U>
+RATIONAL_CONSTEXPR int BitLength(U x) {
+  int length = 0;
+  for (; x != 0; x >>= 1)
+    ++length;
+  return length;
+}
+
+/* x * 2^exponent, exact as long as the result is a normal double */
+RATIONAL_CONSTEXPR inline double ScaleByPowerOf2(double x, int exponent) {
+  double factor = exponent < 0 ? 0.5 : 2.0;
+  for (int e = exponent < 0 ? -exponent : exponent; e != 0; e >>= 1) {
+    if (e & 1)
+      x *= factor;
+    factor *= factor;
+  }
+  return x;
+}
+
+/*
+ * q * 2^exponent (plus less than one unit of q if sticky) rounded to the
+ * digits significant bits of F, to nearest with ties to even.
+ */
+template <typename F, typename Q>
+RATIONAL_CONSTEXPR F RoundToFloatingPoint(Q q, int exponent, bool sticky) {
+  const int digits = numeric_limits<F>::digits;
+  int extra = BitLength(q) - digits;
+  if (extra > 0) {
+    Q low = q & ((Q(1) << extra) - 1), half = Q(1) << (extra - 1);
+    q >>= extra;
+    exponent += extra;
+    if (low > half || (low == half && (sticky || (q & 1))))
+      ++q;
+  }
+  return F(ScaleByPowerOf2(double((unsigned long long) q), exponent));
+}
+
+/*
+ * n/d rounded to F, for magnitudes n and d (d not 0), with one division in
+ * a type wide enough for n * 2^s: q = n * 2^s / d has digits + 1 or digits
+ * + 2 bits, and the remainder tells whether anything was left over.
+ */
+template <typename F, typename U, typename W>
+RATIONAL_CONSTEXPR F RoundedQuotient(U n, U d, W*, true_type) {
+  int s = numeric_limits<F>::digits + 1 - (BitLength(n) - BitLength(d));
+  W wn = n, wd = d;
+  if (s >= 0)
+    wn <<= s;
+  else
+    wd <<= -s;
+  return RoundToFloatingPoint<F>(wn / wd, -s, wn % wd != 0);
+}
+
+/* The same by long division where there is no wider type */
+template <typename F, typename U, typename W>
+RATIONAL_CONSTEXPR F RoundedQuotient(U n, U d, W*, false_type) {
+  U q = n / d, r = n % d;
+  int exponent = 0;
+  while (BitLength(q) < numeric_limits<F>::digits + 2) {
+    // r < d, so compare r with d - r instead of doubling it
+    q <<= 1;
+    if (r >= d - r) {
+      r -= d - r;
+      q |= 1;
+    } else {
+      r <<= 1;
+    }
+    --exponent;
+  }
+  return RoundToFloatingPoint<F>(q, exponent, r != 0);
+}
+
+template <typename F, typename T>
+RATIONAL_CONSTEXPR F ToFloatingPoint(T n, T d, true_type) {
+  typedef typename IntTraits::Unsigned<T>::Type U;
+  typedef typename IntTraits::NextType<U>::Type W;
+  U un = n < 0 ? U(0) - U(n) : U(n), ud = U(d);
+
+  // Both exact in a double: a single correctly rounded division, which can
+  // be rounded to float again without error since 53 >= 2 * 24 + 2. Every
+  // value of a type of up to 53 bits is, so the long division below only
+  // sees types wide enough for its quotient.
+  const U exact = U(~U(0)) >> (sizeof(U) * 8 > 53 ? sizeof(U) * 8 - 53 : 0);
+  if ((un <= exact && ud <= exact) || d == 0)
+    return F((double) n / (double) d);
+  F magnitude = RoundedQuotient<F>(un, ud, (W*) 0,
+    integral_constant<bool, (sizeof(W) * 8 >= numeric_limits<F>::digits + 1 +
+                                                sizeof(U) * 8)>());
+  return n < 0 ? -magnitude : magnitude;
+}
+
+template <typename F, typename T>
+RATIONAL_CONSTEXPR F ToFloatingPoint(const T& n, const T& d, false_type) {
+  return F(double(n) / double(d));
+}
+
+/*
+ * n/d (d positive, as in a Rational) rounded to the floating point type F.
+ * For integer types this is the correctly rounded value of the exact
+ * quotient (with ties to even) whenever it is a normal number, also where n
+ * or d have more bits than the mantissa of F. Other types divide after
+ * converting to double.
+ */
+template <typename F, typename T>
+RATIONAL_CONSTEXPR F ToFloatingPoint(const T& n, const T& d) {
+  return ToFloatingPoint<F>(n, d,
+    integral_constant<bool, IntTraits::IsInteger<T>::value>());
+}
+
+template <typename F, typename T>
+RATIONAL_CONSTEXPR F ToFloatingPoint(const Rational<T>& r) {
+  return ToFloatingPoint<F>(r.Numerator(), r.Denominator());
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T>::operator double() const {
+  return ToFloatingPoint<double>(*this);
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR Rational<T>::operator float() const {
+  return ToFloatingPoint<float>(*this);
+}
+
+// Conversion from floating point
+// ==============================
+
+/*
+ * Splits a finite x into |x| = mantissa * 2^exponent with mantissa odd (or
+ * both 0).
+ */
+template <typename F>
+void DecomposeFloat(F x, unsigned long long& mantissa, int& exponent) {
+  static_assert(numeric_limits<F>::digits <= 64,
+                "the mantissa must fit in unsigned long long");
+  if (x != x || x - x != x - x)
+    throw domain_error("Rational: not a finite number");
+  int e = 0;
+  F f = frexp(x < 0 ? -x : x, &e);
+  mantissa = (unsigned long long) ldexp(f, numeric_limits<F>::digits);
+  exponent = e - numeric_limits<F>::digits;
+  if (mantissa == 0) {
+    exponent = 0;
+    return;
+  }
+  int zeros = CountTrailingZeros(mantissa);
+  mantissa >>= zeros;
+  exponent += zeros;
+}
+
+/* Number of value bits of T (without the sign bit) */
+template <typename T>
+int ValueBits() {
+  return int(sizeof(T) * 8) - int(IntTraits::IsSigned<T>::value);
+}
+
+/* 2^k in T */
+template <typename T>
+T Pow2(int k) {
+  T result = 1, square = 2;
+  for (; k > 0; k >>= 1) {
+    if (k & 1)
+      result *= square;
+    square *= square;
+  }
+  return result;
+}
+
+/* Stores +-mantissa * 2^exponent in n/d, for bounded integer types */
+template <typename T>
+void FromBinary(unsigned long long mantissa, int exponent, bool negative,
+                T& n, T& d, false_type) {
+  typedef typename IntTraits::Unsigned<T>::Type U;
+  int bits = ValueBits<T>(), length = 0;
+  for (unsigned long long m = mantissa; m != 0; m >>= 1)
+    ++length;
+  // The magnitude of the minimum value of a signed type is one more
+  bool minimum = negative && IntTraits::IsSigned<T>::value && mantissa == 1 &&
+                 exponent == bits;
+  if ((negative && !IntTraits::IsSigned<T>::value && mantissa != 0) ||
+      (exponent >= 0 ? length + exponent > bits && !minimum
+                     : -exponent >= bits || length > bits))
+    throw overflow_error("Rational: the value doesn't fit");
+  U magnitude = U(mantissa), denominator = 1;
+  if (exponent >= 0)
+    magnitude = U(magnitude << exponent);
+  else
+    denominator = U(denominator << -exponent);
+  n = negative ? T(U(0) - magnitude) : T(magnitude);
+  d = T(denominator);
+}
+
+/* The same for arbitrary precision types, which can't overflow */
+template <typename T>
+void FromBinary(unsigned long long mantissa, int exponent, bool negative,
+                T& n, T& d, true_type) {
+  n = T(mantissa);
+  d = T(1);
+  if (exponent >= 0)
+    n *= Pow2<T>(exponent);
+  else
+    d = Pow2<T>(-exponent);
+  if (negative)
+    n = -n;
+}
+
+template <typename T>
+template <typename F>
+Rational<T>::Rational(F x, typename enable_if<is_floating_point<F>::value>::type*) {
+  unsigned long long mantissa;
+  int exponent;
+  DecomposeFloat(x, mantissa, exponent);
+  // Already reduced: the mantissa is odd and the denominator a power of 2
+  FromBinary(mantissa, exponent, x < 0, numerator, denominator,
+             integral_constant<bool, IntTraits::IsUnbounded<T>::value>());
+  if (numerator == 0)
+    denominator = 1;
+}
+
+/* maxDenominator as an unsigned long long, at most limit */
+template <typename T>
+unsigned long long ClampDenominator(T maxDenominator, unsigned long long limit, false_type) {
+  unsigned long long n = (unsigned long long) maxDenominator;
+  return n < limit ? n : limit;
+}
+
+template <typename T>
+unsigned long long ClampDenominator(T maxDenominator, unsigned long long limit, true_type) {
+  if (maxDenominator > T(limit))
+    return limit;
+  return (unsigned long long) maxDenominator;
+}
+
+/*
+ * Returns the Rational<T> nearest to x with a denominator of at most
+ * maxDenominator (ties go to the smaller denominator). Uses the continued
+ * fraction of the exact value of x: the last convergent within the bound or
+ * the best semiconvergent after it. maxDenominator is taken as at most 2^62,
+ * and x with at most 127 fractional bits (63 without a 128 bit type), which
+ * only rounds values too small to matter (below 2^-10 without the 128 bit
+ * type). The number of terms is at most MaxTerms. Throws domain_error for
+ * NaN and infinities, invalid_argument if maxDenominator is less than 1 and
+ * overflow_error if the result doesn't fit.
+ */
+const int MaxTerms = 96;
+
+template <typename T, typename F>
+Rational<T> BestApproximation(F x, T maxDenominator) {
+#ifdef RATIONAL_HAS_INT128
+  typedef IntTraits::UInt128 U;
+#else
+  typedef unsigned long long U;
+#endif
+  const int maxShift = int(sizeof(U) * 8) - 1;
+  if (!(maxDenominator >= T(1)))
+    throw invalid_argument("BestApproximation: maxDenominator must be at least 1");
+  unsigned long long mantissa;
+  int exponent;
+  DecomposeFloat(x, mantissa, exponent);
+  if (exponent >= 0)
+    return Rational<T>(x);
+
+  // |x| = p/q with q = 2^k. The mantissa has at most 64 bits so p also fits
+  // in unsigned long long.
+  const int k = -exponent < maxShift ? -exponent : maxShift;
+  U p = mantissa, q = U(1) << k;
+  if (-exponent > maxShift) {
+    int shift = -exponent - maxShift;
+    p = shift > 63 ? 0 : (mantissa >> shift) + ((mantissa >> (shift - 1)) & 1);
+  }
+  U limit = ClampDenominator(maxDenominator, 1ULL << 62,
+    integral_constant<bool, (sizeof(T) > sizeof(long long)) ||
+                            IntTraits::IsUnbounded<T>::value>());
+
+  // Convergents p0/q0 and p1/q1, n/d the remainder
+  U p0 = 0, q0 = 1, p1 = 1, q1 = 0, n = p, d = q;
+  for (int term = 0; d != 0 && term < MaxTerms; ++term) {
+    U a = n / d;
+    if (q1 != 0 && a > (limit - q0) / q1)
+      break;
+    U p2 = p0 + a * p1, q2 = q0 + a * q1;
+    p0 = p1; q0 = q1;
+    p1 = p2; q1 = q2;
+    U r = n - a * d;
+    n = d;
+    d = r;
+  }
+
+  // With the complete quotient t = n/d, the semiconvergent
+  // (p0 + s p1)/(q0 + s q1) is nearer than p1/q1 if q1 t < q0 + 2 s q1
+  if (d != 0) {
+    U s = (limit - q0) / q1;
+    if (s > 0 && CompareFractions(n, d, q0 + 2 * s * q1, q1) < 0) {
+      p1 = p0 + s * p1;
+      q1 = q0 + s * q1;
+    }
+  }
+
+  // The numerator is at most p, the denominator at most maxDenominator
+  T numerator, one;
+  FromBinary((unsigned long long) p1, 0, x < 0, numerator, one,
+             integral_constant<bool, IntTraits::IsUnbounded<T>::value>());
+  return Rational<T>(numerator, T(q1));
+}
+
+// User-defined literals
+// =====================
+
+namespace RationalLiterals {
+
+/* 3_r is Rational<int>(3), so 3_r / 4 is the constant 3/4 */
+inline RATIONAL_CONSTEXPR Rational<int> operator""_r(unsigned long long value) {
+  return Rational<int>(int(value));
+}
+
+/* Same for Rational<long long> */
+inline RATIONAL_CONSTEXPR Rational<long long> operator""_rll(unsigned long long value) {
+  return Rational<long long>((long long) value);
+}
+
+}
+
 // Overloaded stream operator
 // ==========================
 
@@ -358,3 +1241,68 @@ istream& operator>>(istream& is, Rational<T>& item) {
 	
   return is;
 }
+
+// Hashing
+// =======
+
+namespace RationalHashing {
+
+/* The splitmix64 finalizer, every input bit affects every output bit */
+inline RATIONAL_CONSTEXPR unsigned long long Mix(unsigned long long x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+/* The bits of x, folded to 64 for wider types */
+template <typename U>
+RATIONAL_CONSTEXPR unsigned long long Fold(U x, false_type) {
+  return (unsigned long long) x;
+}
+
+template <typename U>
+RATIONAL_CONSTEXPR unsigned long long Fold(U x, true_type) {
+  unsigned long long h = (unsigned long long) x;
+  for (size_t bits = 64; bits < sizeof(U) * 8; bits += 64) {
+    x >>= 64;
+    h = Mix(h) ^ (unsigned long long) x;
+  }
+  return h;
+}
+
+template <typename T>
+RATIONAL_CONSTEXPR unsigned long long Bits(const T& x, true_type) {
+  typedef typename IntTraits::Unsigned<T>::Type U;
+  return Fold(U(x), integral_constant<bool, (sizeof(U) > 8)>());
+}
+
+/* Other types need a std::hash of their own */
+template <typename T>
+unsigned long long Bits(const T& x, false_type) {
+  return hash<T>()(x);
+}
+
+/*
+ * Hash of r. Equal values have equal numerators and denominators (the form
+ * Simplify() keeps them in), so these are hashed as they are.
+ */
+template <typename T>
+RATIONAL_CONSTEXPR size_t Hash(const Rational<T>& r) {
+  typedef integral_constant<bool, IntTraits::IsInteger<T>::value> IsInteger;
+  unsigned long long n = Bits(r.Numerator(), IsInteger());
+  unsigned long long d = Bits(r.Denominator(), IsInteger());
+  return size_t(Mix(n ^ Mix(d + 0x9e3779b97f4a7c15ULL)));
+}
+
+}
+
+namespace std {
+
+template <typename T>
+struct hash<Rational<T> > {
+  size_t operator()(const Rational<T>& r) const { return RationalHashing::Hash(r); }
+};
+
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <iostream>
+#include "Rational.h"
+#include "Overflow.h"
+using namespace std;
+
+namespace RationalAccumulation {
+
+/* Overflow checked arithmetic in W, returning true on overflow like
+   Overflow::. Unbounded types can't overflow. */
+template <typename W, bool = IntTraits::IsUnbounded<W>::value>
+struct Arithmetic {
+  template <typename A, typename B>
+  static bool Add(A a, B b, W& out) { return Overflow::Add(a, b, out); }
+  template <typename A, typename B>
+  static bool Mul(A a, B b, W& out) { return Overflow::Mul(a, b, out); }
+};
+template <typename W>
+struct Arithmetic<W, true> {
+  static bool Add(const W& a, const W& b, W& out) {
+    out = a + b;
+    return false;
+  }
+  static bool Mul(const W& a, const W& b, W& out) {
+    out = a * b;
+    return false;
+  }
+};
+
+}
+
+/*
+ * A running sum (or product) of Rational<T> values that is not reduced after
+ * every step. The numerator and denominator are kept in NextType, and each
+ * +=, -= or *= only multiplies, as long as the products still fit there. When
+ * they don't, the value is reduced and the Rational operator is used instead.
+ * It is also reduced (to exactly what a Rational<T> would hold) on the first
+ * call to Numerator(), Denominator(), Value(), == or << after a change. Adding
+ * values that share a denominator costs a single addition. An unbounded T
+ * such as BigInt never runs out of room, and is only reduced on reading.
+ */
+template <typename T>
+class RationalAccumulator {
+  typedef typename IntTraits::NextType<T>::Type NextType;
+  typedef RationalAccumulation::Arithmetic<NextType> Arithmetic;
+
+private:
+  // Unreduced, denominator positive. Reducing doesn't change the value, so
+  // the const accessors may do it.
+  mutable NextType numerator, denominator;
+  mutable bool reduced;
+
+  /* Adds c/d (d positive) unreduced, false if it doesn't fit */
+  bool AddUnreduced(NextType c, NextType d);
+
+  /* Adds c/d (d positive), see Rational<T>::Add() */
+  RationalAccumulator& Add(NextType c, T d);
+
+  /* Reduces and narrows to T */
+  void Normalize() const;
+public:
+  /* Constructors */
+  RationalAccumulator(const Rational<T>& r = Rational<T>()):
+    numerator(r.Numerator()), denominator(r.Denominator()), reduced(true) { }
+
+  RationalAccumulator& operator+=(const Rational<T>& right) {
+    return Add(right.Numerator(), right.Denominator());
+  }
+  RationalAccumulator& operator-=(const Rational<T>& right) {
+    return Add(-NextType(right.Numerator()), right.Denominator());
+  }
+  RationalAccumulator& operator*=(const Rational<T>& right);
+
+  /* Adds a * b, as the products of the numerators and of the denominators,
+     without reducing it first (for dot products) */
+  RationalAccumulator& AddProduct(const Rational<T>& a, const Rational<T>& b);
+
+  /* Adds the count fractions n[i]/d[i] (d[i] positive) without reducing
+     them, e.g. a block of products in the larger type */
+  template <typename U>
+  RationalAccumulator& AddBlock(const U* n, const U* d, size_t count);
+
+  T Numerator() const {
+    Normalize();
+    return T(numerator);
+  }
+  T Denominator() const {
+    Normalize();
+    return T(denominator);
+  }
+
+  /* The sum as a Rational */
+  Rational<T> Value() const {
+    Rational<T> r;
+    Normalize();
+    r.numerator = T(numerator);
+    r.denominator = T(denominator);
+    return r;
+  }
+  operator Rational<T>() const { return Value(); }
+};
+
+template <typename T>
+bool RationalAccumulator<T>::AddUnreduced(NextType c, NextType d) {
+  NextType n, t, den;
+  if (d == denominator) {
+    if (Arithmetic::Add(numerator, c, n))
+      return false;
+    numerator = n;
+    reduced = false;
+    return true;
+  }
+  if (Arithmetic::Mul(numerator, d, n) || Arithmetic::Mul(c, denominator, t) ||
+      Arithmetic::Add(n, t, n) || Arithmetic::Mul(denominator, d, den))
+    return false;
+  numerator = n;
+  denominator = den;
+  reduced = false;
+  return true;
+}
+
+template <typename T>
+RationalAccumulator<T>& RationalAccumulator<T>::Add(NextType c, T d) {
+  if (AddUnreduced(c, NextType(d)))
+    return *this;
+
+  // Out of headroom
+  Rational<T> r = Value();
+  r.Add(c, d);
+  numerator = r.Numerator();
+  denominator = r.Denominator();
+  return *this;
+}
+
+template <typename T>
+RationalAccumulator<T>&
+RationalAccumulator<T>::operator*=(const Rational<T>& right) {
+  NextType n, den;
+  if (!Arithmetic::Mul(numerator, right.Numerator(), n) &&
+      !Arithmetic::Mul(denominator, right.Denominator(), den)) {
+    numerator = n;
+    denominator = den;
+    reduced = false;
+    return *this;
+  }
+
+  // Out of headroom
+  Rational<T> r = Value();
+  r *= right;
+  numerator = r.Numerator();
+  denominator = r.Denominator();
+  return *this;
+}
+
+template <typename T>
+RationalAccumulator<T>&
+RationalAccumulator<T>::AddProduct(const Rational<T>& a, const Rational<T>& b) {
+  NextType c, d;
+  if (!Arithmetic::Mul(a.Numerator(), b.Numerator(), c) &&
+      !Arithmetic::Mul(a.Denominator(), b.Denominator(), d) && AddUnreduced(c, d))
+    return *this;
+
+  // Out of headroom
+  return *this += a * b;
+}
+
+template <typename T>
+template <typename U>
+RationalAccumulator<T>&
+RationalAccumulator<T>::AddBlock(const U* n, const U* d, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    NextType c = n[i], den = d[i];
+    if (AddUnreduced(c, den))
+      continue;
+
+    // Out of headroom
+    NextType g = c == 0 ? den : Gcd(c, den);
+    if (g < 0)
+      g = -g;
+    Add(c / g, T(den / g));
+  }
+  return *this;
+}
+
+template <typename T>
+void RationalAccumulator<T>::Normalize() const {
+  if (reduced)
+    return;
+  reduced = true;
+  if (numerator == 0) {
+    denominator = 1;
+    return;
+  }
+  NextType g = Gcd(numerator, denominator);
+  if (g < 0)
+    g = -g;
+  numerator = NextType(T(numerator / g));
+  denominator = NextType(T(denominator / g));
+}
+
+// Overloaded relational operators
+// ===============================
+
+template <typename T>
+bool operator==(const RationalAccumulator<T>& left, const Rational<T>& right) {
+  return left.Value() == right;
+}
+
+template <typename T>
+bool operator==(const Rational<T>& left, const RationalAccumulator<T>& right) {
+  return right.Value() == left;
+}
+
+template <typename T>
+bool operator!=(const RationalAccumulator<T>& left, const Rational<T>& right) {
+  return !(left == right);
+}
+
+template <typename T>
+bool operator!=(const Rational<T>& left, const RationalAccumulator<T>& right) {
+  return !(right == left);
+}
+
+// Overloaded stream operator
+// ==========================
+
+template <typename T>
+ostream& operator<<(ostream& os, const RationalAccumulator<T>& r) {
+  return os << r.Value();
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <stddef.h>
+#include <system_error>
+#include "Rational.h"
+#include "RationalVector.h"
+using namespace std;
+
+/*
+ * Parsing and formatting of "n/d" in caller provided char buffers, in the
+ * manner of from_chars() and to_chars(): no locale, no allocation, no
+ * exceptions. Errors are reported through an errc as std::from_chars does:
+ *  - invalid_argument: no number at first, or a denominator of 0 as in "n/0"
+ *    (ptr is first),
+ *  - result_out_of_range: a number that doesn't fit in T (ptr is past it),
+ *  - value_too_large: the output buffer is too small (ptr is last).
+ * The value is left unchanged on error. Numbers are an optional '-' (for
+ * signed types) and decimal digits, with no leading whitespace or '+'.
+ */
+struct FromCharsResult {
+  const char* ptr;
+  errc ec;
+};
+
+struct ToCharsResult {
+  char* ptr;
+  errc ec;
+};
+
+template <typename T>
+struct RationalChars {
+  typedef typename IntTraits::Unsigned<T>::Type U;
+
+  /* Upper bound on the decimal digits of a T */
+  static const size_t MaxDigits = sizeof(T) * 8 * 30103 / 100000 + 1;
+
+  /* Upper bound on the length of a formatted Rational<T> */
+  static const size_t MaxLength = 2 * (MaxDigits + 1) + 1;
+
+  /* Parses an integer of T at first */
+  static FromCharsResult ParseInteger(const char* first, const char* last,
+                                      T& value) {
+    const char* p = first;
+    bool negative = false;
+    if (p != last && *p == '-' && IntTraits::IsSigned<T>::value) {
+      negative = true;
+      ++p;
+    }
+    const char* digits = p;
+    // The largest magnitude, numeric_limits isn't specialized for the 128 bit
+    // types in strict mode
+    U limit = U(~U(0));
+    if (IntTraits::IsSigned<T>::value)
+      limit = (limit >> 1) + U(negative);
+    U magnitude = 0;
+    bool overflow = false;
+    for (; p != last && unsigned(*p - '0') < 10; ++p) {
+      U digit = U(*p - '0');
+      if (magnitude > (limit - digit) / 10)
+        overflow = true;
+      else
+        magnitude = magnitude * 10 + digit;
+    }
+    if (p == digits) {
+      FromCharsResult result = { first, errc::invalid_argument };
+      return result;
+    }
+    FromCharsResult result = { p, overflow ? errc::result_out_of_range : errc() };
+    if (!overflow)
+      value = negative ? T(U(0) - magnitude) : T(magnitude);
+    return result;
+  }
+
+  /* Formats an integer of T at first */
+  static ToCharsResult FormatInteger(char* first, char* last, T value) {
+    static const char pairs[] =
+      "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+      "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+    char digits[MaxDigits];
+    char* end = digits + MaxDigits;
+    char* p = end;
+    U magnitude = value < 0 ? U(0) - U(value) : U(value);
+    while (magnitude >= 100) {
+      unsigned pair = unsigned(magnitude % 100) * 2;
+      magnitude /= 100;
+      *--p = pairs[pair + 1];
+      *--p = pairs[pair];
+    }
+    if (magnitude >= 10) {
+      *--p = pairs[magnitude * 2 + 1];
+      *--p = pairs[magnitude * 2];
+    } else {
+      *--p = char('0' + magnitude);
+    }
+
+    size_t length = size_t(end - p) + (value < 0);
+    if (size_t(last - first) < length) {
+      ToCharsResult result = { last, errc::value_too_large };
+      return result;
+    }
+    if (value < 0)
+      *first++ = '-';
+    while (p != end)
+      *first++ = *p++;
+    ToCharsResult result = { first, errc() };
+    return result;
+  }
+
+  static FromCharsResult FromChars(const char* first, const char* last,
+                                   Rational<T>& value, bool reduced) {
+    T n = 0, d = 1;
+    FromCharsResult result = ParseInteger(first, last, n);
+    if (result.ec != errc())
+      return result;
+
+    // Without digits after the slash only the numerator matches
+    if (result.ptr != last && *result.ptr == '/') {
+      FromCharsResult denominator = ParseInteger(result.ptr + 1, last, d);
+      if (denominator.ec == errc::result_out_of_range)
+        return denominator;
+      if (denominator.ec == errc()) {
+        if (d == 0) {
+          FromCharsResult invalid = { first, errc::invalid_argument };
+          return invalid;
+        }
+        result.ptr = denominator.ptr;
+      }
+    }
+
+    if (!reduced) {
+      value.Set(n, d);
+      return result;
+    }
+    if (n == 0)
+      d = 1;
+    if (d < 0) {
+      n = -n;
+      d = -d;
+    }
+    value.numerator = n;
+    value.denominator = d;
+    return result;
+  }
+
+  static ToCharsResult ToChars(char* first, char* last, const Rational<T>& value) {
+    ToCharsResult result = FormatInteger(first, last, value.numerator);
+    if (result.ec != errc())
+      return result;
+    if (result.ptr == last) {
+      result.ec = errc::value_too_large;
+      return result;
+    }
+    *result.ptr = '/';
+    result = FormatInteger(result.ptr + 1, last, value.denominator);
+    if (result.ec != errc())
+      result.ptr = last;
+    return result;
+  }
+};
+
+/*
+ * Parses "n/d" or "n" at first into value. With reduced true the input is
+ * trusted to be in lowest terms and no GCD is computed (the denominator may
+ * still carry the sign). "n/0" is invalid_argument, with ptr at first.
+ */
+template <typename T>
+FromCharsResult FromChars(const char* first, const char* last, Rational<T>& value,
+                          bool reduced = false) {
+  return RationalChars<T>::FromChars(first, last, value, reduced);
+}
+
+/*
+ * Parses all of [first, last) into values, appending to it. Numbers are
+ * separated by any run of spaces, tabs, newlines and commas. On error ptr is
+ * where the failing number starts (or ends, for result_out_of_range) and the
+ * numbers before it have been appended.
+ */
+template <typename T>
+FromCharsResult FromChars(const char* first, const char* last,
+                          RationalVector<T>& values, bool reduced = false) {
+  Rational<T> value;
+  for (;;) {
+    while (first != last && (*first == ' ' || *first == '\t' || *first == '\n' ||
+                             *first == '\r' || *first == ','))
+      ++first;
+    if (first == last) {
+      FromCharsResult result = { last, errc() };
+      return result;
+    }
+    FromCharsResult result = RationalChars<T>::FromChars(first, last, value, reduced);
+    if (result.ec != errc())
+      return result;
+    values.PushBack(value);
+    first = result.ptr;
+  }
+}
+
+/*
+ * Formats value as "n/d" (like operator<<) at first. No terminating null is
+ * written. RationalChars<T>::MaxLength chars are always enough.
+ */
+template <typename T>
+ToCharsResult ToChars(char* first, char* last, const Rational<T>& value) {
+  return RationalChars<T>::ToChars(first, last, value);
+}
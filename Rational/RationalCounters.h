@@ -0,0 +1,160 @@
+#pragma once
+
+#include <iostream>
+#include "IntTraits.h"
+#ifdef RATIONAL_COUNTERS
+#include <atomic>
+#include <mutex>
+#include <vector>
+#endif
+using namespace std;
+
+/*
+ * Instrumentation counters, compiled in only when RATIONAL_COUNTERS is
+ * defined (the same way in every translation unit). Otherwise
+ * RATIONAL_COUNT() expands to nothing that is evaluated and Collect() returns
+ * zeros. Each thread counts in its own thread_local block without
+ * synchronization; Collect() adds up the blocks of the running threads and
+ * the counts of the threads that have exited. Nothing is counted during
+ * constant evaluation.
+ */
+namespace RationalCounters {
+
+enum Counter {
+  /* Calls of Rational<T>::Simplify() */
+  Simplifications,
+  /* Loop iterations in EuclidGcd() and BinaryGcd() */
+  GcdIterations,
+  /* GCDs computed to reduce a result that turned out to be 1 */
+  TrivialReductions,
+  /* Results narrowed from the wider type to T that didn't fit */
+  LossyNarrowings,
+  /* Calls of Compare() and of == between Rationals */
+  Comparisons,
+  CounterCount
+};
+
+inline const char* Name(Counter counter) {
+  static const char* const names[CounterCount] = {
+    "simplifications", "gcd iterations", "trivial reductions",
+    "lossy narrowings", "comparisons"
+  };
+  return names[counter];
+}
+
+#ifdef RATIONAL_COUNTERS
+const bool Enabled = true;
+#else
+const bool Enabled = false;
+#endif
+
+/* Totals of the counters */
+struct Counts {
+  unsigned long long value[CounterCount];
+
+  Counts() {
+    for (int c = 0; c < CounterCount; ++c)
+      value[c] = 0;
+  }
+  unsigned long long operator[](Counter counter) const { return value[counter]; }
+};
+
+#ifdef RATIONAL_COUNTERS
+
+struct ThreadCounts;
+
+struct Registry {
+  mutex lock;
+  vector<ThreadCounts*> threads;
+  Counts exited;
+};
+
+inline Registry& GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+/* The counters of one thread. Only that thread writes them, relaxed atomics
+   just make reading them from Collect() well defined. */
+struct ThreadCounts {
+  atomic<unsigned long long> value[CounterCount];
+
+  ThreadCounts() {
+    for (int c = 0; c < CounterCount; ++c)
+      value[c].store(0, memory_order_relaxed);
+    Registry& registry = GetRegistry();
+    lock_guard<mutex> guard(registry.lock);
+    registry.threads.push_back(this);
+  }
+  ~ThreadCounts() {
+    Registry& registry = GetRegistry();
+    lock_guard<mutex> guard(registry.lock);
+    for (int c = 0; c < CounterCount; ++c)
+      registry.exited.value[c] += value[c].load(memory_order_relaxed);
+    for (size_t i = 0; i < registry.threads.size(); ++i)
+      if (registry.threads[i] == this) {
+        registry.threads.erase(registry.threads.begin() + i);
+        break;
+      }
+  }
+};
+
+inline ThreadCounts& Local() {
+  static thread_local ThreadCounts counts;
+  return counts;
+}
+
+inline void Add(Counter counter, unsigned long long n) {
+  atomic<unsigned long long>& value = Local().value[counter];
+  value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+#endif
+
+/* Totals over all threads, so far */
+inline Counts Collect() {
+  Counts counts;
+#ifdef RATIONAL_COUNTERS
+  Registry& registry = GetRegistry();
+  lock_guard<mutex> guard(registry.lock);
+  counts = registry.exited;
+  for (ThreadCounts* thread : registry.threads)
+    for (int c = 0; c < CounterCount; ++c)
+      counts.value[c] += thread->value[c].load(memory_order_relaxed);
+#endif
+  return counts;
+}
+
+/* Sets all counters to zero. Counts made by other threads while this runs
+   may survive it or be lost. */
+inline void Reset() {
+#ifdef RATIONAL_COUNTERS
+  Registry& registry = GetRegistry();
+  lock_guard<mutex> guard(registry.lock);
+  registry.exited = Counts();
+  for (ThreadCounts* thread : registry.threads)
+    for (int c = 0; c < CounterCount; ++c)
+      thread->value[c].store(0, memory_order_relaxed);
+#endif
+}
+
+/* One line per counter */
+inline ostream& operator<<(ostream& os, const Counts& counts) {
+  for (int c = 0; c < CounterCount; ++c)
+    os << Name(Counter(c)) << ": " << counts.value[c] << '\n';
+  return os;
+}
+
+}
+
+/* Adds n to the counter of this thread */
+#if defined(RATIONAL_COUNTERS) && defined(RATIONAL_CONSTANT_EVALUATED)
+#define RATIONAL_COUNT(counter, n) \
+  (RATIONAL_CONSTANT_EVALUATED() ? void() : \
+   RationalCounters::Add(RationalCounters::counter, (unsigned long long) (n)))
+#elif defined(RATIONAL_COUNTERS)
+#define RATIONAL_COUNT(counter, n) \
+  RationalCounters::Add(RationalCounters::counter, (unsigned long long) (n))
+#else
+#define RATIONAL_COUNT(counter, n) ((void) sizeof(n))
+#endif
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include "Rational.h"
+#include "Overflow.h"
+using namespace std;
+
+/*
+ * Fused evaluation of compound expressions. Lazy(a) * b + Lazy(c) * d - e
+ * builds an expression instead of a Rational per operator; converting it to
+ * a Rational (or Evaluate()) computes the whole expression unreduced in the
+ * NextType of the result type, adding over a common denominator where the
+ * operands share one, and reduces once at the end. Operands can be Rationals,
+ * integers and other expressions, and the result type is the one the
+ * Rational operators would give. If an unreduced intermediate doesn't fit,
+ * a divisor is zero or the result doesn't fit in the result type, the
+ * expression is evaluated again with the Rational operators, so the result
+ * is always theirs. Unbounded types (BigRational) never fall back, and their
+ * intermediates are moved rather than copied.
+ *
+ * Expressions refer to their Rational operands, which must outlive them.
+ */
+namespace RationalExpressions {
+
+/* An unreduced n/d, d positive */
+template <typename W>
+struct Fraction {
+  W n, d;
+};
+
+/* Overflow checked arithmetic on W, returning true on overflow like
+   Overflow::. Unbounded types can't overflow. */
+template <typename W, bool = IntTraits::IsUnbounded<W>::value>
+struct Arithmetic {
+  static bool Add(W a, W b, W& out) { return Overflow::Add(a, b, out); }
+  static bool Sub(W a, W b, W& out) { return Overflow::Sub(a, b, out); }
+  static bool Mul(W a, W b, W& out) { return Overflow::Mul(a, b, out); }
+};
+/* Add() and Mul() reuse (and so consume) their first operand */
+template <typename W>
+struct Arithmetic<W, true> {
+  static bool Add(W& a, const W& b, W& out) {
+    a += b;
+    out = std::move(a);
+    return false;
+  }
+  static bool Sub(const W& a, const W& b, W& out) {
+    out = a - b;
+    return false;
+  }
+  static bool Mul(W& a, const W& b, W& out) {
+    a *= b;
+    out = std::move(a);
+    return false;
+  }
+};
+
+template <typename Node>
+class Expression;
+
+template <typename Node>
+Rational<typename Node::Type> Evaluate(const Expression<Node>& e);
+
+/* A Rational<T> operand */
+template <typename T>
+class Operand {
+private:
+  const Rational<T>& value;
+public:
+  typedef T Type;
+
+  explicit Operand(const Rational<T>& value): value(value) { }
+
+  template <typename W>
+  bool Evaluate(Fraction<W>& out) const {
+    out.n = W(value.Numerator());
+    out.d = W(value.Denominator());
+    return true;
+  }
+  const Rational<T>& Eager() const { return value; }
+};
+
+/* An integer operand */
+template <typename T>
+class Integer {
+private:
+  T value;
+public:
+  typedef T Type;
+
+  explicit Integer(const T& value): value(value) { }
+
+  template <typename W>
+  bool Evaluate(Fraction<W>& out) const {
+    out.n = W(value);
+    out.d = W(1);
+    return true;
+  }
+  const T& Eager() const { return value; }
+};
+
+/* Nodes. Type is the type of the result, Evaluate() computes the unreduced
+   value (returning false if it can't be done exactly) and Eager() the
+   value with the Rational operators. */
+
+/* Operations: Apply() combines the unreduced operands, returning false if
+   that can't be done exactly, Eager() uses the Rational operators */
+struct Plus {
+  template <typename W>
+  static bool Apply(Fraction<W>& a, Fraction<W>& b, Fraction<W>& out) {
+    typedef Arithmetic<W> A;
+    if (a.d == b.d) {
+      out.d = std::move(a.d);
+      return !A::Add(a.n, b.n, out.n);
+    }
+    W x, y;
+    return !A::Mul(a.n, b.d, x) && !A::Mul(b.n, a.d, y) &&
+           !A::Add(x, y, out.n) && !A::Mul(a.d, b.d, out.d);
+  }
+  template <typename L, typename R>
+  static auto Eager(const L& left, const R& right) -> decltype(left + right) {
+    return left + right;
+  }
+};
+
+struct Minus {
+  template <typename W>
+  static bool Apply(Fraction<W>& a, Fraction<W>& b, Fraction<W>& out) {
+    typedef Arithmetic<W> A;
+    if (a.d == b.d) {
+      out.d = std::move(a.d);
+      return !A::Sub(a.n, b.n, out.n);
+    }
+    W x, y;
+    return !A::Mul(a.n, b.d, x) && !A::Mul(b.n, a.d, y) &&
+           !A::Sub(x, y, out.n) && !A::Mul(a.d, b.d, out.d);
+  }
+  template <typename L, typename R>
+  static auto Eager(const L& left, const R& right) -> decltype(left - right) {
+    return left - right;
+  }
+};
+
+struct Times {
+  template <typename W>
+  static bool Apply(Fraction<W>& a, Fraction<W>& b, Fraction<W>& out) {
+    typedef Arithmetic<W> A;
+    return !A::Mul(a.n, b.n, out.n) && !A::Mul(a.d, b.d, out.d);
+  }
+  template <typename L, typename R>
+  static auto Eager(const L& left, const R& right) -> decltype(left * right) {
+    return left * right;
+  }
+};
+
+struct Divided {
+  template <typename W>
+  static bool Apply(Fraction<W>& a, Fraction<W>& b, Fraction<W>& out) {
+    typedef Arithmetic<W> A;
+    // Division by zero is left to the Rational operators
+    if (b.n == W(0))
+      return false;
+    if (!(b.n < W(0)))
+      return !A::Mul(a.n, b.d, out.n) && !A::Mul(a.d, b.n, out.d);
+    W n, d;
+    return !A::Mul(a.n, b.d, n) && !A::Mul(a.d, b.n, d) &&
+           !A::Sub(W(0), n, out.n) && !A::Sub(W(0), d, out.d);
+  }
+  template <typename L, typename R>
+  static auto Eager(const L& left, const R& right) -> decltype(left / right) {
+    return left / right;
+  }
+};
+
+template <typename Op, typename L, typename R>
+class Binary {
+private:
+  L left;
+  R right;
+public:
+  typedef typename IntTraits::LargestType<typename L::Type, typename R::Type>::Type Type;
+
+  Binary(const L& left, const R& right): left(left), right(right) { }
+
+  template <typename W>
+  bool Evaluate(Fraction<W>& out) const {
+    Fraction<W> a, b;
+    return left.Evaluate(a) && right.Evaluate(b) && Op::Apply(a, b, out);
+  }
+  Rational<Type> Eager() const { return Op::Eager(left.Eager(), right.Eager()); }
+};
+
+template <typename E>
+class Negation {
+private:
+  E operand;
+public:
+  typedef typename E::Type Type;
+
+  explicit Negation(const E& operand): operand(operand) { }
+
+  template <typename W>
+  bool Evaluate(Fraction<W>& out) const {
+    Fraction<W> a;
+    if (!operand.Evaluate(a))
+      return false;
+    out.d = std::move(a.d);
+    return !Arithmetic<W>::Sub(W(0), a.n, out.n);
+  }
+  Rational<Type> Eager() const { return -Rational<Type>(operand.Eager()); }
+};
+
+/*
+ * An expression, the node at its root. Converts to a Rational by Evaluate().
+ */
+template <typename Node>
+class Expression {
+private:
+  Node node;
+public:
+  typedef typename Node::Type Type;
+
+  explicit Expression(const Node& node): node(node) { }
+
+  const Node& Root() const { return node; }
+
+  template <typename T>
+  operator Rational<T>() const { return Rational<T>(Evaluate(*this)); }
+};
+
+/* True if wide is also a Rational<T> */
+template <typename T, typename W>
+bool Fits(const Rational<W>& wide, false_type) {
+  return W(T(wide.Numerator())) == wide.Numerator() &&
+         W(T(wide.Denominator())) == wide.Denominator();
+}
+
+template <typename T, typename W>
+bool Fits(const Rational<W>&, true_type) {
+  return true;
+}
+
+/*
+ * The value of e: reduced once in the NextType of the result type, or
+ * evaluated with the Rational operators if that isn't exact.
+ */
+template <typename Node>
+Rational<typename Node::Type> Evaluate(const Expression<Node>& e) {
+  typedef typename Node::Type T;
+  typedef typename IntTraits::NextType<T>::Type W;
+  Fraction<W> f;
+  if (e.Root().Evaluate(f)) {
+    Rational<W> wide(std::move(f.n), std::move(f.d));
+    if (Fits<T>(wide, integral_constant<bool, is_same<T, W>::value>()))
+      return Rational<T>(std::move(wide));
+  }
+  return e.Root().Eager();
+}
+
+template <typename Op, typename L, typename R>
+Expression<Binary<Op, L, R> > Combine(const L& left, const R& right) {
+  return Expression<Binary<Op, L, R> >(Binary<Op, L, R>(left, right));
+}
+
+// Operators
+// =========
+// An expression with an expression, a Rational or an integer on either side.
+// These are more specialized than the mixed operators of Rational.h.
+
+#define RATIONAL_EXPRESSION_OPERATOR(op, Op) \
+  template <typename L, typename R> \
+  Expression<Binary<Op, L, R> > \
+  operator op(const Expression<L>& left, const Expression<R>& right) { \
+    return Combine<Op>(left.Root(), right.Root()); \
+  } \
+  template <typename L, typename T> \
+  Expression<Binary<Op, L, Operand<T> > > \
+  operator op(const Expression<L>& left, const Rational<T>& right) { \
+    return Combine<Op>(left.Root(), Operand<T>(right)); \
+  } \
+  template <typename T, typename R> \
+  Expression<Binary<Op, Operand<T>, R> > \
+  operator op(const Rational<T>& left, const Expression<R>& right) { \
+    return Combine<Op>(Operand<T>(left), right.Root()); \
+  } \
+  template <typename L, typename T> \
+  typename enable_if<IntTraits::IsInteger<T>::value, \
+                     Expression<Binary<Op, L, Integer<T> > > >::type \
+  operator op(const Expression<L>& left, const T& right) { \
+    return Combine<Op>(left.Root(), Integer<T>(right)); \
+  } \
+  template <typename T, typename R> \
+  typename enable_if<IntTraits::IsInteger<T>::value, \
+                     Expression<Binary<Op, Integer<T>, R> > >::type \
+  operator op(const T& left, const Expression<R>& right) { \
+    return Combine<Op>(Integer<T>(left), right.Root()); \
+  }
+
+RATIONAL_EXPRESSION_OPERATOR(+, Plus)
+RATIONAL_EXPRESSION_OPERATOR(-, Minus)
+RATIONAL_EXPRESSION_OPERATOR(*, Times)
+RATIONAL_EXPRESSION_OPERATOR(/, Divided)
+
+#undef RATIONAL_EXPRESSION_OPERATOR
+
+template <typename Node>
+Expression<Negation<Node> > operator-(const Expression<Node>& e) {
+  return Expression<Negation<Node> >(Negation<Node>(e.Root()));
+}
+
+}
+
+/*
+ * Starts a fused expression with operand r, e.g. Rational<int> x =
+ * Lazy(a) * b + c. See RationalExpressions.
+ */
+template <typename T>
+RationalExpressions::Expression<RationalExpressions::Operand<T> > Lazy(const Rational<T>& r) {
+  typedef RationalExpressions::Operand<T> Node;
+  return RationalExpressions::Expression<Node>(Node(r));
+}
+
+using RationalExpressions::Evaluate;
@@ -0,0 +1,419 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include "Rational.h"
+#include "RationalVector.h"
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+/*
+ * Binary columnar format for sequences of Rational<T>.
+ *
+ * A 32 byte header (all fields little endian):
+ *   0  magic "RATC"
+ *   4  uint16 version (1)
+ *   6  uint8  sizeof(T)
+ *   7  uint8  flags: Signed, Reduced, Varint
+ *   8  uint64 number of values
+ *  16  uint64 size in bytes of the numerator column
+ *  24  uint64 size in bytes of the denominator column
+ * followed by the numerator column, padding to a multiple of ColumnAlignment
+ * and the denominator column. With fixed width encoding a column is the
+ * little endian T values. With varint encoding numerators are zigzag encoded
+ * and both columns are LEB128 varints. Reduced records that the values are in
+ * lowest terms with the sign on the numerator, as Rational keeps them.
+ */
+namespace RationalFormat {
+
+const char Magic[4] = { 'R', 'A', 'T', 'C' };
+const uint16_t Version = 1;
+const size_t HeaderSize = 32;
+const size_t ColumnAlignment = 16;
+
+enum Flags { Signed = 1, Reduced = 2, Varint = 4 };
+enum Encoding { FixedWidth, VarintEncoding };
+
+struct Header {
+  uint8_t width;
+  uint8_t flags;
+  uint64_t count, numeratorBytes, denominatorBytes;
+};
+
+inline bool IsLittleEndian() {
+  const uint16_t one = 1;
+  unsigned char first;
+  memcpy(&first, &one, 1);
+  return first == 1;
+}
+
+/* Stores the low bytes bytes of x at p, least significant first */
+template <typename U>
+void StoreLittle(unsigned char* p, U x, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i, x >>= 4, x >>= 4)
+    p[i] = (unsigned char) (x & 0xFF);
+}
+
+template <typename U>
+U LoadLittle(const unsigned char* p, size_t bytes) {
+  U x = 0;
+  for (size_t i = bytes; i-- > 0;)
+    x = U(U(x << 4) << 4) | p[i];
+  return x;
+}
+
+/* Bytes of padding after a column of the given size */
+inline size_t Padding(uint64_t bytes) {
+  return size_t((ColumnAlignment - bytes % ColumnAlignment) % ColumnAlignment);
+}
+
+/* Zigzag maps signed values to unsigned ones with small magnitudes first:
+   0, -1, 1, -2, ... Unsigned values are left as they are. */
+template <typename T>
+typename IntTraits::Unsigned<T>::Type ZigZag(T x) {
+  typedef typename IntTraits::Unsigned<T>::Type U;
+  if (!IntTraits::IsSigned<T>::value)
+    return U(x);
+  return x < 0 ? U(U(~U(x)) << 1) | 1 : U(U(x) << 1);
+}
+
+template <typename T>
+T UnZigZag(typename IntTraits::Unsigned<T>::Type u) {
+  typedef typename IntTraits::Unsigned<T>::Type U;
+  if (!IntTraits::IsSigned<T>::value)
+    return T(u);
+  return (u & 1) ? T(~U(u >> 1)) : T(u >> 1);
+}
+
+template <typename U>
+void PutVarint(ostream& os, U u) {
+  unsigned char bytes[(sizeof(U) * 8 + 6) / 7];
+  size_t length = 0;
+  do {
+    unsigned char byte = (unsigned char) (u & 0x7F);
+    u >>= 7;
+    bytes[length++] = byte | (u != 0 ? 0x80 : 0);
+  } while (u != 0);
+  os.write((const char*) bytes, length);
+}
+
+template <typename U>
+size_t VarintLength(U u) {
+  size_t length = 1;
+  while (u >>= 7)
+    ++length;
+  return length;
+}
+
+/* Reads a varint of U at p, returns false if it is truncated, too long,
+   overflows U or isn't in its shortest form (ends in a zero byte), as
+   PutVarint() never writes those */
+template <typename U>
+bool GetVarint(const unsigned char*& p, const unsigned char* last, U& u) {
+  const unsigned bits = sizeof(U) * 8;
+  u = 0;
+  for (unsigned shift = 0; p != last && shift < bits; shift += 7) {
+    unsigned char byte = *p++;
+    if (bits - shift < 7 && (byte & 0x7F) >> (bits - shift) != 0)
+      return false;
+    u |= U(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return byte != 0 || shift == 0;
+  }
+  return false;
+}
+
+inline Header ReadHeader(const unsigned char* data, size_t size) {
+  if (size < HeaderSize || memcmp(data, Magic, 4) != 0)
+    throw runtime_error("RationalFormat: not a rational column file");
+  if (LoadLittle<uint16_t>(data + 4, 2) != Version)
+    throw runtime_error("RationalFormat: unsupported version");
+  Header header;
+  header.width = data[6];
+  header.flags = data[7];
+  header.count = LoadLittle<uint64_t>(data + 8, 8);
+  header.numeratorBytes = LoadLittle<uint64_t>(data + 16, 8);
+  header.denominatorBytes = LoadLittle<uint64_t>(data + 24, 8);
+  uint64_t available = size - HeaderSize;
+  if (header.numeratorBytes > available)
+    throw runtime_error("RationalFormat: truncated file");
+  available -= header.numeratorBytes;
+  uint64_t padding = Padding(header.numeratorBytes);
+  if (padding > available || header.denominatorBytes > available - padding)
+    throw runtime_error("RationalFormat: truncated file");
+  return header;
+}
+
+/* Checks that header describes columns of T */
+template <typename T>
+void CheckType(const Header& header) {
+  if (header.width != sizeof(T) ||
+      ((header.flags & Signed) != 0) != IntTraits::IsSigned<T>::value)
+    throw runtime_error("RationalFormat: the file holds another integer type");
+  // Every value takes at least one byte of each column
+  bool sizes = header.count <= header.numeratorBytes &&
+               header.count <= header.denominatorBytes;
+  if (!(header.flags & Varint))
+    sizes = header.count <= header.numeratorBytes / sizeof(T) &&
+            header.numeratorBytes == header.count * sizeof(T) &&
+            header.denominatorBytes == header.count * sizeof(T);
+  if (!sizes)
+    throw runtime_error("RationalFormat: bad column size");
+}
+
+}
+
+/*
+ * Writes count fractions numerators[i]/denominators[i] to os in the format
+ * above. reduced must only be true if they are in lowest terms with positive
+ * denominators.
+ */
+template <typename T>
+void WriteColumns(ostream& os, const T* numerators, const T* denominators,
+                  size_t count, bool reduced,
+                  RationalFormat::Encoding encoding = RationalFormat::FixedWidth) {
+  typedef typename IntTraits::Unsigned<T>::Type U;
+  using namespace RationalFormat;
+  bool varint = encoding == VarintEncoding;
+
+  // The column sizes go in the header, so varint columns are sized first
+  uint64_t numeratorBytes = uint64_t(count) * sizeof(T);
+  uint64_t denominatorBytes = numeratorBytes;
+  if (varint) {
+    numeratorBytes = denominatorBytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+      numeratorBytes += VarintLength(ZigZag(numerators[i]));
+      denominatorBytes += VarintLength(U(denominators[i]));
+    }
+  }
+
+  unsigned char header[HeaderSize];
+  memcpy(header, Magic, 4);
+  StoreLittle(header + 4, Version, 2);
+  header[6] = (unsigned char) sizeof(T);
+  header[7] = (unsigned char) ((IntTraits::IsSigned<T>::value ? Signed : 0) |
+                               (reduced ? Reduced : 0) | (varint ? Varint : 0));
+  StoreLittle(header + 8, uint64_t(count), 8);
+  StoreLittle(header + 16, numeratorBytes, 8);
+  StoreLittle(header + 24, denominatorBytes, 8);
+  os.write((const char*) header, HeaderSize);
+
+  const T* columns[2] = { numerators, denominators };
+  const char padding[ColumnAlignment] = { 0 };
+  for (int c = 0; c < 2; ++c) {
+    if (c == 1)
+      os.write(padding, Padding(numeratorBytes));
+    const T* column = columns[c];
+    if (varint) {
+      for (size_t i = 0; i < count; ++i)
+        PutVarint(os, c == 0 ? ZigZag(column[i]) : U(column[i]));
+    } else if (IsLittleEndian()) {
+      os.write((const char*) column, count * sizeof(T));
+    } else {
+      unsigned char bytes[sizeof(T)];
+      for (size_t i = 0; i < count; ++i) {
+        StoreLittle(bytes, U(column[i]), sizeof(T));
+        os.write((const char*) bytes, sizeof(T));
+      }
+    }
+  }
+}
+
+template <typename T>
+void WriteColumns(ostream& os, const RationalVector<T>& values,
+                  RationalFormat::Encoding encoding = RationalFormat::FixedWidth) {
+  WriteColumns(os, values.Numerators(), values.Denominators(), values.Size(),
+               true, encoding);
+}
+
+/*
+ * A read-only view of the Rational<T> values of a fixed width file held in
+ * memory at data, without copying. The memory must outlive the view, be
+ * aligned for T and the host must be little endian. Elements are read by
+ * value; if the file isn't marked reduced they are reduced on access.
+ */
+template <typename T>
+class RationalColumnView {
+private:
+  const T* numerators;
+  const T* denominators;
+  size_t size;
+  bool reduced;
+public:
+  RationalColumnView(const void* data, size_t bytes) {
+    using namespace RationalFormat;
+    const unsigned char* p = (const unsigned char*) data;
+    Header header = ReadHeader(p, bytes);
+    CheckType<T>(header);
+    if (header.flags & Varint)
+      throw runtime_error("RationalColumnView: varint columns can't be viewed, use ReadColumns()");
+    if (!IsLittleEndian())
+      throw runtime_error("RationalColumnView: big endian host, use ReadColumns()");
+    if (uintptr_t(p + HeaderSize) % sizeof(T) != 0)
+      throw invalid_argument("RationalColumnView: data isn't aligned for T");
+    numerators = (const T*) (p + HeaderSize);
+    denominators = (const T*) (p + HeaderSize + header.numeratorBytes +
+                               Padding(header.numeratorBytes));
+    size = size_t(header.count);
+    reduced = (header.flags & RationalFormat::Reduced) != 0;
+  }
+
+  size_t Size() const { return size; }
+  bool Empty() const { return size == 0; }
+  bool Reduced() const { return reduced; }
+
+  Rational<T> operator[](size_t i) const {
+    return Element(numerators[i], denominators[i], reduced);
+  }
+
+  /* The value of a stored fraction, reduced here unless the file is */
+  static Rational<T> Element(T numerator, T denominator, bool reduced) {
+    if (!reduced)
+      return Rational<T>(numerator, denominator);
+    return Rational<T>::FromReducedUnchecked(numerator, denominator);
+  }
+
+  /* The columns as stored */
+  const T* Numerators() const { return numerators; }
+  const T* Denominators() const { return denominators; }
+};
+
+/*
+ * Decodes a file of either encoding held in memory at data.
+ */
+template <typename T>
+RationalVector<T> ReadColumns(const void* data, size_t size) {
+  typedef typename IntTraits::Unsigned<T>::Type U;
+  using namespace RationalFormat;
+  const unsigned char* bytes = (const unsigned char*) data;
+  Header header = ReadHeader(bytes, size);
+  CheckType<T>(header);
+
+  const unsigned char* n = bytes + HeaderSize;
+  const unsigned char* nEnd = n + header.numeratorBytes;
+  const unsigned char* d = nEnd + Padding(header.numeratorBytes);
+  const unsigned char* dEnd = d + header.denominatorBytes;
+  bool reduced = (header.flags & Reduced) != 0;
+  RationalVector<T> values;
+  values.Reserve(size_t(header.count));
+  for (uint64_t i = 0; i < header.count; ++i) {
+    T numerator, denominator;
+    if (header.flags & Varint) {
+      U un, ud;
+      if (!GetVarint(n, nEnd, un) || !GetVarint(d, dEnd, ud))
+        throw runtime_error("RationalFormat: bad varint");
+      numerator = UnZigZag<T>(un);
+      denominator = T(ud);
+    } else {
+      numerator = T(LoadLittle<U>(n + i * sizeof(T), sizeof(T)));
+      denominator = T(LoadLittle<U>(d + i * sizeof(T), sizeof(T)));
+    }
+    values.PushBack(RationalColumnView<T>::Element(numerator, denominator, reduced));
+  }
+  if ((header.flags & Varint) && (n != nEnd || d != dEnd))
+    throw runtime_error("RationalFormat: bad column size");
+  return values;
+}
+
+/*
+ * A file mapped read-only into memory. Throws runtime_error if it can't be
+ * opened or mapped.
+ */
+class MappedFile {
+private:
+  const void* data;
+  size_t size;
+#if defined(_WIN32)
+  HANDLE file, mapping;
+#endif
+
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+public:
+  explicit MappedFile(const string& path);
+  ~MappedFile();
+
+  const void* Data() const { return data; }
+  size_t Size() const { return size; }
+};
+
+#if defined(_WIN32)
+
+inline MappedFile::MappedFile(const string& path): data(0), size(0), mapping(0) {
+  file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if (file == INVALID_HANDLE_VALUE)
+    throw runtime_error("MappedFile: can't open " + path);
+  LARGE_INTEGER length;
+  if (!GetFileSizeEx(file, &length) ||
+      !(mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0)) ||
+      !(data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0))) {
+    if (mapping)
+      CloseHandle(mapping);
+    CloseHandle(file);
+    throw runtime_error("MappedFile: can't map " + path);
+  }
+  size = size_t(length.QuadPart);
+}
+
+inline MappedFile::~MappedFile() {
+  UnmapViewOfFile(data);
+  CloseHandle(mapping);
+  CloseHandle(file);
+}
+
+#else
+
+inline MappedFile::MappedFile(const string& path): data(0), size(0) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw runtime_error("MappedFile: can't open " + path);
+  struct stat status;
+  void* p = MAP_FAILED;
+  if (fstat(fd, &status) == 0 && status.st_size > 0)
+    p = mmap(0, size_t(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    throw runtime_error("MappedFile: can't map " + path);
+  data = p;
+  size = size_t(status.st_size);
+}
+
+inline MappedFile::~MappedFile() {
+  munmap(const_cast<void*>(data), size);
+}
+
+#endif
+
+/*
+ * A fixed width rational column file mapped into memory and viewed as
+ * Rational<T> values. Opening costs no parse pass, pages are read on access.
+ */
+template <typename T>
+class MappedRationalFile {
+private:
+  MappedFile file;
+  RationalColumnView<T> view;
+public:
+  explicit MappedRationalFile(const string& path):
+    file(path), view(file.Data(), file.Size()) { }
+
+  size_t Size() const { return view.Size(); }
+  bool Empty() const { return view.Empty(); }
+  Rational<T> operator[](size_t i) const { return view[i]; }
+  const RationalColumnView<T>& View() const { return view; }
+};
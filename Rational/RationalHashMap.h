@@ -0,0 +1,247 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "Rational.h"
+using namespace std;
+
+/*
+ * Open addressing hash tables keyed by Rational<T>: RationalHashMap<T, V> and
+ * RationalHashSet<T>. The keys (and values) are stored inline in one array
+ * with linear probing, so a lookup touches consecutive slots and inserting
+ * allocates only when the table grows. A denominator of 0 marks an empty
+ * slot, so keys with one (1/0, or x / 0 of the operators, which don't
+ * report division by zero) can't be stored: inserting them throws
+ * invalid_argument, and they are never found. Erasing shifts the following
+ * entries back rather than leaving tombstones. The table doubles when it is
+ * 3/4 full. Inserting or erasing invalidates pointers to values.
+ */
+template <typename T, typename Slot, typename Hash>
+class RationalTable {
+private:
+  vector<Slot> slots;
+  size_t size;
+  Hash hasher;
+
+  static bool IsEmpty(const Slot& slot) { return slot.key.denominator == T(0); }
+  static void MakeEmpty(Slot& slot) {
+    slot = Slot();
+    slot.key.denominator = T(0);
+  }
+
+  size_t Mask() const { return slots.size() - 1; }
+  size_t Home(const Rational<T>& key) const { return hasher(key) & Mask(); }
+
+  /* Index of the slot of key, or of the empty slot where it would go */
+  size_t Probe(const Rational<T>& key) const {
+    size_t i = Home(key);
+    while (!IsEmpty(slots[i]) && !(slots[i].key == key))
+      i = (i + 1) & Mask();
+    return i;
+  }
+
+  void Rehash(size_t capacity) {
+    vector<Slot> old(capacity);
+    old.swap(slots);
+    for (Slot& slot : slots)
+      MakeEmpty(slot);
+    for (Slot& slot : old)
+      if (!IsEmpty(slot))
+        slots[Probe(slot.key)] = std::move(slot);
+  }
+
+  /* Smallest power of 2 capacity that holds count entries */
+  static size_t CapacityFor(size_t count) {
+    size_t capacity = 8;
+    while (capacity / 4 * 3 < count)
+      capacity *= 2;
+    return capacity;
+  }
+public:
+  RationalTable(size_t count = 0, const Hash& hasher = Hash()):
+    size(0), hasher(hasher) {
+    Rehash(CapacityFor(count));
+  }
+
+  size_t Size() const { return size; }
+  bool Empty() const { return size == 0; }
+  /* Number of slots, a power of 2 */
+  size_t Capacity() const { return slots.size(); }
+
+  void Clear() {
+    for (Slot& slot : slots)
+      MakeEmpty(slot);
+    size = 0;
+  }
+
+  /* Makes room for count entries without growing again */
+  void Reserve(size_t count) {
+    if (CapacityFor(count) > slots.size())
+      Rehash(CapacityFor(count));
+  }
+
+  Slot* Find(const Rational<T>& key) {
+    size_t i = Probe(key);
+    return IsEmpty(slots[i]) ? 0 : &slots[i];
+  }
+  const Slot* Find(const Rational<T>& key) const {
+    size_t i = Probe(key);
+    return IsEmpty(slots[i]) ? 0 : &slots[i];
+  }
+
+  /* The slot of key, and true if it was added (with a default value) */
+  pair<Slot*, bool> Insert(const Rational<T>& key) {
+    if (key.denominator == T(0))
+      throw invalid_argument("RationalHashMap: a key can't have a denominator of 0");
+    size_t i = Probe(key);
+    if (!IsEmpty(slots[i]))
+      return pair<Slot*, bool>(&slots[i], false);
+    if (size + 1 > slots.size() / 4 * 3) {
+      Rehash(slots.size() * 2);
+      i = Probe(key);
+    }
+    slots[i] = Slot();
+    slots[i].key = key;
+    ++size;
+    return pair<Slot*, bool>(&slots[i], true);
+  }
+
+  /* Removes key, returns false if it wasn't there */
+  bool Erase(const Rational<T>& key) {
+    size_t i = Probe(key);
+    if (IsEmpty(slots[i]))
+      return false;
+    // Move back every following entry whose home isn't between the hole and
+    // the entry (cyclically), so that probes don't stop at the hole
+    for (size_t j = (i + 1) & Mask(); !IsEmpty(slots[j]); j = (j + 1) & Mask()) {
+      size_t home = Home(slots[j].key);
+      if (((j - home) & Mask()) >= ((j - i) & Mask())) {
+        slots[i] = std::move(slots[j]);
+        i = j;
+      }
+    }
+    MakeEmpty(slots[i]);
+    --size;
+    return true;
+  }
+
+  /* Calls f(slot) for every entry, in no particular order */
+  template <typename F>
+  void ForEach(F f) const {
+    for (const Slot& slot : slots)
+      if (!IsEmpty(slot))
+        f(slot);
+  }
+  template <typename F>
+  void ForEach(F f) {
+    for (Slot& slot : slots)
+      if (!IsEmpty(slot))
+        f(slot);
+  }
+};
+
+namespace RationalHashSlots {
+
+template <typename T, typename V>
+struct MapSlot {
+  Rational<T> key;
+  V value;
+
+  MapSlot(): key(), value() { }
+};
+
+template <typename T>
+struct SetSlot {
+  Rational<T> key;
+};
+
+}
+
+/*
+ * Map from Rational<T> to V. V must be default constructible and movable.
+ */
+template <typename T, typename V, typename Hash = hash<Rational<T> > >
+class RationalHashMap {
+  typedef RationalHashSlots::MapSlot<T, V> Slot;
+
+private:
+  RationalTable<T, Slot, Hash> table;
+public:
+  /* Constructors. count entries fit without growing. */
+  RationalHashMap(size_t count = 0, const Hash& hasher = Hash()):
+    table(count, hasher) { }
+
+  size_t Size() const { return table.Size(); }
+  bool Empty() const { return table.Empty(); }
+  void Clear() { table.Clear(); }
+  void Reserve(size_t count) { table.Reserve(count); }
+
+  /* The value of key, inserting V() if key isn't there */
+  V& operator[](const Rational<T>& key) { return table.Insert(key).first->value; }
+
+  /* Inserts key with value unless key is there already. Returns the value
+     of key and true if it was inserted. */
+  pair<V*, bool> Insert(const Rational<T>& key, const V& value) {
+    pair<Slot*, bool> result = table.Insert(key);
+    if (result.second)
+      result.first->value = value;
+    return pair<V*, bool>(&result.first->value, result.second);
+  }
+
+  /* The value of key, or null */
+  V* Find(const Rational<T>& key) {
+    Slot* slot = table.Find(key);
+    return slot ? &slot->value : 0;
+  }
+  const V* Find(const Rational<T>& key) const {
+    const Slot* slot = table.Find(key);
+    return slot ? &slot->value : 0;
+  }
+  bool Contains(const Rational<T>& key) const { return table.Find(key) != 0; }
+
+  bool Erase(const Rational<T>& key) { return table.Erase(key); }
+
+  /* Calls f(key, value) for every entry, in no particular order */
+  template <typename F>
+  void ForEach(F f) const {
+    table.ForEach([&f](const Slot& slot) { f(slot.key, slot.value); });
+  }
+  template <typename F>
+  void ForEach(F f) {
+    table.ForEach([&f](Slot& slot) { f((const Rational<T>&) slot.key, slot.value); });
+  }
+};
+
+/*
+ * Set of Rational<T> values.
+ */
+template <typename T, typename Hash = hash<Rational<T> > >
+class RationalHashSet {
+  typedef RationalHashSlots::SetSlot<T> Slot;
+
+private:
+  RationalTable<T, Slot, Hash> table;
+public:
+  /* Constructors. count values fit without growing. */
+  RationalHashSet(size_t count = 0, const Hash& hasher = Hash()):
+    table(count, hasher) { }
+
+  size_t Size() const { return table.Size(); }
+  bool Empty() const { return table.Empty(); }
+  void Clear() { table.Clear(); }
+  void Reserve(size_t count) { table.Reserve(count); }
+
+  /* Returns true if value was inserted, false if it was there already */
+  bool Insert(const Rational<T>& value) { return table.Insert(value).second; }
+  bool Contains(const Rational<T>& value) const { return table.Find(value) != 0; }
+  bool Erase(const Rational<T>& value) { return table.Erase(value); }
+
+  /* Calls f(value) for every value, in no particular order */
+  template <typename F>
+  void ForEach(F f) const {
+    table.ForEach([&f](const Slot& slot) { f(slot.key); });
+  }
+};
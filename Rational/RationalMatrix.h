@@ -0,0 +1,340 @@
+#pragma once
+
+#include <stddef.h>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "Rational.h"
+#include "BigInt.h"
+#include "Overflow.h"
+using namespace std;
+
+/*
+ * Dense matrix of Rational<T>, stored row by row.
+ */
+template <typename T>
+class RationalMatrix {
+private:
+  size_t rows, columns;
+  vector<Rational<T> > elements;
+public:
+  /* Constructors. The elements start out as 0. */
+  RationalMatrix(size_t rows = 0, size_t columns = 0):
+    rows(rows), columns(columns), elements(rows * columns) { }
+
+  /* From a list of rows, which must all have the same length */
+  RationalMatrix(initializer_list<initializer_list<Rational<T> > > values):
+    rows(values.size()), columns(values.size() ? values.begin()->size() : 0) {
+    elements.reserve(rows * columns);
+    for (const initializer_list<Rational<T> >& row : values) {
+      if (row.size() != columns)
+        throw invalid_argument("RationalMatrix: rows of different lengths");
+      elements.insert(elements.end(), row.begin(), row.end());
+    }
+  }
+
+  static RationalMatrix Identity(size_t n) {
+    RationalMatrix identity(n, n);
+    for (size_t i = 0; i < n; ++i)
+      identity(i, i) = 1;
+    return identity;
+  }
+
+  size_t Rows() const { return rows; }
+  size_t Columns() const { return columns; }
+
+  Rational<T>& operator()(size_t i, size_t j) { return elements[i * columns + j]; }
+  const Rational<T>& operator()(size_t i, size_t j) const { return elements[i * columns + j]; }
+
+  /* The columns() elements of row i */
+  Rational<T>* Row(size_t i) { return elements.data() + i * columns; }
+  const Rational<T>* Row(size_t i) const { return elements.data() + i * columns; }
+};
+
+template <typename T>
+bool operator==(const RationalMatrix<T>& left, const RationalMatrix<T>& right) {
+  if (left.Rows() != right.Rows() || left.Columns() != right.Columns())
+    return false;
+  for (size_t i = 0; i < left.Rows(); ++i)
+    for (size_t j = 0; j < left.Columns(); ++j)
+      if (left(i, j) != right(i, j))
+        return false;
+  return true;
+}
+
+template <typename T>
+bool operator!=(const RationalMatrix<T>& left, const RationalMatrix<T>& right) {
+  return !(left == right);
+}
+
+template <typename T>
+RationalMatrix<T> operator*(const RationalMatrix<T>& left, const RationalMatrix<T>& right) {
+  if (left.Columns() != right.Rows())
+    throw invalid_argument("RationalMatrix: sizes don't match");
+  RationalMatrix<T> product(left.Rows(), right.Columns());
+  // i, k, j order: the inner loop runs along rows of right and product
+  for (size_t i = 0; i < left.Rows(); ++i)
+    for (size_t k = 0; k < left.Columns(); ++k) {
+      const Rational<T>& a = left(i, k);
+      if (a == 0)
+        continue;
+      const Rational<T>* b = right.Row(k);
+      Rational<T>* p = product.Row(i);
+      for (size_t j = 0; j < right.Columns(); ++j)
+        p[j] += a * b[j];
+    }
+  return product;
+}
+
+template <typename T>
+vector<Rational<T> > operator*(const RationalMatrix<T>& left, const vector<Rational<T> >& right) {
+  if (left.Columns() != right.size())
+    throw invalid_argument("RationalMatrix: sizes don't match");
+  vector<Rational<T> > product(left.Rows());
+  for (size_t i = 0; i < left.Rows(); ++i) {
+    const Rational<T>* a = left.Row(i);
+    for (size_t j = 0; j < left.Columns(); ++j)
+      product[i] += a[j] * right[j];
+  }
+  return product;
+}
+
+/*
+ * Fraction-free Gaussian elimination (Bareiss). The rows of the system are
+ * scaled to integers by the least common multiple of their denominators and
+ * eliminated in an integer type W: every entry after step k is a k x k minor
+ * of the integer matrix, obtained by an exact division, so no GCD is
+ * computed and the entries grow only as fast as the minors do. Back
+ * substitution gives the numerators of the solution over the determinant,
+ * which are reduced once at the end. W is the NextType of T first, with every
+ * product checked, and BigInt if that overflows.
+ */
+namespace RationalLinear {
+
+/* Thrown when W is too narrow, to start over with BigInt */
+struct Overflowed {};
+
+template <typename W, bool = IntTraits::IsUnbounded<W>::value>
+struct Checked {
+  static W Mul(W a, W b) {
+    W r = 0;
+    if (Overflow::Mul(a, b, r))
+      throw Overflowed();
+    return r;
+  }
+  static W Sub(W a, W b) {
+    W r = 0;
+    if (Overflow::Sub(a, b, r))
+      throw Overflowed();
+    return r;
+  }
+  /* The exact quotient a / b. The minimum by -1 doesn't fit, and traps. */
+  static W Div(W a, W b) {
+    W r = 0;
+    if (IntTraits::IsSigned<W>::value && b == W(-1) && Overflow::Sub(W(0), a, r))
+      throw Overflowed();
+    return a / b;
+  }
+};
+template <typename W>
+struct Checked<W, true> {
+  static W Mul(const W& a, const W& b) { return a * b; }
+  static W Sub(const W& a, const W& b) { return a - b; }
+  static W Div(const W& a, const W& b) { return a / b; }
+};
+
+template <typename W>
+W Lcm(const W& a, const W& b) {
+  return Checked<W>::Mul(a / Gcd(a, b), b);
+}
+
+/*
+ * The n x width row-major integer matrix of the first width columns of
+ * [a | b] (b may be null), each row multiplied by the LCM of its
+ * denominators. scale is the product of these LCMs, if requested.
+ */
+template <typename W, typename T>
+vector<W> Integers(const RationalMatrix<T>& a, const Rational<T>* b, size_t width,
+                   W* scale) {
+  size_t n = a.Rows();
+  vector<W> m(n * width);
+  if (scale)
+    *scale = 1;
+  for (size_t i = 0; i < n; ++i) {
+    const Rational<T>* row = a.Row(i);
+    W lcm = 1;
+    for (size_t j = 0; j < width; ++j) {
+      const Rational<T>& r = j < n ? row[j] : b[i];
+      if (r.Denominator() != 1)
+        lcm = Lcm(lcm, W(r.Denominator()));
+    }
+    for (size_t j = 0; j < width; ++j) {
+      const Rational<T>& r = j < n ? row[j] : b[i];
+      m[i * width + j] = Checked<W>::Mul(W(r.Numerator()), lcm / W(r.Denominator()));
+    }
+    if (scale)
+      *scale = Checked<W>::Mul(*scale, lcm);
+  }
+  return m;
+}
+
+/*
+ * Bareiss elimination of the n x width matrix m (width >= n) to upper
+ * triangular form. Rows are swapped where a pivot is 0, flipping sign.
+ * Returns false if the leading n x n matrix is singular.
+ */
+template <typename W>
+bool Eliminate(vector<W>& m, size_t n, size_t width, int& sign) {
+  typedef Checked<W> C;
+  sign = 1;
+  W previous = 1;
+  for (size_t k = 0; k < n; ++k) {
+    W* pivotRow = &m[k * width];
+    if (pivotRow[k] == W(0)) {
+      size_t i = k + 1;
+      while (i < n && m[i * width + k] == W(0))
+        ++i;
+      if (i == n)
+        return false;
+      for (size_t j = k; j < width; ++j)
+        swap(pivotRow[j], m[i * width + j]);
+      sign = -sign;
+    }
+    const W pivot = pivotRow[k];
+
+    // row_i = (pivot * row_i - row_i[k] * row_k) / previous, for the columns
+    // after k. Each row streams through the pivot row once.
+    for (size_t i = k + 1; i < n; ++i) {
+      W* row = &m[i * width];
+      const W factor = row[k];
+      for (size_t j = k + 1; j < width; ++j) {
+        W x = C::Mul(pivot, row[j]);
+        if (factor != W(0))
+          x = C::Sub(x, C::Mul(factor, pivotRow[j]));
+        row[j] = previous == W(1) ? x : C::Div(x, previous);
+      }
+      row[k] = 0;
+    }
+    previous = pivot;
+  }
+  return true;
+}
+
+/* n/d as a Rational<T>, throws overflow_error if it doesn't fit */
+template <typename T, typename W>
+Rational<T> Narrow(const W& n, const W& d) {
+  Rational<W> wide(n, d);
+  if (W(T(wide.Numerator())) != wide.Numerator() ||
+      W(T(wide.Denominator())) != wide.Denominator())
+    throw overflow_error("RationalMatrix: the result doesn't fit");
+  return Rational<T>(wide);
+}
+
+template <typename T, typename W>
+vector<Rational<T> > Solve(const RationalMatrix<T>& a, const vector<Rational<T> >& b) {
+  typedef Checked<W> C;
+  size_t n = a.Rows(), width = n + 1;
+  vector<W> m = Integers<W>(a, b.data(), width, (W*) 0);
+  int sign;
+  if (!Eliminate(m, n, width, sign))
+    throw domain_error("Solve: the matrix is singular");
+
+  // With the last pivot d (the determinant of the scaled matrix up to sign),
+  // y = d x is an integer vector, and row i gives
+  // m[i][i] y[i] = d m[i][n] - sum over j > i of m[i][j] y[j]
+  vector<W> y(n);
+  const W& d = m[(n - 1) * width + n - 1];
+  for (size_t i = n; i-- > 0;) {
+    const W* row = &m[i * width];
+    W sum = C::Mul(d, row[n]);
+    for (size_t j = i + 1; j < n; ++j)
+      if (row[j] != W(0))
+        sum = C::Sub(sum, C::Mul(row[j], y[j]));
+    y[i] = C::Div(sum, row[i]);
+  }
+  vector<Rational<T> > x(n);
+  for (size_t i = 0; i < n; ++i)
+    x[i] = Narrow<T>(y[i], d);
+  return x;
+}
+
+template <typename T, typename W>
+Rational<T> Determinant(const RationalMatrix<T>& a) {
+  size_t n = a.Rows();
+  if (n == 0)
+    return Rational<T>(1);
+  W scale;
+  vector<W> m = Integers<W>(a, (const Rational<T>*) 0, n, &scale);
+  int sign;
+  if (!Eliminate(m, n, n, sign))
+    return Rational<T>(0);
+  W det = m[n * n - 1];
+  return Narrow<T>(sign < 0 ? Checked<W>::Sub(W(0), det) : det, scale);
+}
+
+/* BigInt is the work type of last resort */
+template <typename T>
+struct Wide {
+  typedef typename IntTraits::NextType<T>::Type Type;
+  static const bool Bounded = !IntTraits::IsUnbounded<Type>::value;
+};
+
+template <typename T>
+vector<Rational<T> > Solve(const RationalMatrix<T>& a, const vector<Rational<T> >& b,
+                           true_type) {
+  try {
+    return Solve<T, typename Wide<T>::Type>(a, b);
+  } catch (const Overflowed&) {
+    return Solve<T, BigInt>(a, b);
+  }
+}
+
+template <typename T>
+vector<Rational<T> > Solve(const RationalMatrix<T>& a, const vector<Rational<T> >& b,
+                           false_type) {
+  return Solve<T, typename Wide<T>::Type>(a, b);
+}
+
+template <typename T>
+Rational<T> Determinant(const RationalMatrix<T>& a, true_type) {
+  try {
+    return Determinant<T, typename Wide<T>::Type>(a);
+  } catch (const Overflowed&) {
+    return Determinant<T, BigInt>(a);
+  }
+}
+
+template <typename T>
+Rational<T> Determinant(const RationalMatrix<T>& a, false_type) {
+  return Determinant<T, typename Wide<T>::Type>(a);
+}
+
+}
+
+/*
+ * The solution x of a x = b, exactly. Throws invalid_argument if a isn't
+ * square or b has the wrong size, domain_error if a is singular and
+ * overflow_error if an element of x doesn't fit in Rational<T>.
+ */
+template <typename T>
+vector<Rational<T> > Solve(const RationalMatrix<T>& a, const vector<Rational<T> >& b) {
+  if (a.Rows() != a.Columns() || b.size() != a.Rows())
+    throw invalid_argument("Solve: sizes don't match");
+  if (a.Rows() == 0)
+    return vector<Rational<T> >();
+  return RationalLinear::Solve(a, b,
+    integral_constant<bool, RationalLinear::Wide<T>::Bounded>());
+}
+
+/*
+ * The determinant of a, exactly. Throws invalid_argument if a isn't square
+ * and overflow_error if the determinant doesn't fit in Rational<T>.
+ */
+template <typename T>
+Rational<T> Determinant(const RationalMatrix<T>& a) {
+  if (a.Rows() != a.Columns())
+    throw invalid_argument("Determinant: the matrix isn't square");
+  return RationalLinear::Determinant(a,
+    integral_constant<bool, RationalLinear::Wide<T>::Bounded>());
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Rational.h"
+#include "RationalVector.h"
+#include "RationalSpan.h"
+using namespace std;
+
+/*
+ * Sorting of large Rational<T> arrays by radix rather than by comparison.
+ * Each value x is mapped once to the 64 bit key floor(x 2^32), its integer
+ * part and 32 bits of its fraction, which orders values the way operator<
+ * does except that values closer than 2^-32 can share a key. The keys are
+ * taken relative to the lowest one and sorted by an LSD radix sort on
+ * bytes, with no pass for the bytes above their range.
+ * Runs of equal keys are then sorted with operator< where they are out of
+ * order. Distinct values of Rational<short> differ by more than 2^-32, so
+ * their keys never need that. The keys hold integer parts of up to 32 bits:
+ * wider types, and BigInt, are sorted with sort() and operator<.
+ */
+namespace RationalSorting {
+
+/* Number of elements per worker at least */
+const size_t Grain = 1 << 16;
+
+/* Number of workers for count elements, threads requested (0 meaning one
+   per hardware thread) but at least Grain elements each */
+inline unsigned Workers(size_t count, unsigned threads) {
+  if (threads == 0)
+    threads = thread::hardware_concurrency();
+  if (threads == 0)
+    threads = 1;
+  size_t most = count / Grain;
+  if (most < threads)
+    threads = most == 0 ? 1 : unsigned(most);
+  return threads;
+}
+
+/* Runs work(w, begin, end) on workers threads, splitting [0, count) into
+   consecutive ranges in the order of w. work must not throw. */
+template <typename Work>
+void OnWorkers(unsigned workers, size_t count, Work work) {
+  vector<thread> pool;
+  for (unsigned w = 1; w < workers; ++w)
+    pool.push_back(thread(work, w, count * w / workers, count * (w + 1) / workers));
+  work(0u, size_t(0), count / workers);
+  for (thread& t : pool)
+    t.join();
+}
+
+/* A value, as its numerator and denominator, and its key. Trivial, so
+   that the arrays of them aren't initialized. */
+template <typename T>
+struct Keyed {
+  uint64_t key;
+  T numerator, denominator;
+
+  unsigned Byte(unsigned i) const { return unsigned(key >> 8 * i & 0xFF); }
+  Rational<T> Value() const { return Rational<T>::FromReducedUnchecked(numerator, denominator); }
+};
+
+const unsigned KeyBytes = 8;
+
+/* Key<T>::value is true if T has keys, and Make() sets them. Exact is true
+   if the keys of distinct values differ. */
+template <typename T, bool = !IntTraits::IsUnbounded<T>::value && sizeof(T) <= 4>
+struct Key {
+  static const bool value = false;
+};
+
+template <typename T>
+struct Key<T, true> {
+  typedef typename IntTraits::Unsigned<T>::Type Unsigned;
+  static const int Bits = int(8 * sizeof(T));
+  static const bool value = true;
+  static const bool Exact = Bits <= 16;
+
+  /* floor(2^32 r/d) for 0 <= r < d, from the double quotient, which is
+     less than 1 off */
+  static uint64_t Fraction(Unsigned r, Unsigned d) {
+    uint64_t q = uint64_t((double) r * 4294967296.0 / (double) d);
+    int64_t rest = int64_t((uint64_t(r) << 32) - q * d);
+    return rest < 0 ? q - 1 : rest >= int64_t(d) ? q + 1 : q;
+  }
+
+  /* floor(x 2^32) with the sign bit of the integer part flipped, so that
+     negative values come first as unsigned */
+  static uint64_t Make(T n, T d) {
+    T q, r;
+    RationalKernels::FloorDivide(n, d, q, r);
+    uint64_t integer = uint64_t(uint32_t(int64_t(q)));
+    if (IntTraits::IsSigned<T>::value)
+      integer ^= uint64_t(1) << 31;
+    return integer << 32 | Fraction(Unsigned(r), Unsigned(d));
+  }
+};
+
+/* Counts of each byte value at each key position */
+struct Histogram {
+  size_t counts[KeyBytes][256];
+};
+
+/*
+ * Sorts the count values element(i), storing them back with store(i, r).
+ */
+template <typename T, typename Element, typename Store>
+void RadixSort(size_t count, unsigned threads, Element element, Store store) {
+  if (count == 0)
+    return;
+  unsigned workers = Workers(count, threads);
+  unique_ptr<Keyed<T>[]> keys(new Keyed<T>[count]), buffer(new Keyed<T>[count]);
+  vector<uint64_t> lowest(workers, ~uint64_t(0)), highest(workers, 0);
+  OnWorkers(workers, count, [&](unsigned w, size_t begin, size_t end) {
+    uint64_t low = lowest[w], high = highest[w];
+    for (size_t i = begin; i < end; ++i) {
+      Keyed<T>& k = keys[i];
+      Rational<T> value = element(i);
+      k.numerator = value.Numerator();
+      k.denominator = value.Denominator();
+      k.key = Key<T>::Make(k.numerator, k.denominator);
+      low = k.key < low ? k.key : low;
+      high = k.key > high ? k.key : high;
+    }
+    lowest[w] = low;
+    highest[w] = high;
+  });
+
+  // Keys relative to the lowest one: the bytes above the range of the keys
+  // are 0 and need no pass
+  uint64_t low = *min_element(lowest.begin(), lowest.end());
+  uint64_t range = *max_element(highest.begin(), highest.end()) - low;
+  unsigned passes = 0;
+  while (passes < KeyBytes && range >> 8 * passes != 0)
+    ++passes;
+  vector<Histogram> histograms(workers);
+  memset(histograms.data(), 0, workers * sizeof(Histogram));
+  OnWorkers(workers, count, [&](unsigned w, size_t begin, size_t end) {
+    Histogram& h = histograms[w];
+    for (size_t i = begin; i < end; ++i) {
+      Keyed<T>& k = keys[i];
+      k.key -= low;
+      for (unsigned b = 0; b < passes; ++b)
+        ++h.counts[b][k.Byte(b)];
+    }
+  });
+  // These counts are those of every pass for the whole array, and those of
+  // the first pass for each worker
+  Histogram total;
+  memset(&total, 0, sizeof(total));
+  for (const Histogram& h : histograms)
+    for (unsigned b = 0; b < passes; ++b)
+      for (unsigned v = 0; v < 256; ++v)
+        total.counts[b][v] += h.counts[b][v];
+
+  Keyed<T>* from = keys.get();
+  Keyed<T>* to = buffer.get();
+  bool first = true;
+  vector<size_t> offsets(workers * 256);
+  for (unsigned b = 0; b < passes; ++b) {
+    // Every key has the same byte here, the pass wouldn't move anything
+    if (total.counts[b][from[0].Byte(b)] == count)
+      continue;
+    if (workers > 1 && !first)
+      OnWorkers(workers, count, [&](unsigned w, size_t begin, size_t end) {
+        size_t* c = histograms[w].counts[b];
+        fill(c, c + 256, size_t(0));
+        for (size_t i = begin; i < end; ++i)
+          ++c[from[i].Byte(b)];
+      });
+    // Each worker writes its elements of a byte value after those of the
+    // values before and of the workers before, which keeps the sort stable
+    size_t offset = 0;
+    for (unsigned v = 0; v < 256; ++v)
+      for (unsigned w = 0; w < workers; ++w) {
+        offsets[w * 256 + v] = offset;
+        offset += histograms[w].counts[b][v];
+      }
+    OnWorkers(workers, count, [&](unsigned w, size_t begin, size_t end) {
+      size_t* o = &offsets[w * 256];
+      for (size_t i = begin; i < end; ++i)
+        to[o[from[i].Byte(b)]++] = from[i];
+    });
+    swap(from, to);
+    first = false;
+  }
+
+  // Values closer than 2^-32 can share a key: runs of equal keys that are
+  // out of order are sorted by value
+  if (!Key<T>::Exact)
+    for (size_t i = 0; i < count;) {
+      size_t j = i + 1;
+      bool sorted = true;
+      for (; j < count && from[j].key == from[i].key; ++j)
+        sorted = sorted && !(from[j].Value() < from[j - 1].Value());
+      if (!sorted)
+        sort(from + i, from + j,
+          [](const Keyed<T>& a, const Keyed<T>& b) { return a.Value() < b.Value(); });
+      i = j;
+    }
+
+  for (size_t i = 0; i < count; ++i)
+    store(i, from[i].Value());
+}
+
+template <typename T, typename Element, typename Store>
+void Sort(size_t count, unsigned threads, Element element, Store store, true_type) {
+  RadixSort<T>(count, threads, element, store);
+}
+
+template <typename T, typename Element, typename Store>
+void Sort(size_t count, unsigned, Element element, Store store, false_type) {
+  vector<Rational<T> > values(count);
+  for (size_t i = 0; i < count; ++i)
+    values[i] = element(i);
+  sort(values.begin(), values.end());
+  for (size_t i = 0; i < count; ++i)
+    store(i, values[i]);
+}
+
+template <typename T, typename Element, typename Store>
+void Sort(size_t count, unsigned threads, Element element, Store store) {
+  Sort<T>(count, threads, element, store, integral_constant<bool, Key<T>::value>());
+}
+
+template <typename T>
+void Sort(Rational<T>* values, size_t count, unsigned threads, true_type) {
+  Sort<T>(count, threads,
+    [values](size_t i) { return values[i]; },
+    [values](size_t i, const Rational<T>& r) { values[i] = r; });
+}
+
+/* An array is sorted in place when there are no keys */
+template <typename T>
+void Sort(Rational<T>* values, size_t count, unsigned, false_type) {
+  sort(values, values + count);
+}
+
+}
+
+/*
+ * Sorts values into ascending order. threads is the number of worker
+ * threads, 0 for one per hardware thread; arrays are split into at least
+ * RationalSorting::Grain elements per thread. The radix sort needs memory
+ * for two copies of the values and their keys.
+ */
+template <typename T>
+void SortRationals(Rational<T>* values, size_t count, unsigned threads = 0) {
+  RationalSorting::Sort(values, count, threads,
+    integral_constant<bool, RationalSorting::Key<T>::value>());
+}
+
+template <typename T>
+void SortRationals(vector<Rational<T> >& values, unsigned threads = 0) {
+  SortRationals(values.data(), values.size(), threads);
+}
+
+template <typename T>
+void SortRationals(const RationalSpan<Rational<T> >& values, unsigned threads = 0) {
+  SortRationals(values.Data(), values.Size(), threads);
+}
+
+template <typename T>
+void SortRationals(RationalVector<T>& values, unsigned threads = 0) {
+  RationalSorting::Sort<T>(values.Size(), threads,
+    [&values](size_t i) { return values[i]; },
+    [&values](size_t i, const Rational<T>& r) { values.Set(i, r); });
+}
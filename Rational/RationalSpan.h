@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#if defined(__has_include)
+#if __has_include(<span>) && __cplusplus >= 202002L
+#include <span>
+#endif
+#endif
+#include "Rational.h"
+using namespace std;
+
+/*
+ * Views of Rational<T> values stored as pairs of T (numerator, denominator)
+ * in a raw buffer, such as int32_t pairs from shared memory or a bulk load,
+ * without copying. Rational<T> has exactly that layout (see RationalLayout),
+ * so AsRationals() reads the buffer in place and Pairs() goes back. The
+ * values must be reduced with positive denominators, as Rational keeps them:
+ * nothing is checked or simplified (see Rational<T>::FromReducedUnchecked()).
+ * Writing through the view keeps the buffer in that form. The buffer must be
+ * aligned for T and outlive the view.
+ *
+ * A RationalSpan converts to std::span where <span> is available (C++20).
+ */
+template <typename R>
+class RationalSpan {
+private:
+  R* values;
+  size_t size;
+public:
+  typedef R ValueType;
+
+  RationalSpan(): values(0), size(0) { }
+  RationalSpan(R* values, size_t size): values(values), size(size) { }
+  /* A view of const values from one of mutable values */
+  template <typename S>
+  RationalSpan(const RationalSpan<S>& other,
+               typename enable_if<is_same<const S, R>::value>::type* = 0):
+    values(other.Data()), size(other.Size()) { }
+
+  size_t Size() const { return size; }
+  bool Empty() const { return size == 0; }
+  R* Data() const { return values; }
+
+  R& operator[](size_t i) const { return values[i]; }
+  R* begin() const { return values; }
+  R* end() const { return values + size; }
+
+  /* The count values from offset on */
+  RationalSpan Subspan(size_t offset, size_t count) const {
+    return RationalSpan(values + offset, count);
+  }
+
+#ifdef __cpp_lib_span
+  operator span<R>() const { return span<R>(values, size); }
+#endif
+};
+
+/* The count Rational<T> values held as 2 * count T at pairs */
+template <typename T>
+RationalSpan<Rational<T> > AsRationals(T* pairs, size_t count) {
+  static_assert(RationalLayout<T>::value, "Rational<T> must be a pair of T");
+  return RationalSpan<Rational<T> >(reinterpret_cast<Rational<T>*>(pairs), count);
+}
+
+template <typename T>
+RationalSpan<const Rational<T> > AsRationals(const T* pairs, size_t count) {
+  static_assert(RationalLayout<T>::value, "Rational<T> must be a pair of T");
+  return RationalSpan<const Rational<T> >(reinterpret_cast<const Rational<T>*>(pairs), count);
+}
+
+/* The 2 * Size() T of the pairs under values */
+template <typename T>
+T* Pairs(const RationalSpan<Rational<T> >& values) {
+  static_assert(RationalLayout<T>::value, "Rational<T> must be a pair of T");
+  return reinterpret_cast<T*>(values.Data());
+}
+
+template <typename T>
+const T* Pairs(const RationalSpan<const Rational<T> >& values) {
+  static_assert(RationalLayout<T>::value, "Rational<T> must be a pair of T");
+  return reinterpret_cast<const T*>(values.Data());
+}
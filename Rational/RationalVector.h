@@ -0,0 +1,557 @@
+#pragma once
+
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+#include "Rational.h"
+#include "RationalAccumulator.h"
+#include "SimdGcd.h"
+using namespace std;
+
+/*
+ * Batched kernels on fractions stored as separate numerator and denominator
+ * arrays. They work in blocks: a first pass computes the unreduced results in
+ * NextType with no branches (so the compiler can vectorize it), a second pass
+ * reduces them. Since a Rational result is reduced in NextType and then
+ * narrowed too, the results are exactly those of the scalar operators.
+ */
+namespace RationalKernels {
+
+/* Number of elements processed per block, the temporaries of one block stay
+   in L1 */
+const size_t BlockSize = 256;
+
+/* Batched is true if the kernels can compute in a wider type than T.
+   Otherwise the scalar operators are used element by element. */
+template <typename T>
+struct Batched {
+  typedef typename IntTraits::NextType<T>::Type NextType;
+  static const bool value = IntTraits::IsInteger<T>::value &&
+    sizeof(NextType) > sizeof(T);
+};
+
+/* Magnitude of x in the unsigned type of the same width */
+template <typename W>
+typename IntTraits::Unsigned<W>::Type Magnitude(W x) {
+  typedef typename IntTraits::Unsigned<W>::Type U;
+  return x < 0 ? U(0) - U(x) : U(x);
+}
+
+/*
+ * Reduces count fractions n[i]/d[i] to lowest terms and narrows them to T.
+ * Keeps the invariants of Simplify(): 0 becomes 0/1 and the sign is indicated
+ * on the numerator. The GCDs of a block are computed by SimdGcd::GcdBatch()
+ * when all its magnitudes fit in 32 bits, one by one with Gcd() otherwise.
+ */
+template <typename T, typename W>
+void Normalize(const W* n, const W* d, size_t count, T* outN, T* outD) {
+  typedef typename IntTraits::Unsigned<W>::Type U;
+  uint32_t u[BlockSize], v[BlockSize], g[BlockSize];
+  for (size_t start = 0; start < count; start += BlockSize) {
+    size_t size = count - start < BlockSize ? count - start : BlockSize;
+    const W* bn = n + start;
+    const W* bd = d + start;
+
+    U high = 0;
+    for (size_t i = 0; i < size; ++i) {
+      U a = Magnitude(bn[i]), b = Magnitude(bd[i]);
+      high |= (a | b) >> 16 >> 16;
+      u[i] = uint32_t(a);
+      v[i] = uint32_t(b);
+    }
+    if (high == 0)
+      SimdGcd::GcdBatch(u, v, g, size);
+
+    for (size_t i = 0; i < size; ++i) {
+      W a = bn[i], b = bd[i];
+      if (a == 0) {
+        outN[start + i] = 0;
+        outD[start + i] = 1;
+        continue;
+      }
+      W gcd = high == 0 ? W(g[i]) : Gcd(a, b);
+      a /= gcd;
+      b /= gcd;
+      if (b < 0) {
+        a = -a;
+        b = -b;
+      }
+      outN[start + i] = T(a);
+      outD[start + i] = T(b);
+    }
+  }
+}
+
+/* Unreduced a + b, a - b, a * b and a / b in W, false if a result doesn't
+   fit. Only sums of unsigned T can fail: their products may take all the
+   bits of W and the sum one more. Signed T have magnitudes of at most
+   2^(bits - 1), so the sums fit, and a difference that fits in T never
+   exceeds the larger product. */
+template <typename T, typename W>
+bool AddBlock(const T* an, const T* ad, const T* bn, const T* bd, size_t count,
+              W* n, W* d) {
+  bool wrapped = false;
+  for (size_t i = 0; i < count; ++i) {
+    W product = W(an[i]) * bd[i];
+    n[i] = product + W(bn[i]) * ad[i];
+    d[i] = W(ad[i]) * bd[i];
+    wrapped |= !IntTraits::IsSigned<W>::value && n[i] < product;
+  }
+  return !wrapped;
+}
+
+template <typename T, typename W>
+bool SubtractBlock(const T* an, const T* ad, const T* bn, const T* bd,
+                   size_t count, W* n, W* d) {
+  for (size_t i = 0; i < count; ++i) {
+    n[i] = W(an[i]) * bd[i] - W(bn[i]) * ad[i];
+    d[i] = W(ad[i]) * bd[i];
+  }
+  return true;
+}
+
+template <typename T, typename W>
+bool MultiplyBlock(const T* an, const T* ad, const T* bn, const T* bd,
+                   size_t count, W* n, W* d) {
+  for (size_t i = 0; i < count; ++i) {
+    n[i] = W(an[i]) * bn[i];
+    d[i] = W(ad[i]) * bd[i];
+  }
+  return true;
+}
+
+template <typename T, typename W>
+bool DivideBlock(const T* an, const T* ad, const T* bn, const T* bd,
+                 size_t count, W* n, W* d) {
+  for (size_t i = 0; i < count; ++i) {
+    n[i] = W(an[i]) * bd[i];
+    d[i] = W(ad[i]) * bn[i];
+  }
+  return true;
+}
+
+/* out[i] = n[i]/d[i] correctly rounded to F, see ToFloatingPoint(). A first
+   pass divides in double, which is correctly rounded where both fit in 53
+   bits and vectorizes, a second one redoes the others. */
+template <typename T, typename F>
+void ToFloatingPointBlock(const T* n, const T* d, size_t count, F* out) {
+  typedef typename IntTraits::Unsigned<T>::Type U;
+  const bool exact = sizeof(T) * 8 <= 53;
+  for (size_t i = 0; i < count; ++i)
+    out[i] = F((double) n[i] / (double) d[i]);
+  if (exact)
+    return;
+  const U limit = U(1) << (exact ? 0 : 53);
+  for (size_t i = 0; i < count; ++i)
+    if (Magnitude(n[i]) > limit || U(d[i]) > limit)
+      out[i] = ToFloatingPoint<F>(n[i], d[i]);
+}
+
+/* Three-way comparison of a[i] and b[i] into out[i] (-1, 0 or 1) */
+template <typename T, typename W>
+void CompareBlock(const T* an, const T* ad, const T* bn, const T* bd,
+                  size_t count, int* out) {
+  for (size_t i = 0; i < count; ++i) {
+    W lhs = W(an[i]) * bd[i], rhs = W(bn[i]) * ad[i];
+    out[i] = (lhs > rhs) - (lhs < rhs);
+  }
+}
+
+/* n = q d + r with 0 <= r < d, see FloorDivide(). For signed types of up to
+   32 bits the quotient is computed in double, which vectorizes: n/d is at
+   least 1/d away from any integer it isn't, more than the rounding error
+   |n/d| 2^-53, so truncating the double quotient truncates n/d exactly. It
+   fits in an int, and so does q d, which lies between 0 and n. */
+template <typename T>
+void FloorDivide(T n, T d, T& q, T& r, true_type) {
+  int quotient = (int) ((double) n / (double) d);
+  int remainder = int(n) - quotient * int(d);
+  bool below = remainder < 0;
+  q = T(below ? quotient - 1 : quotient);
+  r = T(below ? remainder + int(d) : remainder);
+}
+
+template <typename T>
+void FloorDivide(T n, T d, T& q, T& r, false_type) {
+  RationalParts<T>::FloorDivide(n, d, q, r);
+}
+
+template <typename T>
+void FloorDivide(T n, T d, T& q, T& r) {
+  FloorDivide(n, d, q, r, integral_constant<bool,
+    IntTraits::IsInteger<T>::value && IntTraits::IsSigned<T>::value && sizeof(T) <= 4>());
+}
+
+/* out[i] = rounded(q, r, d[i]) for n[i]/d[i] = q + r/d[i], 0 <= r < d[i] */
+template <typename T, typename Rounding>
+void RoundEach(const T* n, const T* d, size_t count, T* out, Rounding rounded) {
+  for (size_t i = 0; i < count; ++i) {
+    T q = 0, r = 0;
+    FloorDivide(n[i], d[i], q, r);
+    out[i] = rounded(q, r, d[i]);
+  }
+}
+
+}
+
+/*
+ * A sequence of Rational<T> stored as two contiguous arrays, one for the
+ * numerators and one for the denominators (structure of arrays). Elements are
+ * kept reduced, like Rational. The element-wise operators and the reductions
+ * below give the same results as the scalar operators on each element.
+ */
+template <typename T>
+class RationalVector {
+  typedef typename IntTraits::NextType<T>::Type NextType;
+  typedef integral_constant<bool, RationalKernels::Batched<T>::value> Batched;
+
+private:
+  vector<T> numerators, denominators;
+
+  template <typename U>
+  friend RationalVector<U> Frac(const RationalVector<U>& values);
+
+  /* Applies a block kernel element-wise to this and right, storing the
+     reduced results in this. Where no wider type exists, the compound
+     operator is applied to each element instead, and so it is to the
+     blocks the kernel can't compute in NextType. */
+  template <typename Kernel, typename Scalar>
+  RationalVector& Apply(const RationalVector& right, Kernel kernel, Scalar scalar,
+                        true_type);
+  template <typename Kernel, typename Scalar>
+  RationalVector& Apply(const RationalVector& right, Kernel, Scalar scalar,
+                        false_type);
+
+  void CheckSize(const RationalVector& right) const {
+    if (right.Size() != Size())
+      throw invalid_argument("RationalVector: sizes differ");
+  }
+public:
+  /* Constructors */
+  RationalVector() { }
+  explicit RationalVector(size_t size, const Rational<T>& value = Rational<T>()):
+    numerators(size, value.Numerator()), denominators(size, value.Denominator()) { }
+  RationalVector(initializer_list<Rational<T> > values) {
+    Reserve(values.size());
+    for (const Rational<T>& r : values)
+      PushBack(r);
+  }
+  template <typename Iterator>
+  RationalVector(Iterator first, Iterator last) {
+    for (; first != last; ++first)
+      PushBack(*first);
+  }
+
+  size_t Size() const { return numerators.size(); }
+  bool Empty() const { return numerators.empty(); }
+  void Reserve(size_t size) {
+    numerators.reserve(size);
+    denominators.reserve(size);
+  }
+  void Resize(size_t size, const Rational<T>& value = Rational<T>()) {
+    numerators.resize(size, value.Numerator());
+    denominators.resize(size, value.Denominator());
+  }
+  void Clear() {
+    numerators.clear();
+    denominators.clear();
+  }
+  void PushBack(const Rational<T>& r) {
+    numerators.push_back(r.Numerator());
+    denominators.push_back(r.Denominator());
+  }
+
+  /* Element access (by value, the elements are not stored as Rationals) */
+  Rational<T> operator[](size_t i) const {
+    Rational<T> r;
+    r.numerator = numerators[i];
+    r.denominator = denominators[i];
+    return r;
+  }
+  void Set(size_t i, const Rational<T>& r) {
+    numerators[i] = r.Numerator();
+    denominators[i] = r.Denominator();
+  }
+
+  /* The numerator and denominator arrays */
+  const T* Numerators() const { return numerators.data(); }
+  const T* Denominators() const { return denominators.data(); }
+
+  /* Element-wise compound-assignment operators */
+  RationalVector& operator+=(const RationalVector& right) {
+    return Apply(right, RationalKernels::AddBlock<T, NextType>,
+                 [](Rational<T>& a, const Rational<T>& b) { a += b; }, Batched());
+  }
+  RationalVector& operator-=(const RationalVector& right) {
+    return Apply(right, RationalKernels::SubtractBlock<T, NextType>,
+                 [](Rational<T>& a, const Rational<T>& b) { a -= b; }, Batched());
+  }
+  RationalVector& operator*=(const RationalVector& right) {
+    return Apply(right, RationalKernels::MultiplyBlock<T, NextType>,
+                 [](Rational<T>& a, const Rational<T>& b) { a *= b; }, Batched());
+  }
+  RationalVector& operator/=(const RationalVector& right) {
+    return Apply(right, RationalKernels::DivideBlock<T, NextType>,
+                 [](Rational<T>& a, const Rational<T>& b) { a /= b; }, Batched());
+  }
+};
+
+template <typename T>
+template <typename Kernel, typename Scalar>
+RationalVector<T>& RationalVector<T>::Apply(const RationalVector& right,
+                                            Kernel kernel, Scalar scalar, true_type) {
+  CheckSize(right);
+  NextType n[RationalKernels::BlockSize], d[RationalKernels::BlockSize];
+  T* an = numerators.data();
+  T* ad = denominators.data();
+  const T* bn = right.numerators.data();
+  const T* bd = right.denominators.data();
+  for (size_t i = 0; i < Size(); i += RationalKernels::BlockSize) {
+    size_t count = Size() - i < RationalKernels::BlockSize
+                     ? Size() - i : RationalKernels::BlockSize;
+    if (kernel(an + i, ad + i, bn + i, bd + i, count, n, d)) {
+      RationalKernels::Normalize(n, d, count, an + i, ad + i);
+      continue;
+    }
+    for (size_t j = i; j < i + count; ++j) {
+      Rational<T> r = (*this)[j];
+      scalar(r, right[j]);
+      Set(j, r);
+    }
+  }
+  return *this;
+}
+
+template <typename T>
+template <typename Kernel, typename Scalar>
+RationalVector<T>& RationalVector<T>::Apply(const RationalVector& right,
+                                            Kernel, Scalar scalar, false_type) {
+  CheckSize(right);
+  for (size_t i = 0; i < Size(); ++i) {
+    Rational<T> r = (*this)[i];
+    scalar(r, right[i]);
+    Set(i, r);
+  }
+  return *this;
+}
+
+// Element-wise arithmetic operators
+// =================================
+
+template <typename T>
+RationalVector<T> operator+(RationalVector<T> left, const RationalVector<T>& right) {
+  return left += right;
+}
+
+template <typename T>
+RationalVector<T> operator-(RationalVector<T> left, const RationalVector<T>& right) {
+  return left -= right;
+}
+
+template <typename T>
+RationalVector<T> operator*(RationalVector<T> left, const RationalVector<T>& right) {
+  return left *= right;
+}
+
+template <typename T>
+RationalVector<T> operator/(RationalVector<T> left, const RationalVector<T>& right) {
+  return left /= right;
+}
+
+// Comparison
+// ==========
+
+/*
+ * Three-way comparison of each pair of elements, out[i] is negative, zero or
+ * positive as for Compare(left[i], right[i]). out must hold Size() ints.
+ */
+template <typename T>
+void Compare(const RationalVector<T>& left, const RationalVector<T>& right,
+             int* out) {
+  if (right.Size() != left.Size())
+    throw invalid_argument("RationalVector: sizes differ");
+  if (RationalKernels::Batched<T>::value) {
+    RationalKernels::CompareBlock<T, typename IntTraits::NextType<T>::Type>(
+      left.Numerators(), left.Denominators(), right.Numerators(),
+      right.Denominators(), left.Size(), out);
+    return;
+  }
+  for (size_t i = 0; i < left.Size(); ++i)
+    out[i] = Compare(left[i], right[i]);
+}
+
+// Conversion to floating point
+// ============================
+
+/* out[i] = values[i] correctly rounded, out must hold Size() values */
+template <typename T>
+void ToDouble(const RationalVector<T>& values, double* out) {
+  RationalKernels::ToFloatingPointBlock(values.Numerators(), values.Denominators(),
+                                        values.Size(), out);
+}
+
+template <typename T>
+void ToFloat(const RationalVector<T>& values, float* out) {
+  RationalKernels::ToFloatingPointBlock(values.Numerators(), values.Denominators(),
+                                        values.Size(), out);
+}
+
+// Integer parts
+// =============
+// Floor(), Ceil(), Trunc() and Round() of every element into out, which must
+// hold Size() values, and Frac() of every element. One division per element
+// and no GCD, see RationalKernels::FloorDivide().
+
+template <typename T>
+void Floor(const RationalVector<T>& values, T* out) {
+  RationalKernels::RoundEach(values.Numerators(), values.Denominators(), values.Size(),
+                               out, [](T q, T, T) { return q; });
+}
+
+template <typename T>
+void Ceil(const RationalVector<T>& values, T* out) {
+  RationalKernels::RoundEach(values.Numerators(), values.Denominators(), values.Size(),
+                               out, [](T q, T r, T) { return T(r == 0 ? q : q + 1); });
+}
+
+template <typename T>
+void Trunc(const RationalVector<T>& values, T* out) {
+  RationalKernels::RoundEach(values.Numerators(), values.Denominators(), values.Size(),
+                               out, [](T q, T r, T d) {
+    return RationalParts<T>::Rounded(q, r, d, RoundTowardZero);
+  });
+}
+
+namespace RationalKernels {
+
+/* Round() with the mode known at compile time */
+template <RoundingMode Mode, typename T>
+void RoundAs(const RationalVector<T>& values, T* out) {
+  RoundEach(values.Numerators(), values.Denominators(), values.Size(), out,
+              [](T q, T r, T d) { return RationalParts<T>::Rounded(q, r, d, Mode); });
+}
+
+}
+
+template <typename T>
+void Round(const RationalVector<T>& values, T* out, RoundingMode mode = RoundHalfEven) {
+  using namespace RationalKernels;
+  switch (mode) {
+  case RoundDown: return RoundAs<RoundDown>(values, out);
+  case RoundUp: return RoundAs<RoundUp>(values, out);
+  case RoundTowardZero: return RoundAs<RoundTowardZero>(values, out);
+  case RoundAwayFromZero: return RoundAs<RoundAwayFromZero>(values, out);
+  case RoundHalfEven: return RoundAs<RoundHalfEven>(values, out);
+  case RoundHalfUp: return RoundAs<RoundHalfUp>(values, out);
+  case RoundHalfDown: return RoundAs<RoundHalfDown>(values, out);
+  case RoundHalfAwayFromZero: return RoundAs<RoundHalfAwayFromZero>(values, out);
+  default: return RoundAs<RoundHalfTowardZero>(values, out);
+  }
+}
+
+template <typename T>
+RationalVector<T> Frac(const RationalVector<T>& values) {
+  RationalVector<T> fracs(values.Size());
+  const T* n = values.Numerators();
+  const T* d = values.Denominators();
+  T* fn = fracs.numerators.data();
+  T* fd = fracs.denominators.data();
+  for (size_t i = 0; i < values.Size(); ++i) {
+    // From the floor remainder r to the truncated one, r - d for negative
+    // values. 0 stays 0/1.
+    T q = 0, r = 0;
+    RationalKernels::FloorDivide(n[i], d[i], q, r);
+    fn[i] = q < T(0) && r != 0 ? T(r - d[i]) : r;
+    fd[i] = r == 0 ? T(1) : d[i];
+  }
+  return fracs;
+}
+
+// Reductions
+// ==========
+// Where the kernels are batched, these add a block at a time into a
+// RationalAccumulator, which doesn't reduce while the unreduced terms fit in
+// the larger type, and Dot multiplies each block with MultiplyBlock() first.
+// The result is the exact one whenever it fits in T. Other types accumulate
+// with the scalar operators in order.
+
+namespace RationalKernels {
+
+template <typename T>
+Rational<T> Sum(const T* n, const T* d, size_t count, true_type) {
+  RationalAccumulator<T> sum;
+  for (size_t i = 0; i < count; i += BlockSize)
+    sum.AddBlock(n + i, d + i, count - i < BlockSize ? count - i : BlockSize);
+  return sum.Value();
+}
+
+template <typename T>
+Rational<T> Sum(const T* n, const T* d, size_t count, false_type) {
+  Rational<T> sum;
+  for (size_t i = 0; i < count; ++i)
+    sum += Rational<T>::FromReducedUnchecked(n[i], d[i]);
+  return sum;
+}
+
+template <typename T>
+Rational<T> Product(const T* n, const T* d, size_t count, true_type) {
+  RationalAccumulator<T> product(1);
+  for (size_t i = 0; i < count; ++i)
+    product *= Rational<T>::FromReducedUnchecked(n[i], d[i]);
+  return product.Value();
+}
+
+template <typename T>
+Rational<T> Product(const T* n, const T* d, size_t count, false_type) {
+  Rational<T> product(1);
+  for (size_t i = 0; i < count; ++i)
+    product *= Rational<T>::FromReducedUnchecked(n[i], d[i]);
+  return product;
+}
+
+template <typename T>
+Rational<T> Dot(const T* an, const T* ad, const T* bn, const T* bd,
+                size_t count, true_type) {
+  typedef typename IntTraits::NextType<T>::Type NextType;
+  NextType n[BlockSize], d[BlockSize];
+  RationalAccumulator<T> sum;
+  for (size_t i = 0; i < count; i += BlockSize) {
+    size_t size = count - i < BlockSize ? count - i : BlockSize;
+    MultiplyBlock(an + i, ad + i, bn + i, bd + i, size, n, d);
+    sum.AddBlock(n, d, size);
+  }
+  return sum.Value();
+}
+
+template <typename T>
+Rational<T> Dot(const T* an, const T* ad, const T* bn, const T* bd,
+                size_t count, false_type) {
+  Rational<T> sum;
+  for (size_t i = 0; i < count; ++i)
+    sum += Rational<T>::FromReducedUnchecked(an[i], ad[i]) *
+           Rational<T>::FromReducedUnchecked(bn[i], bd[i]);
+  return sum;
+}
+
+}
+
+template <typename T>
+Rational<T> Sum(const RationalVector<T>& values) {
+  return RationalKernels::Sum(values.Numerators(), values.Denominators(),
+    values.Size(), integral_constant<bool, RationalKernels::Batched<T>::value>());
+}
+
+template <typename T>
+Rational<T> Product(const RationalVector<T>& values) {
+  return RationalKernels::Product(values.Numerators(), values.Denominators(),
+    values.Size(), integral_constant<bool, RationalKernels::Batched<T>::value>());
+}
+
+template <typename T>
+Rational<T> Dot(const RationalVector<T>& left, const RationalVector<T>& right) {
+  if (right.Size() != left.Size())
+    throw invalid_argument("RationalVector: sizes differ");
+  return RationalKernels::Dot(left.Numerators(), left.Denominators(),
+    right.Numerators(), right.Denominators(), left.Size(),
+    integral_constant<bool, RationalKernels::Batched<T>::value>());
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Gcd.h"
+using namespace std;
+
+/*
+ * Batched greatest common divisor of 32 bit magnitudes, g[i] = gcd(u[i], v[i])
+ * with gcd(x, 0) = x. The lane-parallel binary GCD below runs eight pairs at a
+ * time with AVX2. The implementation is picked once, at the first call, from
+ * the features of the CPU running the program, so a binary built for the
+ * baseline instruction set still uses AVX2 where it is available. Define
+ * RATIONAL_NO_SIMD to always use the portable loop.
+ */
+
+/* RATIONAL_HAS_AVX2 is defined when the compiler can build the AVX2 kernel
+   without -mavx2 (a target attribute or MSVC, which doesn't need one) */
+#if !defined(RATIONAL_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || \
+    defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__) || \
+    defined(_MSC_VER))
+#define RATIONAL_HAS_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define RATIONAL_TARGET_AVX2
+#else
+#define RATIONAL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace SimdGcd {
+
+typedef void (*GcdBatchFunction)(const uint32_t* u, const uint32_t* v,
+                                 uint32_t* g, size_t count);
+
+/* One pair at a time with the scalar binary GCD */
+inline void GcdBatchPortable(const uint32_t* u, const uint32_t* v, uint32_t* g,
+                             size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    g[i] = BinaryGcd(u[i], v[i]);
+}
+
+#ifdef RATIONAL_HAS_AVX2
+
+/* Count trailing zeros of each lane: the lowest set bit, converted to float,
+   has the bit index as exponent. 0 gives a negative count, which srlv treats
+   as a shift by 32 or more. */
+RATIONAL_TARGET_AVX2 inline __m256i CountTrailingZerosAvx2(__m256i x) {
+  __m256i low = _mm256_and_si256(x, _mm256_sub_epi32(_mm256_setzero_si256(), x));
+  __m256i bits = _mm256_castps_si256(_mm256_cvtepi32_ps(low));
+  __m256i exponent = _mm256_and_si256(_mm256_srli_epi32(bits, 23),
+                                      _mm256_set1_epi32(0xFF));
+  return _mm256_sub_epi32(exponent, _mm256_set1_epi32(127));
+}
+
+/* Stein's algorithm on eight lanes, iterating until every lane is done */
+RATIONAL_TARGET_AVX2 inline __m256i GcdAvx2(__m256i u, __m256i v) {
+  const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi32(1);
+
+  // Lanes with a zero operand give the other one, the loop runs on 1 and 1
+  // there instead
+  __m256i uZero = _mm256_cmpeq_epi32(u, zero), vZero = _mm256_cmpeq_epi32(v, zero);
+  __m256i trivial = _mm256_or_si256(uZero, vZero);
+  __m256i trivialResult = _mm256_or_si256(u, v);
+  u = _mm256_blendv_epi8(u, one, trivial);
+  v = _mm256_blendv_epi8(v, one, trivial);
+
+  __m256i shift = CountTrailingZerosAvx2(_mm256_or_si256(u, v));
+  u = _mm256_srlv_epi32(u, CountTrailingZerosAvx2(u));
+  do {
+    v = _mm256_srlv_epi32(v, CountTrailingZerosAvx2(v));
+    __m256i done = _mm256_cmpeq_epi32(v, zero);
+    __m256i low = _mm256_min_epu32(u, v), high = _mm256_max_epu32(u, v);
+    u = _mm256_blendv_epi8(low, u, done);
+    v = _mm256_andnot_si256(done, _mm256_sub_epi32(high, low));
+  } while (!_mm256_testz_si256(v, v));
+
+  return _mm256_blendv_epi8(_mm256_sllv_epi32(u, shift), trivialResult, trivial);
+}
+
+RATIONAL_TARGET_AVX2 inline void GcdBatchAvx2(const uint32_t* u, const uint32_t* v,
+                                              uint32_t* g, size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i a = _mm256_loadu_si256((const __m256i*) (u + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*) (v + i));
+    _mm256_storeu_si256((__m256i*) (g + i), GcdAvx2(a, b));
+  }
+  GcdBatchPortable(u + i, v + i, g + i, count - i);
+}
+
+/* True if the CPU and the operating system support AVX2 */
+inline bool HasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  __cpuid(info, 1);
+  const int osxsave = 1 << 27, avx = 1 << 28;
+  if ((info[2] & (osxsave | avx)) != (osxsave | avx) || (_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif
+
+/* The implementation for the running CPU */
+inline GcdBatchFunction SelectGcdBatch() {
+#ifdef RATIONAL_HAS_AVX2
+  if (HasAvx2())
+    return GcdBatchAvx2;
+#endif
+  return GcdBatchPortable;
+}
+
+/* g[i] = gcd(u[i], v[i]) for count pairs */
+inline void GcdBatch(const uint32_t* u, const uint32_t* v, uint32_t* g,
+                     size_t count) {
+  static const GcdBatchFunction function = SelectGcdBatch();
+  function(u, v, g, count);
+}
+
+}
@@ -0,0 +1,678 @@
+// Benchmarks for Rational, using Google Benchmark.
+//
+// Each operator is measured for Rational<short>, Rational<int> and
+// Rational<long long> on three operand distributions (see Operands below),
+// and so is each GCD engine, plus throughput benchmarks for sorting,
+// reducing and parsing. Results are
+// written to rational_bench.json unless --benchmark_out is given.
+
+#include <benchmark/benchmark.h>
+#include "Rational.h"
+#include "BigInt.h"
+#include "RationalVector.h"
+#include "RationalAccumulator.h"
+#include "ParallelReduce.h"
+#include "RationalChars.h"
+#include "RationalHashMap.h"
+#include "RationalExpression.h"
+#include "RationalMatrix.h"
+#include "AtomicRational.h"
+#include "ContinuedFraction.h"
+#include "RationalSort.h"
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Operand distributions
+// =====================
+
+/* Values with denominators up to 12, as in prices and measurements */
+struct SmallDenominators {};
+/* Operand pairs with coprime denominators, so nothing cancels */
+struct Coprime {};
+/* Numerators and denominators in the top quarter of the range of T */
+struct NearOverflow {};
+
+const size_t PairCount = 1024;
+
+template <typename T>
+T Uniform(mt19937_64& random, long long low, long long high) {
+  return T(uniform_int_distribution<long long>(low, high)(random));
+}
+
+template <typename T>
+long long Max() {
+  return (long long) numeric_limits<T>::max();
+}
+
+template <typename T>
+void MakePair(mt19937_64& random, SmallDenominators, Rational<T>& a, Rational<T>& b) {
+  a = Rational<T>(Uniform<T>(random, -100, 100), Uniform<T>(random, 1, 12));
+  b = Rational<T>(Uniform<T>(random, -100, 100), Uniform<T>(random, 1, 12));
+}
+
+template <typename T>
+void MakePair(mt19937_64& random, Coprime, Rational<T>& a, Rational<T>& b) {
+  long long limit = min(Max<T>(), 1LL << 20);
+  T d1, d2;
+  do {
+    d1 = Uniform<T>(random, 2, limit);
+    d2 = Uniform<T>(random, 2, limit);
+  } while (Gcd(d1, d2) != 1);
+  a = Rational<T>(Uniform<T>(random, -limit, limit), d1);
+  b = Rational<T>(Uniform<T>(random, -limit, limit), d2);
+}
+
+template <typename T>
+void MakePair(mt19937_64& random, NearOverflow, Rational<T>& a, Rational<T>& b) {
+  long long high = Max<T>(), low = high - high / 4;
+  a = Rational<T>(Uniform<T>(random, low, high), Uniform<T>(random, low, high));
+  b = Rational<T>(T(-Uniform<T>(random, low, high)), Uniform<T>(random, low, high));
+}
+
+/* PairCount operand pairs of the distribution, the same on every run */
+template <typename T, typename Distribution>
+struct Operands {
+  vector<Rational<T> > left, right;
+
+  Operands(): left(PairCount), right(PairCount) {
+    mt19937_64 random(42);
+    for (size_t i = 0; i < PairCount; ++i) {
+      MakePair(random, Distribution(), left[i], right[i]);
+      if (right[i] == 0)
+        right[i] = 1;
+    }
+  }
+};
+
+// Operators
+// =========
+
+/* Runs op(left[i], right[i]) over all pairs per iteration */
+template <typename T, typename Distribution, typename Op>
+void RunBinary(benchmark::State& state, Op op) {
+  Operands<T, Distribution> operands;
+  for (auto _ : state)
+    for (size_t i = 0; i < PairCount; ++i)
+      benchmark::DoNotOptimize(op(operands.left[i], operands.right[i]));
+  state.SetItemsProcessed(int64_t(state.iterations()) * PairCount);
+}
+
+template <typename T, typename Distribution>
+void Add(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) { return a + b; });
+}
+
+template <typename T, typename Distribution>
+void Subtract(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) { return a - b; });
+}
+
+template <typename T, typename Distribution>
+void Multiply(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) { return a * b; });
+}
+
+template <typename T, typename Distribution>
+void Divide(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) { return a / b; });
+}
+
+template <typename T, typename Distribution>
+void AddAssign(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](Rational<T> a, const Rational<T>& b) { return a += b; });
+}
+
+template <typename T, typename Distribution>
+void SubtractAssign(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](Rational<T> a, const Rational<T>& b) { return a -= b; });
+}
+
+template <typename T, typename Distribution>
+void MultiplyAssign(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](Rational<T> a, const Rational<T>& b) { return a *= b; });
+}
+
+template <typename T, typename Distribution>
+void DivideAssign(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](Rational<T> a, const Rational<T>& b) { return a /= b; });
+}
+
+template <typename T, typename Distribution>
+void Less(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) { return a < b; });
+}
+
+template <typename T, typename Distribution>
+void Greater(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) { return a > b; });
+}
+
+template <typename T, typename Distribution>
+void GreaterEqual(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) { return a >= b; });
+}
+
+template <typename T, typename Distribution>
+void LessEqual(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) { return a <= b; });
+}
+
+template <typename T, typename Distribution>
+void Equal(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) { return a == b; });
+}
+
+template <typename T, typename Distribution>
+void NotEqual(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) { return a != b; });
+}
+
+template <typename T, typename Distribution>
+void Negate(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>&) { return -a; });
+}
+
+template <typename T, typename Distribution>
+void Increment(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](Rational<T> a, const Rational<T>&) { return ++a; });
+}
+
+template <typename T, typename Distribution>
+void Decrement(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](Rational<T> a, const Rational<T>&) { return --a; });
+}
+
+template <typename T, typename Distribution>
+void MixedAdd(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) {
+    return a + b.Numerator();
+  });
+}
+
+/* Rational<T> + Rational<short>, the short operands small denominators */
+template <typename T, typename Distribution>
+void MixedWidth(benchmark::State& state) {
+  Operands<T, Distribution> left;
+  Operands<short, SmallDenominators> right;
+  for (auto _ : state)
+    for (size_t i = 0; i < PairCount; ++i)
+      benchmark::DoNotOptimize(left.left[i] + right.right[i]);
+  state.SetItemsProcessed(int64_t(state.iterations()) * PairCount);
+}
+
+/* The constructor, i.e. Simplify() */
+template <typename T, typename Distribution>
+void Construct(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) {
+    return Rational<T>(a.Numerator(), b.Denominator());
+  });
+}
+
+template <typename T, typename Distribution>
+void ToDouble(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>&) { return (double) a; });
+}
+
+template <typename T, typename Distribution>
+void ToInteger(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>&) { return (int) a; });
+}
+
+/* operator<<, into a stream that is rewound for every value */
+template <typename T, typename Distribution>
+void StreamOut(benchmark::State& state) {
+  Operands<T, Distribution> operands;
+  ostringstream os;
+  for (auto _ : state)
+    for (size_t i = 0; i < PairCount; ++i) {
+      os.seekp(0);
+      os << operands.left[i];
+      benchmark::DoNotOptimize(os.tellp());
+    }
+  state.SetItemsProcessed(int64_t(state.iterations()) * PairCount);
+}
+
+/* a * b + a / b - b, with a temporary per operator and fused */
+template <typename T, typename Distribution>
+void ExpressionEager(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) {
+    return a * b + a / b - b;
+  });
+}
+
+template <typename T, typename Distribution>
+void ExpressionFused(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) {
+    return Evaluate(Lazy(a) * b + Lazy(a) / b - b);
+  });
+}
+
+#define RATIONAL_BENCHMARK_TYPES(name, Distribution) \
+  BENCHMARK_TEMPLATE(name, short, Distribution); \
+  BENCHMARK_TEMPLATE(name, int, Distribution); \
+  BENCHMARK_TEMPLATE(name, long long, Distribution)
+
+#define RATIONAL_BENCHMARK(name) \
+  RATIONAL_BENCHMARK_TYPES(name, SmallDenominators); \
+  RATIONAL_BENCHMARK_TYPES(name, Coprime); \
+  RATIONAL_BENCHMARK_TYPES(name, NearOverflow)
+
+RATIONAL_BENCHMARK(Add);
+RATIONAL_BENCHMARK(Subtract);
+RATIONAL_BENCHMARK(Multiply);
+RATIONAL_BENCHMARK(Divide);
+RATIONAL_BENCHMARK(AddAssign);
+RATIONAL_BENCHMARK(SubtractAssign);
+RATIONAL_BENCHMARK(MultiplyAssign);
+RATIONAL_BENCHMARK(DivideAssign);
+RATIONAL_BENCHMARK(Less);
+RATIONAL_BENCHMARK(LessEqual);
+RATIONAL_BENCHMARK(Greater);
+RATIONAL_BENCHMARK(GreaterEqual);
+RATIONAL_BENCHMARK(Equal);
+RATIONAL_BENCHMARK(NotEqual);
+RATIONAL_BENCHMARK(Negate);
+// ++ adds the denominator to the numerator in T, which overflows for the
+// near overflow operands (-- doesn't, they are positive)
+RATIONAL_BENCHMARK_TYPES(Increment, SmallDenominators);
+RATIONAL_BENCHMARK_TYPES(Increment, Coprime);
+RATIONAL_BENCHMARK(Decrement);
+RATIONAL_BENCHMARK(MixedAdd);
+RATIONAL_BENCHMARK_TYPES(MixedWidth, SmallDenominators);
+RATIONAL_BENCHMARK_TYPES(MixedWidth, Coprime);
+RATIONAL_BENCHMARK(Construct);
+RATIONAL_BENCHMARK(ToDouble);
+RATIONAL_BENCHMARK(ToInteger);
+RATIONAL_BENCHMARK(StreamOut);
+RATIONAL_BENCHMARK(ExpressionEager);
+RATIONAL_BENCHMARK(ExpressionFused);
+
+// GCD engines
+// ===========
+// The engines of GcdTraits on the numerator of one operand and the
+// denominator of the other, as Simplify() gets them. (BM_ keeps the name
+// apart from ::Gcd.)
+
+template <typename Engine, typename T, typename Distribution>
+void BM_Gcd(benchmark::State& state) {
+  RunBinary<T, Distribution>(state, [](const Rational<T>& a, const Rational<T>& b) {
+    return Engine::Gcd(a.Numerator(), b.Denominator());
+  });
+}
+
+#define RATIONAL_GCD_TYPES(Engine, Distribution) \
+  BENCHMARK_TEMPLATE(BM_Gcd, Engine, short, Distribution); \
+  BENCHMARK_TEMPLATE(BM_Gcd, Engine, int, Distribution); \
+  BENCHMARK_TEMPLATE(BM_Gcd, Engine, long long, Distribution)
+
+#define RATIONAL_GCD(Engine) \
+  RATIONAL_GCD_TYPES(Engine, SmallDenominators); \
+  RATIONAL_GCD_TYPES(Engine, Coprime); \
+  RATIONAL_GCD_TYPES(Engine, NearOverflow)
+
+RATIONAL_GCD(GcdTraits::Euclid);
+RATIONAL_GCD(GcdTraits::Binary);
+#ifdef RATIONAL_HAS_GCD_TABLE
+typedef GcdTraits::Lookup<GcdTraits::Binary> LookupBinary;
+RATIONAL_GCD(LookupBinary);
+#endif
+
+// Throughput
+// ==========
+
+/* count values of Rational<T>, drawn from the distribution */
+template <typename T, typename Distribution>
+vector<Rational<T> > Values(size_t count) {
+  Operands<T, Distribution> operands;
+  vector<Rational<T> > values;
+  values.reserve(count);
+  for (size_t i = 0; values.size() < count; ++i)
+    values.push_back(i / PairCount % 2 ? operands.right[i % PairCount]
+                                       : operands.left[i % PairCount]);
+  return values;
+}
+
+template <typename T, typename Distribution>
+void Sort(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  shuffle(values.begin(), values.end(), mt19937_64(7));
+  for (auto _ : state) {
+    state.PauseTiming();
+    vector<Rational<T> > copy = values;
+    state.ResumeTiming();
+    sort(copy.begin(), copy.end());
+    benchmark::DoNotOptimize(copy.data());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+/* SortRationals() on one thread (state.range(1) 1) or all of them (0) */
+template <typename T, typename Distribution>
+void SortRadix(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  shuffle(values.begin(), values.end(), mt19937_64(7));
+  for (auto _ : state) {
+    state.PauseTiming();
+    vector<Rational<T> > copy = values;
+    state.ResumeTiming();
+    SortRationals(copy, unsigned(state.range(1)));
+    benchmark::DoNotOptimize(copy.data());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+/* Sum, reducing after every step */
+template <typename T, typename Distribution>
+void SumScalar(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  for (auto _ : state) {
+    Rational<T> sum;
+    for (const Rational<T>& r : values)
+      sum += r;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+template <typename T, typename Distribution>
+void SumAccumulator(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  for (auto _ : state) {
+    RationalAccumulator<T> sum;
+    for (const Rational<T>& r : values)
+      sum += r;
+    benchmark::DoNotOptimize(sum.Value());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+template <typename T, typename Distribution>
+void SumParallel(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ParallelSum(values));
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+template <typename T, typename Distribution>
+void VectorAdd(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  RationalVector<T> left(values.begin(), values.end());
+  reverse(values.begin(), values.end());
+  RationalVector<T> right(values.begin(), values.end());
+  for (auto _ : state) {
+    RationalVector<T> sum = left;
+    sum += right;
+    benchmark::DoNotOptimize(sum.Numerators());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+/* Text of count values of the distribution, one per line */
+template <typename T, typename Distribution>
+string Text(size_t count) {
+  ostringstream os;
+  for (const Rational<T>& r : Values<T, Distribution>(count))
+    os << r << '\n';
+  return os.str();
+}
+
+template <typename T, typename Distribution>
+void ParseStream(benchmark::State& state) {
+  string text = Text<T, Distribution>(size_t(state.range(0)));
+  for (auto _ : state) {
+    istringstream is(text);
+    Rational<T> r;
+    while (is >> r)
+      benchmark::DoNotOptimize(r);
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(text.size()));
+}
+
+template <typename T, typename Distribution>
+void ParseChars(benchmark::State& state) {
+  string text = Text<T, Distribution>(size_t(state.range(0)));
+  for (auto _ : state) {
+    RationalVector<T> values;
+    values.Reserve(size_t(state.range(0)));
+    FromChars(text.data(), text.data() + text.size(), values);
+    benchmark::DoNotOptimize(values.Numerators());
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(text.size()));
+}
+
+template <typename T, typename Distribution>
+void FormatChars(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  vector<char> buffer(values.size() * RationalChars<T>::MaxLength);
+  for (auto _ : state) {
+    char* p = buffer.data();
+    for (const Rational<T>& r : values)
+      p = ToChars(p, buffer.data() + buffer.size(), r).ptr;
+    benchmark::DoNotOptimize(p);
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+/* Counts of the distinct values, with unordered_map and RationalHashMap */
+template <typename T, typename Distribution>
+void GroupByUnorderedMap(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  for (auto _ : state) {
+    unordered_map<Rational<T>, int> counts;
+    for (const Rational<T>& r : values)
+      ++counts[r];
+    benchmark::DoNotOptimize(counts.size());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+template <typename T, typename Distribution>
+void GroupByFlatMap(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  for (auto _ : state) {
+    RationalHashMap<T, int> counts;
+    for (const Rational<T>& r : values)
+      ++counts[r];
+    benchmark::DoNotOptimize(counts.Size());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+/* Round() to nearest, ties to even, one value at a time and batched */
+template <typename T, typename Distribution>
+void RoundScalar(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  vector<T> out(values.size());
+  for (auto _ : state) {
+    for (size_t i = 0; i < values.size(); ++i)
+      out[i] = Round(values[i]);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+template <typename T, typename Distribution>
+void RoundBatched(benchmark::State& state) {
+  vector<Rational<T> > values = Values<T, Distribution>(size_t(state.range(0)));
+  RationalVector<T> vector(values.begin(), values.end());
+  std::vector<T> out(values.size());
+  for (auto _ : state) {
+    Round(vector, out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+#define RATIONAL_THROUGHPUT(name) \
+  BENCHMARK_TEMPLATE(name, int, SmallDenominators)->Arg(1 << 16); \
+  BENCHMARK_TEMPLATE(name, int, Coprime)->Arg(1 << 16); \
+  BENCHMARK_TEMPLATE(name, long long, SmallDenominators)->Arg(1 << 16); \
+  BENCHMARK_TEMPLATE(name, long long, NearOverflow)->Arg(1 << 16)
+
+RATIONAL_THROUGHPUT(Sort);
+BENCHMARK_TEMPLATE(SortRadix, int, SmallDenominators)->Args({1 << 16, 1});
+BENCHMARK_TEMPLATE(SortRadix, int, Coprime)->Args({1 << 16, 1});
+BENCHMARK_TEMPLATE(SortRadix, long long, SmallDenominators)->Args({1 << 16, 1});
+BENCHMARK_TEMPLATE(SortRadix, long long, NearOverflow)->Args({1 << 16, 1});
+// Large arrays, where the threads pay off
+BENCHMARK_TEMPLATE(Sort, int, SmallDenominators)->Arg(1 << 22)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(SortRadix, int, SmallDenominators)->Args({1 << 22, 1})->Args({1 << 22, 0})
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+RATIONAL_THROUGHPUT(SumScalar);
+RATIONAL_THROUGHPUT(SumAccumulator);
+RATIONAL_THROUGHPUT(SumParallel);
+RATIONAL_THROUGHPUT(VectorAdd);
+RATIONAL_THROUGHPUT(ParseStream);
+RATIONAL_THROUGHPUT(ParseChars);
+RATIONAL_THROUGHPUT(FormatChars);
+RATIONAL_THROUGHPUT(GroupByUnorderedMap);
+RATIONAL_THROUGHPUT(GroupByFlatMap);
+RATIONAL_THROUGHPUT(RoundScalar);
+RATIONAL_THROUGHPUT(RoundBatched);
+
+// Shared sums
+// ===========
+// Every thread adds shares of 1/8 and 1/12 to one sum: under a mutex, with
+// AtomicRational and with ShardedRational
+
+void SharedSumMutex(benchmark::State& state) {
+  static mutex lock;
+  static Rational<int> sum;
+  Rational<int> share(1, state.thread_index() % 2 ? 12 : 8);
+  for (auto _ : state) {
+    lock_guard<mutex> guard(lock);
+    sum += share;
+    if (sum.Numerator() > 1 << 20)
+      sum = 0;
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+void SharedSumAtomic(benchmark::State& state) {
+  static AtomicRational<int> sum;
+  Rational<int> share(1, state.thread_index() % 2 ? 12 : 8);
+  int64_t i = 0;
+  for (auto _ : state) {
+    sum.Add(share);
+    if (++i % 4096 == 0 && state.thread_index() == 0 && sum.Load().Numerator() > 1 << 20)
+      sum = 0;
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+void SharedSumSharded(benchmark::State& state) {
+  static ShardedRational<int> sum;
+  Rational<int> share(1, state.thread_index() % 2 ? 12 : 8);
+  int64_t i = 0;
+  for (auto _ : state) {
+    sum += share;
+    if (++i % 4096 == 0 && state.thread_index() == 0 && sum.Load().Numerator() > 1 << 20)
+      sum.Store(0);
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+BENCHMARK(SharedSumMutex)->Threads(1)->Threads(4)->Threads(8);
+BENCHMARK(SharedSumAtomic)->Threads(1)->Threads(4)->Threads(8);
+BENCHMARK(SharedSumSharded)->Threads(1)->Threads(4)->Threads(8);
+
+// Linear systems
+// ==============
+
+/* An n x n system with small integer coefficients over small denominators.
+   The denominator of the solution is about the determinant, which outgrows
+   long long past a few rows; the minors outgrow 128 bits past a few dozen
+   and Rational<long long> then eliminates in BigInt. */
+template <typename T>
+void Solve(benchmark::State& state) {
+  size_t n = size_t(state.range(0));
+  mt19937_64 random(42);
+  uniform_int_distribution<int> coefficient(-9, 9), denominator(1, 4);
+  RationalMatrix<T> a(n, n);
+  vector<Rational<T> > b(n);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j)
+      a(i, j) = Rational<T>(T(coefficient(random)), T(denominator(random)));
+    // Diagonally dominant, so not singular
+    a(i, i) += Rational<T>(T(100));
+    b[i] = Rational<T>(T(coefficient(random)), T(denominator(random)));
+  }
+  for (auto _ : state)
+    benchmark::DoNotOptimize(Solve(a, b).data());
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(Solve, long long)->Arg(4);
+BENCHMARK_TEMPLATE(Solve, BigInt)->Arg(4)->Arg(16)->Arg(64);
+
+// Continued fractions
+// ===================
+// The convergents of each coprime operand: with the Rational operators, a
+// subtraction and a division per term, and streamed from Convergents()
+
+template <typename T>
+void ConvergentsByOperators(benchmark::State& state) {
+  Operands<T, Coprime> operands;
+  for (auto _ : state)
+    for (const Rational<T>& r : operands.left) {
+      Rational<T> x = r, p0 = 0, p1 = 1, q0 = 1, q1 = 0;
+      for (;;) {
+        T a = Floor(x);
+        Rational<T> p2 = p1 * a + p0, q2 = q1 * a + q0;
+        p0 = p1; p1 = p2;
+        q0 = q1; q1 = q2;
+        benchmark::DoNotOptimize(p1 / q1);
+        x -= a;
+        if (x == 0)
+          break;
+        x = 1 / x;
+      }
+    }
+  state.SetItemsProcessed(int64_t(state.iterations()) * PairCount);
+}
+
+template <typename T>
+void ConvergentsStreamed(benchmark::State& state) {
+  Operands<T, Coprime> operands;
+  for (auto _ : state)
+    for (const Rational<T>& r : operands.left)
+      for (const Rational<T>& c : Convergents(r))
+        benchmark::DoNotOptimize(c);
+  state.SetItemsProcessed(int64_t(state.iterations()) * PairCount);
+}
+
+BENCHMARK_TEMPLATE(ConvergentsByOperators, int);
+BENCHMARK_TEMPLATE(ConvergentsByOperators, long long);
+BENCHMARK_TEMPLATE(ConvergentsStreamed, int);
+BENCHMARK_TEMPLATE(ConvergentsStreamed, long long);
+
+}
+
+int main(int argc, char** argv) {
+  // Write JSON results by default, so that runs can be compared over time
+  vector<char*> args(argv, argv + argc);
+  string out = "--benchmark_out=rational_bench.json";
+  string format = "--benchmark_out_format=json";
+  bool hasOut = false;
+  for (int i = 1; i < argc; ++i)
+    hasOut = hasOut || string(argv[i]).compare(0, 16, "--benchmark_out=") == 0;
+  if (!hasOut) {
+    args.push_back(&out[0]);
+    args.push_back(&format[0]);
+  }
+  int count = int(args.size());
+  benchmark::Initialize(&count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,46 @@
+// libFuzzer entry point for the differential checks of Properties.h. The
+// first byte picks the integer type, the others are decoded into cases (see
+// RationalProperties::FromBytes()), which go through every path and the
+// oracle. A failed check prints the report and aborts, so that libFuzzer
+// keeps the input. Built with -DRATIONAL_FUZZ=ON (Clang only):
+//
+//   RationalFuzz -max_len=4096 corpus/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Properties.h"
+
+using namespace RationalProperties;
+
+namespace {
+
+template <typename T>
+void Check(const uint8_t* data, size_t size) {
+  vector<Case<T> > cases = FromBytes<T>(data, size);
+  if (cases.empty())
+    return;
+  Report report;
+  CheckAll(report, cases);
+  if (report.Failures() != 0) {
+    report.Print(stderr);
+    abort();
+  }
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  if (size == 0)
+    return 0;
+  switch (data[0] % 6) {
+  case 0: Check<signed char>(data + 1, size - 1); break;
+  case 1: Check<short>(data + 1, size - 1); break;
+  case 2: Check<int>(data + 1, size - 1); break;
+  case 3: Check<long long>(data + 1, size - 1); break;
+  case 4: Check<unsigned short>(data + 1, size - 1); break;
+  default: Check<unsigned>(data + 1, size - 1); break;
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// The subset of the Visual Studio C++ unit test framework that unittest1.cpp
+// uses, for building the tests with other compilers (see CMakeLists.txt).
+// Each TEST_METHOD registers itself, TestMain.cpp runs them. A failed
+// assertion ends the test method, as it does in Visual Studio.
+
+#include <stdexcept>
+#include <vector>
+
+namespace Microsoft { namespace VisualStudio { namespace CppUnitTestFramework {
+
+struct TestMethod {
+  const char* name;
+  void (*run)();
+};
+
+inline std::vector<TestMethod>& TestMethods() {
+  static std::vector<TestMethod> methods;
+  return methods;
+}
+
+struct TestRegistrar {
+  TestRegistrar(const char* name, void (*run)()) {
+    TestMethod method = { name, run };
+    TestMethods().push_back(method);
+  }
+};
+
+/* Thrown by a failed assertion */
+struct AssertFailed : std::runtime_error {
+  AssertFailed(): std::runtime_error("assertion failed") { }
+};
+
+template <typename Class>
+struct TestClass {
+  typedef Class Self;
+};
+
+class Assert {
+public:
+  static void IsTrue(bool condition, const wchar_t* = 0) {
+    if (!condition)
+      throw AssertFailed();
+  }
+  static void IsFalse(bool condition, const wchar_t* message = 0) {
+    IsTrue(!condition, message);
+  }
+  template <typename T>
+  static void AreEqual(const T& expected, const T& actual, const wchar_t* message = 0) {
+    IsTrue(expected == actual, message);
+  }
+};
+
+}}}
+
+#define TEST_CLASS(className) \
+  class className; \
+  class className : public ::Microsoft::VisualStudio::CppUnitTestFramework::TestClass<className>
+
+// The registrar is an inline static member, so the test sources need C++17
+#define TEST_METHOD(methodName) \
+  static void methodName##_Run() { Self test; test.methodName(); } \
+  static inline ::Microsoft::VisualStudio::CppUnitTestFramework::TestRegistrar \
+    methodName##_Registrar{#methodName, &methodName##_Run}; \
+  void methodName()
@@ -0,0 +1,43 @@
+// Runs the test methods registered by Portable/CppUnitTest.h. With arguments
+// only the test methods of those names are run. Returns nonzero if any test
+// fails.
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include "CppUnitTest.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+static bool Selected(const char* name, int argc, char** argv) {
+  if (argc < 2)
+    return true;
+  for (int i = 1; i < argc; ++i)
+    if (strcmp(argv[i], name) == 0)
+      return true;
+  return false;
+}
+
+int main(int argc, char** argv) {
+  int run = 0, failed = 0;
+  for (const TestMethod& method : TestMethods()) {
+    if (!Selected(method.name, argc, argv))
+      continue;
+    ++run;
+    try {
+      method.run();
+      printf("PASS %s\n", method.name);
+    } catch (const AssertFailed&) {
+      ++failed;
+      printf("FAIL %s\n", method.name);
+    } catch (const std::exception& e) {
+      ++failed;
+      printf("FAIL %s: %s\n", method.name, e.what());
+    } catch (...) {
+      ++failed;
+      printf("FAIL %s: unknown exception\n", method.name);
+    }
+  }
+  printf("%d tests, %d failed\n", run, failed);
+  return failed != 0 || run == 0;
+}
@@ -0,0 +1,83 @@
+// Randomized differential property checks of Rational, see Properties.h.
+//
+//   RationalProperties [--iterations N] [--batch N] [--seed S] [--json FILE]
+//
+// Runs N batches of random cases per integer type through every path and
+// the BigRational oracle, prints the checks, failures and time per case of
+// each path and of the oracle, and exits with 1 if any check failed. The
+// seed is printed so that a failure can be repeated; --json writes the
+// report for comparing the timings of two builds.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include "Properties.h"
+
+using namespace RationalProperties;
+
+namespace {
+
+template <typename T>
+void Run(Report& report, unsigned long long seed, unsigned iterations, size_t batch) {
+  Source<T> source(seed);
+  // Every rational of two edge values against every other, whatever the seed
+  vector<T> edges = EdgeValues<T>();
+  vector<Rational<T> > values;
+  for (T n : edges)
+    for (T d : edges)
+      if (d != T(0) && Fits<T>(BigRational(BigInt(n), BigInt(d))))
+        values.push_back(Rational<T>(n, d));
+  vector<Case<T> > cases;
+  for (size_t i = 0; i < values.size(); ++i)
+    for (size_t j = 0; j < values.size(); ++j)
+      cases.push_back(MakeCase(values[i], values[j], edges[(i + j) % edges.size()]));
+  CheckAll(report, cases);
+  for (unsigned i = 0; i < iterations; ++i)
+    CheckAll(report, MakeCases(source, batch));
+}
+
+}
+
+int main(int argc, char** argv) {
+  unsigned iterations = 20;
+  size_t batch = 4096;
+  unsigned long long seed = random_device()();
+  const char* json = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--iterations") == 0)
+      iterations = unsigned(strtoul(argv[i + 1], 0, 10));
+    else if (strcmp(argv[i], "--batch") == 0)
+      batch = size_t(strtoull(argv[i + 1], 0, 10));
+    else if (strcmp(argv[i], "--seed") == 0)
+      seed = strtoull(argv[i + 1], 0, 10);
+    else if (strcmp(argv[i], "--json") == 0)
+      json = argv[i + 1];
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  printf("seed %llu, %u iterations of %zu cases\n", seed, iterations, batch);
+
+  Report report;
+  Run<signed char>(report, seed, iterations, batch);
+  Run<short>(report, seed, iterations, batch);
+  Run<int>(report, seed, iterations, batch);
+  Run<long long>(report, seed, iterations, batch);
+  Run<unsigned short>(report, seed, iterations, batch);
+  Run<unsigned>(report, seed, iterations, batch);
+  report.Print(stdout);
+
+  if (json) {
+    FILE* out = fopen(json, "w");
+    if (!out) {
+      fprintf(stderr, "Can't write %s\n", json);
+      return 2;
+    }
+    report.WriteJson(out);
+    fclose(out);
+  }
+  printf("%zu failures\n", report.Failures());
+  return report.Failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,1047 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <limits>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Rational.h"
+#include "BigInt.h"
+#include "CheckedRational.h"
+#include "RationalVector.h"
+#include "RationalAccumulator.h"
+#include "AtomicRational.h"
+#include "ParallelReduce.h"
+#include "RationalChars.h"
+#include "RationalExpression.h"
+#include "RationalHashMap.h"
+#include "RationalMatrix.h"
+#include "ContinuedFraction.h"
+#include "RationalSort.h"
+using namespace std;
+
+/*
+ * Differential property checks. Every optimized path (the kernels of the
+ * operators, integer operands, mixed widths, comparisons, fused
+ * expressions, the batched RationalVector kernels and reductions, the
+ * accumulator, the atomic and sharded sums, the parallel reductions, the
+ * integer parts and remainders, parsing and formatting, continued
+ * fractions, sorting, the hash map, linear systems and the checked type) is
+ * run on a batch of cases and compared with the exact result computed in
+ * BigRational, the oracle. Where the exact result doesn't fit in the result
+ * type, Rational<T> doesn't promise anything and the case is skipped, so
+ * only the cases the library is meant to get right are counted.
+ *
+ * The operands are drawn from the edge values of each type (0, 1, -1, the
+ * minimum and maximum and their neighbours, the square root of the range),
+ * small values and the whole range. Each path is timed, both the optimized
+ * code and the oracle, over the whole batch, so a run shows what each path
+ * costs next to whether it is right.
+ *
+ * The checks are used by RationalProperties (randomized, see
+ * Properties.cpp) and RationalFuzz (libFuzzer, see Fuzz.cpp).
+ */
+namespace RationalProperties {
+
+/* Names of the types in the report */
+template <typename T> struct TypeName;
+template <> struct TypeName<signed char> { static const char* Get() { return "signed char"; } };
+template <> struct TypeName<short> { static const char* Get() { return "short"; } };
+template <> struct TypeName<int> { static const char* Get() { return "int"; } };
+template <> struct TypeName<long long> { static const char* Get() { return "long long"; } };
+template <> struct TypeName<unsigned short> { static const char* Get() { return "unsigned short"; } };
+template <> struct TypeName<unsigned> { static const char* Get() { return "unsigned"; } };
+
+/* The results of one path for one type: the cases run through it, the
+   checks made of them and the time taken by the path and by the oracle */
+struct Path {
+  string name, type;
+  size_t cases, checks, failures;
+  double seconds, oracleSeconds;
+};
+
+/*
+ * What was checked, per path and type, and the first failures in full.
+ */
+class Report {
+private:
+  // Paths are handed out by reference, which push_back() keeps valid here
+  deque<Path> paths;
+  vector<string> failures;
+public:
+  static const size_t MaxFailures = 20;
+
+  Path& Get(const string& name, const string& type) {
+    for (Path& p : paths)
+      if (p.name == name && p.type == type)
+        return p;
+    Path p = { name, type, 0, 0, 0, 0, 0 };
+    paths.push_back(p);
+    return paths.back();
+  }
+
+  void Fail(Path& p, const string& detail) {
+    ++p.failures;
+    if (failures.size() < MaxFailures)
+      failures.push_back(p.name + " (" + p.type + "): " + detail);
+  }
+
+  size_t Failures() const {
+    size_t count = 0;
+    for (const Path& p : paths)
+      count += p.failures;
+    return count;
+  }
+  const deque<Path>& Paths() const { return paths; }
+  const vector<string>& FailureDetails() const { return failures; }
+
+  /* A table of the paths, the time per case of each and of the oracle */
+  void Print(FILE* out) const {
+    fprintf(out, "%-18s %-15s %10s %9s %12s %12s\n", "path", "type", "checks",
+            "failures", "ns/case", "oracle ns");
+    for (const Path& p : paths)
+      fprintf(out, "%-18s %-15s %10zu %9zu %12.1f %12.1f\n", p.name.c_str(), p.type.c_str(),
+              p.checks, p.failures, p.cases ? 1e9 * p.seconds / p.cases : 0.0,
+              p.cases ? 1e9 * p.oracleSeconds / p.cases : 0.0);
+    for (const string& f : failures)
+      fprintf(out, "FAIL %s\n", f.c_str());
+  }
+
+  /* The same as JSON, for comparing runs */
+  void WriteJson(FILE* out) const {
+    fprintf(out, "{\n  \"paths\": [\n");
+    for (size_t i = 0; i < paths.size(); ++i) {
+      const Path& p = paths[i];
+      fprintf(out, "    {\"path\": \"%s\", \"type\": \"%s\", \"cases\": %zu, \"checks\": %zu, "
+              "\"failures\": %zu, \"seconds\": %.9f, \"oracle_seconds\": %.9f}%s\n",
+              p.name.c_str(), p.type.c_str(), p.cases, p.checks, p.failures, p.seconds,
+              p.oracleSeconds, i + 1 < paths.size() ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"failures\": %zu\n}\n", Failures());
+  }
+};
+
+/* Seconds taken by f() */
+template <typename F>
+double Time(F f) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// The oracle
+// ==========
+
+template <typename T>
+BigRational Big(const Rational<T>& r) {
+  return BigRational(BigInt(r.Numerator()), BigInt(r.Denominator()));
+}
+
+template <typename T>
+bool Fits(const BigInt& x) {
+  return !(x < BigInt(numeric_limits<T>::min())) && !(BigInt(numeric_limits<T>::max()) < x);
+}
+
+/* True if r is a value of Rational<T> */
+template <typename T>
+bool Fits(const BigRational& r) {
+  return Fits<T>(r.Numerator()) && Fits<T>(r.Denominator());
+}
+
+template <typename T>
+bool Same(const Rational<T>& r, const BigRational& exact) {
+  return BigInt(r.Numerator()) == exact.Numerator() && BigInt(r.Denominator()) == exact.Denominator();
+}
+
+inline BigInt FloorBig(const BigRational& r) {
+  BigInt q = r.Numerator() / r.Denominator();
+  if (r.Numerator() % r.Denominator() != BigInt(0) && r.Numerator() < BigInt(0))
+    q -= BigInt(1);
+  return q;
+}
+
+template <typename T>
+string Show(const Rational<T>& r) {
+  return BigInt(r.Numerator()).ToString() + "/" + BigInt(r.Denominator()).ToString();
+}
+
+inline string Show(const BigRational& r) {
+  return r.Numerator().ToString() + "/" + r.Denominator().ToString();
+}
+
+// Operands
+// ========
+
+/* The edge values of T */
+template <typename T>
+vector<T> EdgeValues() {
+  const T max = numeric_limits<T>::max(), min = numeric_limits<T>::min();
+  T root = T(1);
+  while (root <= max / root / T(4))
+    root = T(root * T(2));
+  vector<T> values = { T(0), T(1), T(2), T(3), T(max), T(max - 1), T(max / 2),
+                       T(max / 2 + 1), root, T(root + 1), T(root - 1) };
+  if (IntTraits::IsSigned<T>::value) {
+    values.push_back(T(-1));
+    values.push_back(T(-2));
+    values.push_back(min);
+    values.push_back(T(min + 1));
+    values.push_back(T(-(max / 2)));
+    values.push_back(T(-root));
+  }
+  return values;
+}
+
+/*
+ * Draws operands: a quarter edge values, a quarter small values, the rest
+ * from the whole range. Also decodes fuzzer input, see FromBytes().
+ */
+template <typename T>
+class Source {
+private:
+  mt19937_64 random;
+  vector<T> edges;
+public:
+  explicit Source(unsigned long long seed): random(seed), edges(EdgeValues<T>()) { }
+
+  T Value() {
+    unsigned long long bits = random();
+    switch (bits % 4) {
+    case 0:
+      return edges[(bits >> 8) % edges.size()];
+    case 1:
+      return T(IntTraits::IsSigned<T>::value ? T(bits >> 8 & 31) - T(16) : T(bits >> 8 & 31));
+    default:
+      return T(random());
+    }
+  }
+
+  /* A Rational<T> of two such values. Pairs whose value doesn't fit in
+     Rational<T> (like min/-1) are drawn again. */
+  Rational<T> Next() {
+    for (;;) {
+      T n = Value(), d = Value();
+      if (d != T(0) && Fits<T>(BigRational(BigInt(n), BigInt(d))))
+        return Rational<T>(n, d);
+    }
+  }
+};
+
+/* A case: two operands and an integer */
+template <typename T>
+struct Case {
+  Rational<T> a, b;
+  T k;
+  BigRational A, B, K;
+};
+
+template <typename T>
+Case<T> MakeCase(const Rational<T>& a, const Rational<T>& b, T k) {
+  Case<T> c;
+  c.a = a;
+  c.b = b;
+  c.k = k;
+  c.A = Big(a);
+  c.B = Big(b);
+  c.K = BigRational(BigInt(k));
+  return c;
+}
+
+template <typename T>
+vector<Case<T> > MakeCases(Source<T>& source, size_t count) {
+  vector<Case<T> > cases;
+  for (size_t i = 0; i < count; ++i) {
+    Rational<T> a = source.Next(), b = source.Next();
+    cases.push_back(MakeCase(a, b, source.Value()));
+  }
+  return cases;
+}
+
+/*
+ * Cases from raw bytes, as the fuzzer gives them: each case takes the
+ * numerators and denominators of a and b and then k, sizeof(T) bytes each.
+ * Invalid pairs are skipped.
+ */
+template <typename T>
+vector<Case<T> > FromBytes(const unsigned char* data, size_t size) {
+  vector<Case<T> > cases;
+  const size_t width = sizeof(T), caseSize = 5 * width;
+  for (; size >= caseSize; data += caseSize, size -= caseSize) {
+    T v[5];
+    for (int i = 0; i < 5; ++i) {
+      typename IntTraits::Unsigned<T>::Type u = 0;
+      for (size_t j = 0; j < width; ++j)
+        u = typename IntTraits::Unsigned<T>::Type(u | (typename IntTraits::Unsigned<T>::Type(data[i * width + j]) << 8 * j));
+      v[i] = T(u);
+    }
+    if (v[1] == T(0) || v[3] == T(0) ||
+        !Fits<T>(BigRational(BigInt(v[0]), BigInt(v[1]))) ||
+        !Fits<T>(BigRational(BigInt(v[2]), BigInt(v[3]))))
+      continue;
+    cases.push_back(MakeCase(Rational<T>(v[0], v[1]), Rational<T>(v[2], v[3]), v[4]));
+  }
+  return cases;
+}
+
+// Paths
+// =====
+
+/*
+ * Runs op on the cases use(c) selects (to keep division by zero out, for
+ * example), timed, then exact (the oracle), and compares the results where
+ * the exact one fits in R.
+ */
+template <typename R, typename T, typename Op, typename Exact, typename Use>
+void Compare(Report& report, const char* name, const vector<Case<T> >& all,
+             Op op, Exact exact, Use use) {
+  Path& path = report.Get(name, TypeName<T>::Get());
+  vector<const Case<T>*> cases;
+  for (const Case<T>& c : all)
+    if (use(c))
+      cases.push_back(&c);
+  vector<Rational<R> > results(cases.size());
+  vector<BigRational> expected(cases.size());
+  path.cases += cases.size();
+  path.seconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i)
+      results[i] = op(*cases[i]);
+  });
+  path.oracleSeconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i)
+      expected[i] = exact(*cases[i]);
+  });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    if (!Fits<R>(expected[i]))
+      continue;
+    ++path.checks;
+    if (!Same(results[i], expected[i]))
+      report.Fail(path, Show(cases[i]->a) + ", " + Show(cases[i]->b) + ", k " +
+                  BigInt(cases[i]->k).ToString() + ": " + Show(results[i]) +
+                  " instead of " + Show(expected[i]));
+  }
+}
+
+template <typename T>
+bool Always(const Case<T>&) { return true; }
+
+/* Simplify() on the raw numerators and denominators, and the operators */
+template <typename T>
+void CheckOperators(Report& report, const vector<Case<T> >& cases) {
+  typedef Case<T> C;
+  // k over the numerator of b, as raw a pair as any
+  Compare<T>(report, "Simplify", cases,
+    [](const C& c) { return Rational<T>(c.k, c.b.Numerator()); },
+    [](const C& c) { return BigRational(BigInt(c.k), BigInt(c.b.Numerator())); },
+    [](const C& c) { return c.b.Numerator() != T(0) &&
+                            Fits<T>(BigRational(BigInt(c.k), BigInt(c.b.Numerator()))); });
+  Compare<T>(report, "Add", cases, [](const C& c) { return c.a + c.b; },
+             [](const C& c) { return c.A + c.B; }, Always<T>);
+  Compare<T>(report, "Subtract", cases, [](const C& c) { return c.a - c.b; },
+             [](const C& c) { return c.A - c.B; }, Always<T>);
+  Compare<T>(report, "Multiply", cases, [](const C& c) { return c.a * c.b; },
+             [](const C& c) { return c.A * c.B; }, Always<T>);
+  Compare<T>(report, "Divide", cases, [](const C& c) { return c.a / c.b; },
+             [](const C& c) { return c.A / c.B; },
+             [](const C& c) { return c.b != T(0); });
+  Compare<T>(report, "AddInteger", cases, [](const C& c) { return c.a + c.k; },
+             [](const C& c) { return c.A + c.K; }, Always<T>);
+  Compare<T>(report, "MultiplyInteger", cases, [](const C& c) { return c.a * c.k; },
+             [](const C& c) { return c.A * c.K; }, Always<T>);
+  Compare<T>(report, "DivideInteger", cases, [](const C& c) { return c.a / c.k; },
+             [](const C& c) { return c.A / c.K; },
+             [](const C& c) { return c.k != T(0); });
+  Compare<T>(report, "Increment", cases, [](const C& c) { Rational<T> r = c.a; return ++r; },
+             [](const C& c) { return c.A + BigRational(1); },
+             // Adds the denominator to the numerator in T
+             [](const C& c) { return Fits<T>(c.A + BigRational(1)); });
+
+  // Mixed widths, with a signed char operand
+  typedef typename IntTraits::LargestType<T, signed char>::Type L;
+  Compare<L>(report, "MixedWidth", cases,
+    [](const C& c) { return c.a * Rational<signed char>((signed char) c.k, 3); },
+    [](const C& c) { return c.A * BigRational(BigInt((signed char) c.k), BigInt(3)); },
+    Always<T>);
+}
+
+/* Fused expressions: the result must be exact wherever the operators' is */
+template <typename T>
+void CheckExpressions(Report& report, const vector<Case<T> >& cases) {
+  typedef Case<T> C;
+  // Only where every intermediate of the operators fits, as the operators
+  // give nothing otherwise
+  Compare<T>(report, "Lazy", cases,
+    [](const C& c) { return (Rational<T>) (Lazy(c.a) * c.b + c.a - c.b); },
+    [](const C& c) { return c.A * c.B + c.A - c.B; },
+    [](const C& c) { return Fits<T>(c.A * c.B) && Fits<T>(c.A * c.B + c.A); });
+  Compare<T>(report, "Eager", cases,
+    [](const C& c) { return c.a * c.b + c.a - c.b; },
+    [](const C& c) { return c.A * c.B + c.A - c.B; },
+    [](const C& c) { return Fits<T>(c.A * c.B) && Fits<T>(c.A * c.B + c.A); });
+}
+
+/* The element-wise operator op of RationalVector on every case at once */
+template <typename T, typename Op, typename Exact>
+void CompareVector(Report& report, const char* name, const vector<Case<T> >& cases,
+                   const RationalVector<T>& a, const RationalVector<T>& b, Op op, Exact exact) {
+  Path& path = report.Get(name, TypeName<T>::Get());
+  path.cases += cases.size();
+  RationalVector<T> results = a;
+  path.seconds += Time([&]() { op(results, b); });
+  vector<BigRational> expected(cases.size());
+  path.oracleSeconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i)
+      expected[i] = exact(Big(a[i]), Big(b[i]));
+  });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    if (!Fits<T>(expected[i]))
+      continue;
+    ++path.checks;
+    if (!Same(results[i], expected[i]))
+      report.Fail(path, Show(a[i]) + ", " + Show(b[i]) + ": " + Show(results[i]) +
+                  " instead of " + Show(expected[i]));
+  }
+}
+
+/* The batched kernels of RationalVector against the oracle */
+template <typename T>
+void CheckVector(Report& report, const vector<Case<T> >& cases) {
+  RationalVector<T> a, b, divisors;
+  for (const Case<T>& c : cases) {
+    a.PushBack(c.a);
+    b.PushBack(c.b);
+    divisors.PushBack(c.b == T(0) ? Rational<T>(1) : c.b);
+  }
+  CompareVector(report, "VectorAdd", cases, a, b,
+    [](RationalVector<T>& x, const RationalVector<T>& y) { x += y; },
+    [](const BigRational& x, const BigRational& y) { return x + y; });
+  CompareVector(report, "VectorSubtract", cases, a, b,
+    [](RationalVector<T>& x, const RationalVector<T>& y) { x -= y; },
+    [](const BigRational& x, const BigRational& y) { return x - y; });
+  CompareVector(report, "VectorMultiply", cases, a, b,
+    [](RationalVector<T>& x, const RationalVector<T>& y) { x *= y; },
+    [](const BigRational& x, const BigRational& y) { return x * y; });
+  CompareVector(report, "VectorDivide", cases, a, divisors,
+    [](RationalVector<T>& x, const RationalVector<T>& y) { x /= y; },
+    [](const BigRational& x, const BigRational& y) { return x / y; });
+
+  // Comparison and conversion, against the scalar paths checked above
+  Path& compare = report.Get("VectorCompare", TypeName<T>::Get());
+  compare.cases += cases.size();
+  vector<int> order(cases.size());
+  compare.seconds += Time([&]() { ::Compare(a, b, order.data()); });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    ++compare.checks;
+    int exact = cases[i].A < cases[i].B ? -1 : cases[i].B < cases[i].A ? 1 : 0;
+    if ((order[i] > 0) - (order[i] < 0) != exact)
+      report.Fail(compare, Show(cases[i].a) + " vs " + Show(cases[i].b));
+  }
+  Path& doubles = report.Get("VectorToDouble", TypeName<T>::Get());
+  doubles.cases += cases.size();
+  vector<double> converted(cases.size());
+  doubles.seconds += Time([&]() { ToDouble(a, converted.data()); });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    ++doubles.checks;
+    if (converted[i] != (double) cases[i].a)
+      report.Fail(doubles, Show(cases[i].a));
+  }
+
+  // Floor of the whole vector, with the quotient in double
+  Path& floor = report.Get("VectorFloor", TypeName<T>::Get());
+  floor.cases += cases.size();
+  vector<T> floors(cases.size());
+  floor.seconds += Time([&]() { Floor(a, floors.data()); });
+  vector<BigInt> exact(cases.size());
+  floor.oracleSeconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i)
+      exact[i] = FloorBig(cases[i].A);
+  });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    ++floor.checks;
+    if (BigInt(floors[i]) != exact[i])
+      report.Fail(floor, Show(cases[i].a) + ": " + BigInt(floors[i]).ToString());
+  }
+}
+
+/* The accumulator over the longest prefix of the cases whose partial sums
+   all fit */
+template <typename T>
+void CheckAccumulator(Report& report, const vector<Case<T> >& cases) {
+  Path& path = report.Get("Accumulator", TypeName<T>::Get());
+  BigRational exact;
+  size_t count = 0;
+  path.oracleSeconds += Time([&]() {
+    for (; count < cases.size(); ++count) {
+      BigRational next = exact + cases[count].A;
+      if (!Fits<T>(next))
+        break;
+      exact = next;
+    }
+  });
+  RationalAccumulator<T> sum;
+  path.cases += count;
+  path.seconds += Time([&]() {
+    for (size_t i = 0; i < count; ++i)
+      sum += cases[i].a;
+  });
+  ++path.checks;
+  if (!Same(sum.Value(), exact))
+    report.Fail(path, "sum of " + to_string(count) + ": " + Show(sum.Value()) +
+                " instead of " + Show(exact));
+}
+
+/* AtomicRational, one thread: a + b + 1/k for each case where a + b fits,
+   which goes through the equal denominator, unreduced and reducing paths.
+   ShardedRational sums the longest prefix of the cases whose partial sums
+   all fit. T must be at most 32 bits wide. */
+template <typename T>
+void CheckAtomic(Report& report, const vector<Case<T> >& cases, true_type) {
+  Path& atomic = report.Get("Atomic", TypeName<T>::Get());
+  vector<Rational<T> > results(cases.size());
+  atomic.cases += cases.size();
+  atomic.seconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i) {
+      AtomicRational<T> x(cases[i].a);
+      x.Add(cases[i].b);
+      if (cases[i].k != T(0))
+        x.Add(Rational<T>(T(1), cases[i].k));
+      results[i] = x.Load();
+    }
+  });
+  vector<BigRational> sums(cases.size()), expected(cases.size());
+  atomic.oracleSeconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i) {
+      sums[i] = cases[i].A + cases[i].B;
+      expected[i] = cases[i].k == T(0) ? sums[i] : sums[i] + BigRational(1) / cases[i].K;
+    }
+  });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    if (!Fits<T>(sums[i]) || !Fits<T>(expected[i]))
+      continue;
+    ++atomic.checks;
+    if (!Same(results[i], expected[i]))
+      report.Fail(atomic, Show(cases[i].a) + " + " + Show(cases[i].b) + " + 1/" +
+                  BigInt(cases[i].k).ToString() + ": " + Show(results[i]) +
+                  " instead of " + Show(expected[i]));
+  }
+
+  Path& sharded = report.Get("Sharded", TypeName<T>::Get());
+  BigRational exact;
+  size_t count = 0;
+  sharded.oracleSeconds += Time([&]() {
+    for (; count < cases.size(); ++count) {
+      BigRational next = exact + cases[count].A;
+      if (!Fits<T>(next))
+        break;
+      exact = next;
+    }
+  });
+  ShardedRational<T> sum;
+  sharded.cases += count;
+  sharded.seconds += Time([&]() {
+    for (size_t i = 0; i < count; ++i)
+      sum += cases[i].a;
+  });
+  ++sharded.checks;
+  if (!Same(sum.Load(), exact))
+    report.Fail(sharded, "sum of " + to_string(count) + ": " + Show(sum.Load()) +
+                " instead of " + Show(exact));
+}
+
+template <typename T>
+void CheckAtomic(Report&, const vector<Case<T> >&, false_type) { }
+
+/*
+ * Selects the terms of which every subset sums to a value of Rational<T>,
+ * in order, skipping the others: the magnitudes of the selected terms add up
+ * to a numerator that fits over the LCM of their denominators, which fits
+ * too. The workers of ParallelReduce add up chunks in any grouping.
+ */
+template <typename T>
+vector<size_t> SubsetSafe(const vector<BigRational>& terms) {
+  vector<size_t> selected;
+  BigInt lcm(1), total(0);
+  for (size_t i = 0; i < terms.size(); ++i) {
+    const BigInt& d = terms[i].Denominator();
+    BigInt next = lcm / Gcd(lcm, d) * d;
+    BigInt magnitude = terms[i].Numerator() < BigInt(0) ? -terms[i].Numerator()
+                                                        : terms[i].Numerator();
+    BigInt sum = total * (next / lcm) + magnitude * (next / d);
+    if (!Fits<T>(next) || !Fits<T>(sum))
+      continue;
+    selected.push_back(i);
+    lcm = next;
+    total = sum;
+  }
+  return selected;
+}
+
+/* ParallelSum of the a and ParallelDot of the a and b of the cases whose
+   sums can't overflow, on four threads */
+template <typename T>
+void CheckParallel(Report& report, const vector<Case<T> >& cases) {
+  const char* names[] = { "ParallelSum", "ParallelDot" };
+  for (int dot = 0; dot < 2; ++dot) {
+    Path& path = report.Get(names[dot], TypeName<T>::Get());
+    vector<BigRational> terms;
+    for (const Case<T>& c : cases)
+      terms.push_back(dot ? c.A * c.B : c.A);
+    vector<size_t> selected = SubsetSafe<T>(terms);
+    vector<Rational<T> > left, right;
+    for (size_t i : selected) {
+      left.push_back(cases[i].a);
+      right.push_back(cases[i].b);
+    }
+    Rational<T> result;
+    path.cases += selected.size();
+    path.seconds += Time([&]() {
+      result = dot ? ParallelDot(left, right, 4) : ParallelSum(left, 4);
+    });
+    BigRational exact;
+    path.oracleSeconds += Time([&]() {
+      for (size_t i : selected)
+        exact += terms[i];
+    });
+    ++path.checks;
+    if (!Same(result, exact))
+      report.Fail(path, "of " + to_string(selected.size()) + ": " + Show(result) +
+                  " instead of " + Show(exact));
+  }
+}
+
+/* Comparisons, which never overflow */
+template <typename T>
+void CheckComparisons(Report& report, const vector<Case<T> >& cases) {
+  Path& path = report.Get("Compare", TypeName<T>::Get());
+  path.cases += cases.size();
+  vector<int> results(cases.size()), expected(cases.size());
+  path.seconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i)
+      results[i] = (cases[i].a < cases[i].b) | (cases[i].a == cases[i].b) << 1 |
+                   (cases[i].a <= cases[i].b) << 2 | (cases[i].a < cases[i].k) << 3;
+  });
+  path.oracleSeconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i)
+      expected[i] = (cases[i].A < cases[i].B) | (cases[i].A == cases[i].B) << 1 |
+                    (cases[i].A <= cases[i].B) << 2 | (cases[i].A < cases[i].K) << 3;
+  });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    ++path.checks;
+    if (results[i] != expected[i])
+      report.Fail(path, Show(cases[i].a) + " vs " + Show(cases[i].b) + ", k " +
+                  BigInt(cases[i].k).ToString());
+  }
+}
+
+/* Floor, Ceil and Round ties to even, scalar */
+template <typename T>
+void CheckIntegerParts(Report& report, const vector<Case<T> >& cases) {
+  Path& path = report.Get("IntegerParts", TypeName<T>::Get());
+  path.cases += cases.size();
+  vector<T> floors(cases.size()), ceils(cases.size()), rounds(cases.size());
+  path.seconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i) {
+      floors[i] = Floor(cases[i].a);
+      ceils[i] = Ceil(cases[i].a);
+      rounds[i] = Round(cases[i].a);
+    }
+  });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    const BigRational& x = cases[i].A;
+    BigInt floor = FloorBig(x);
+    BigInt ceil = x.Denominator() == BigInt(1) ? floor : floor + BigInt(1);
+    // Against 1/2: 2 (x - floor) against 1
+    BigInt twice = (x.Numerator() - floor * x.Denominator()) * BigInt(2);
+    BigInt round = twice < x.Denominator() ? floor : x.Denominator() < twice ? ceil :
+                   floor % BigInt(2) == BigInt(0) ? floor : ceil;
+    if (!Fits<T>(ceil) || !Fits<T>(round))
+      continue;
+    ++path.checks;
+    if (BigInt(floors[i]) != floor || BigInt(ceils[i]) != ceil || BigInt(rounds[i]) != round)
+      report.Fail(path, Show(cases[i].a) + ": " + BigInt(floors[i]).ToString() + " " +
+                  BigInt(ceils[i]).ToString() + " " + BigInt(rounds[i]).ToString());
+  }
+}
+
+/* a - q b, q the quotient of a / b truncated toward zero */
+inline BigRational RemainderBig(const BigRational& a, const BigRational& b) {
+  BigInt q = (a.Numerator() * b.Denominator()) / (a.Denominator() * b.Numerator());
+  return a - BigRational(q) * b;
+}
+
+/* DivMod() and %, by a Rational and by an integer. The remainder is checked
+   wherever it fits, also where the quotient doesn't (the minimum by -1). */
+template <typename T>
+void CheckDivMod(Report& report, const vector<Case<T> >& cases) {
+  typedef Case<T> C;
+  Compare<T>(report, "Modulo", cases, [](const C& c) { return c.a % c.b; },
+             [](const C& c) { return RemainderBig(c.A, c.B); },
+             [](const C& c) { return c.b != T(0); });
+  Compare<T>(report, "ModuloInteger", cases, [](const C& c) { return c.a % c.k; },
+             [](const C& c) { return RemainderBig(c.A, c.K); },
+             [](const C& c) { return c.k != T(0); });
+  Compare<T>(report, "DivModQuotient", cases,
+    [](const C& c) { return Rational<T>(DivMod(c.a, c.b).quotient); },
+    [](const C& c) { return BigRational((c.A.Numerator() * c.B.Denominator()) /
+                                        (c.A.Denominator() * c.B.Numerator())); },
+    [](const C& c) { return c.b != T(0); });
+}
+
+/* Conversion to double, against the quotient of the exact operands where
+   they are exact in double (IEEE division is correctly rounded) */
+template <typename T>
+void CheckDouble(Report& report, const vector<Case<T> >& cases) {
+  Path& path = report.Get("ToDouble", TypeName<T>::Get());
+  path.cases += cases.size();
+  vector<double> results(cases.size());
+  path.seconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i)
+      results[i] = (double) cases[i].a;
+  });
+  const double exact = 9007199254740992.0;
+  for (size_t i = 0; i < cases.size(); ++i) {
+    double n = (double) cases[i].a.Numerator(), d = (double) cases[i].a.Denominator();
+    if (n >= exact || -n >= exact || d >= exact)
+      continue;
+    ++path.checks;
+    if (results[i] != n / d)
+      report.Fail(path, Show(cases[i].a));
+  }
+}
+
+/* Round trips: formatting and parsing, and continued fractions */
+template <typename T>
+void CheckRoundTrips(Report& report, const vector<Case<T> >& cases) {
+  Path& chars = report.Get("Chars", TypeName<T>::Get());
+  chars.cases += cases.size();
+  vector<Rational<T> > parsed(cases.size());
+  chars.seconds += Time([&]() {
+    char buffer[RationalChars<T>::MaxLength];
+    for (size_t i = 0; i < cases.size(); ++i) {
+      ToCharsResult written = ToChars(buffer, buffer + sizeof(buffer), cases[i].a);
+      FromChars(buffer, written.ptr, parsed[i]);
+    }
+  });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    ++chars.checks;
+    if (parsed[i] != cases[i].a)
+      report.Fail(chars, Show(cases[i].a) + ": " + Show(parsed[i]));
+  }
+
+  Path& fractions = report.Get("ContinuedFraction", TypeName<T>::Get());
+  fractions.cases += cases.size();
+  vector<Rational<T> > rebuilt(cases.size());
+  fractions.seconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i) {
+      RationalContinuedFractions::Range<T, RationalContinuedFractions::QuotientIterator<T> >
+        quotients = Quotients(cases[i].a);
+      rebuilt[i] = FromContinuedFraction<T>(quotients.begin(), quotients.end());
+    }
+  });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    ++fractions.checks;
+    if (rebuilt[i] != cases[i].a)
+      report.Fail(fractions, Show(cases[i].a) + ": " + Show(rebuilt[i]));
+  }
+}
+
+/* SortRationals() against the order of the oracle */
+template <typename T>
+void CheckSort(Report& report, const vector<Case<T> >& cases) {
+  Path& path = report.Get("Sort", TypeName<T>::Get());
+  vector<Rational<T> > values;
+  for (const Case<T>& c : cases) {
+    values.push_back(c.a);
+    values.push_back(c.b);
+  }
+  vector<Rational<T> > sorted = values;
+  path.cases += values.size();
+  path.seconds += Time([&]() { SortRationals(sorted, 1); });
+  vector<BigRational> exact;
+  for (const Rational<T>& r : values)
+    exact.push_back(Big(r));
+  path.oracleSeconds += Time([&]() { sort(exact.begin(), exact.end()); });
+  ++path.checks;
+  for (size_t i = 0; i < sorted.size(); ++i)
+    if (!Same(sorted[i], exact[i])) {
+      report.Fail(path, "at " + to_string(i) + " of " + to_string(sorted.size()) + ": " +
+                  Show(sorted[i]) + " instead of " + Show(exact[i]));
+      break;
+    }
+}
+
+/* CheckedRational: no overflow reported where a wider type holds the
+   products and the result fits, and the right result where none is */
+template <typename T>
+void CheckChecked(Report& report, const vector<Case<T> >& cases) {
+  typedef CheckedRational<T, OverflowPolicy::Flag> Checked;
+  Path& path = report.Get("Checked", TypeName<T>::Get());
+  path.cases += 2 * cases.size();
+  vector<Checked> sums(cases.size()), products(cases.size());
+  path.seconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i) {
+      sums[i] = Checked(cases[i].a);
+      sums[i] += Checked(cases[i].b);
+      products[i] = Checked(cases[i].a);
+      products[i] *= Checked(cases[i].b);
+    }
+  });
+  const bool wider = sizeof(typename IntTraits::NextType<T>::Type) > sizeof(T);
+  for (size_t i = 0; i < cases.size(); ++i) {
+    const Checked* results[] = { &sums[i], &products[i] };
+    BigRational exact[] = { cases[i].A + cases[i].B, cases[i].A * cases[i].B };
+    for (int j = 0; j < 2; ++j) {
+      bool fits = Fits<T>(exact[j]);
+      ++path.checks;
+      if (results[j]->Overflowed() ? fits && wider : !fits || !Same(results[j]->Value(), exact[j]))
+        report.Fail(path, Show(cases[i].a) + (j ? " * " : " + ") + Show(cases[i].b) + ": " +
+                    (results[j]->Overflowed() ? string("overflow") : Show(results[j]->Value())));
+    }
+  }
+}
+
+/* CheckedRational from the raw pair k over the numerator of b, which takes
+   in 0/-n and the minimum over -1: overflow exactly where the value doesn't
+   fit or the denominator is 0 */
+template <typename T>
+void CheckCheckedPairs(Report& report, const vector<Case<T> >& cases) {
+  typedef CheckedRational<T, OverflowPolicy::Flag> Checked;
+  Path& path = report.Get("CheckedPair", TypeName<T>::Get());
+  path.cases += cases.size();
+  vector<Checked> results(cases.size());
+  path.seconds += Time([&]() {
+    for (size_t i = 0; i < cases.size(); ++i)
+      results[i] = Checked(cases[i].k, cases[i].b.Numerator());
+  });
+  for (size_t i = 0; i < cases.size(); ++i) {
+    T d = cases[i].b.Numerator();
+    bool fits = d != T(0) && Fits<T>(BigRational(BigInt(cases[i].k), BigInt(d)));
+    ++path.checks;
+    if (results[i].Overflowed() ? fits :
+        !fits || !Same(results[i].Value(), BigRational(BigInt(cases[i].k), BigInt(d))))
+      report.Fail(path, BigInt(cases[i].k).ToString() + "/" + BigInt(d).ToString() + ": " +
+                  (results[i].Overflowed() ? string("overflow") : Show(results[i].Value())));
+  }
+}
+
+/* RationalHashMap against std::map: counts of the a and b of the cases and
+   of the raw pairs k over the numerator of b (0/-n among them), then every
+   third a erased. Keys k/0 must be rejected, leaving the map as it was. */
+template <typename T>
+void CheckHashMap(Report& report, const vector<Case<T> >& cases) {
+  Path& path = report.Get("HashMap", TypeName<T>::Get());
+  vector<Rational<T> > keys;
+  for (const Case<T>& c : cases) {
+    keys.push_back(c.a);
+    keys.push_back(c.b);
+    if (c.b.Numerator() != T(0) && Fits<T>(BigRational(BigInt(c.k), BigInt(c.b.Numerator()))))
+      keys.push_back(Rational<T>(c.k, c.b.Numerator()));
+  }
+  RationalHashMap<T, size_t> counts;
+  path.cases += keys.size();
+  path.seconds += Time([&]() {
+    for (const Rational<T>& key : keys)
+      ++counts[key];
+    for (size_t i = 0; i < cases.size(); i += 3)
+      counts.Erase(cases[i].a);
+  });
+  map<BigRational, size_t> exact;
+  path.oracleSeconds += Time([&]() {
+    for (const Rational<T>& key : keys)
+      ++exact[Big(key)];
+    for (size_t i = 0; i < cases.size(); i += 3)
+      exact.erase(cases[i].A);
+  });
+  for (const Case<T>& c : cases) {
+    if (c.k == T(0))
+      continue;
+    bool rejected = false;
+    try {
+      counts.Insert(Rational<T>(c.k, T(0)), 0);
+    } catch (const invalid_argument&) {
+      rejected = true;
+    }
+    ++path.checks;
+    if (!rejected)
+      report.Fail(path, BigInt(c.k).ToString() + "/0 inserted");
+  }
+  ++path.checks;
+  if (counts.Size() != exact.size())
+    report.Fail(path, to_string(counts.Size()) + " keys instead of " + to_string(exact.size()));
+  for (const Rational<T>& key : keys) {
+    typename map<BigRational, size_t>::const_iterator e = exact.find(Big(key));
+    const size_t* count = counts.Find(key);
+    ++path.checks;
+    if (e == exact.end() ? count != 0 : count == 0 || *count != e->second)
+      report.Fail(path, Show(key) + ": " + (count ? to_string(*count) : string("missing")) +
+                  " instead of " + (e == exact.end() ? string("missing") : to_string(e->second)));
+  }
+}
+
+/* The determinant of the 3 x 3 matrix m, by cofactors */
+inline BigRational Determinant3(const BigRational m[3][3]) {
+  return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+         m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+         m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+/* A system of the linear checks and its name in the report */
+template <typename T>
+struct System {
+  Rational<T> m[3][3], side[3];
+  string name;
+};
+
+/*
+ * Systems of edge pivots: [[p, u, 0], [v, 0, 0], [0, 0, q]] and the right
+ * hand side [v, 1, u], with p 1 or -1 and u and v edge values. The next
+ * pivot is then -uv, min or max products next to a division by -1, and q
+ * (2, -2 or p) scales it again towards the end of the work type.
+ */
+template <typename T>
+vector<System<T> > EdgeSystems() {
+  vector<T> edges = EdgeValues<T>(), pivots = { T(1) };
+  if (IntTraits::IsSigned<T>::value)
+    pivots.push_back(T(-1));
+  vector<System<T> > systems;
+  for (T p : pivots)
+    for (T u : edges)
+      for (T v : edges)
+        for (T q : { p, T(2), T(-2) }) {
+          if (!IntTraits::IsSigned<T>::value && q != T(2) && q != p)
+            continue;
+          Rational<T> zero, one(1);
+          System<T> system = { { { p, u, zero }, { v, zero, zero }, { zero, zero, q } },
+                               { v, one, u },
+                               "pivot " + Show(Rational<T>(p)) + ", " + Show(Rational<T>(u)) +
+                               ", " + Show(Rational<T>(v)) + ", " + Show(Rational<T>(q)) };
+          systems.push_back(system);
+        }
+  return systems;
+}
+
+/*
+ * Solve() and Determinant() of [[a, b, 1], [k, a, b], [1, k, a]] and the
+ * right hand side [b, 1, k], and of the EdgeSystems(), against Cramer's
+ * rule. Where the exact result doesn't fit, overflow_error must be thrown,
+ * and domain_error by Solve() where the matrix is singular. A system costs
+ * as much as a hundred operators, so only every eighth case is used.
+ */
+template <typename T>
+void CheckLinear(Report& report, const vector<Case<T> >& all) {
+  vector<System<T> > systems = EdgeSystems<T>();
+  for (size_t i = 0; i < all.size(); i += 8) {
+    const Case<T>& c = all[i];
+    Rational<T> one(1), k(c.k);
+    System<T> system = { { { c.a, c.b, one }, { k, c.a, c.b }, { one, k, c.a } },
+                         { c.b, one, k },
+                         Show(c.a) + ", " + Show(c.b) + ", k " + BigInt(c.k).ToString() };
+    systems.push_back(system);
+  }
+  Path& solve = report.Get("Solve", TypeName<T>::Get());
+  Path& determinant = report.Get("Determinant", TypeName<T>::Get());
+  // Results, or -1 for overflow_error and -2 for domain_error
+  vector<vector<Rational<T> > > solutions(systems.size());
+  vector<Rational<T> > determinants(systems.size());
+  vector<int> solveErrors(systems.size()), determinantErrors(systems.size());
+  solve.cases += systems.size();
+  determinant.cases += systems.size();
+  vector<RationalMatrix<T> > matrices;
+  vector<vector<Rational<T> > > sides;
+  for (const System<T>& s : systems) {
+    matrices.push_back(RationalMatrix<T>({ { s.m[0][0], s.m[0][1], s.m[0][2] },
+                                           { s.m[1][0], s.m[1][1], s.m[1][2] },
+                                           { s.m[2][0], s.m[2][1], s.m[2][2] } }));
+    sides.push_back({ s.side[0], s.side[1], s.side[2] });
+  }
+  solve.seconds += Time([&]() {
+    for (size_t i = 0; i < systems.size(); ++i)
+      try {
+        solutions[i] = Solve(matrices[i], sides[i]);
+      } catch (const overflow_error&) {
+        solveErrors[i] = -1;
+      } catch (const domain_error&) {
+        solveErrors[i] = -2;
+      }
+  });
+  determinant.seconds += Time([&]() {
+    for (size_t i = 0; i < systems.size(); ++i)
+      try {
+        determinants[i] = Determinant(matrices[i]);
+      } catch (const overflow_error&) {
+        determinantErrors[i] = -1;
+      }
+  });
+
+  for (size_t i = 0; i < systems.size(); ++i) {
+    const string& matrix = systems[i].name;
+    BigRational m[3][3], side[3];
+    for (int r = 0; r < 3; ++r) {
+      for (int col = 0; col < 3; ++col)
+        m[r][col] = Big(systems[i].m[r][col]);
+      side[r] = Big(systems[i].side[r]);
+    }
+    BigRational det;
+    determinant.oracleSeconds += Time([&]() { det = Determinant3(m); });
+
+    ++determinant.checks;
+    if (Fits<T>(det) ? determinantErrors[i] != 0 || !Same(determinants[i], det)
+                     : determinantErrors[i] != -1)
+      report.Fail(determinant, matrix + ": " + (determinantErrors[i] ? string("overflow") :
+                  Show(determinants[i])) + " instead of " + Show(det));
+
+    ++solve.checks;
+    if (det == BigRational(0)) {
+      if (solveErrors[i] != -2)
+        report.Fail(solve, matrix + ": singular, but no domain_error");
+      continue;
+    }
+    BigRational x[3];
+    bool fits = true;
+    solve.oracleSeconds += Time([&]() {
+      for (int j = 0; j < 3; ++j) {
+        BigRational replaced[3][3];
+        for (int r = 0; r < 3; ++r)
+          for (int col = 0; col < 3; ++col)
+            replaced[r][col] = col == j ? side[r] : m[r][col];
+        x[j] = Determinant3(replaced) / det;
+        fits = fits && Fits<T>(x[j]);
+      }
+    });
+    bool same = solveErrors[i] == 0;
+    for (int j = 0; same && j < 3; ++j)
+      same = Same(solutions[i][j], x[j]);
+    if (fits ? !same : solveErrors[i] != -1)
+      report.Fail(solve, matrix + ": " + (solveErrors[i] == -1 ? string("overflow") :
+                  solveErrors[i] == -2 ? string("singular") : Show(solutions[i][0])) +
+                  " instead of " + Show(x[0]));
+  }
+}
+
+/* Every path on the cases */
+template <typename T>
+void CheckAll(Report& report, const vector<Case<T> >& cases) {
+  CheckOperators(report, cases);
+  CheckExpressions(report, cases);
+  CheckVector(report, cases);
+  CheckAccumulator(report, cases);
+  CheckAtomic(report, cases, integral_constant<bool, sizeof(T) <= 4>());
+  CheckParallel(report, cases);
+  CheckComparisons(report, cases);
+  CheckIntegerParts(report, cases);
+  CheckDivMod(report, cases);
+  CheckDouble(report, cases);
+  CheckRoundTrips(report, cases);
+  CheckSort(report, cases);
+  CheckHashMap(report, cases);
+  CheckLinear(report, cases);
+  CheckChecked(report, cases);
+  CheckCheckedPairs(report, cases);
+}
+
+}
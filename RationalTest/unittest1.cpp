@@ -1,12 +1,40 @@
 #include "stdafx.h"
 #include "CppUnitTest.h"
 #include "Rational.h"
+#include "CheckedRational.h"
+#include "BigInt.h"
+#include "RationalVector.h"
+#include "RationalAccumulator.h"
+#include "ParallelReduce.h"
+#include "RationalChars.h"
+#include "RationalFile.h"
+#include "RationalCounters.h"
+#include "RationalHashMap.h"
+#include "RationalExpression.h"
+#include "RationalMatrix.h"
+#include "AtomicRational.h"
+#include "RationalSpan.h"
+#include "ContinuedFraction.h"
+#include "RationalSort.h"
 #include <typeinfo>
 #include <sstream>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <unordered_set>
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
+// Euclid's algorithm for signed char, whose GCDs take the sign of the
+// operands, so that the sign fix-ups after a Gcd() are tested too
+template <>
+struct GcdTraits::Engine<signed char> {
+  typedef GcdTraits::Euclid Type;
+};
+
 namespace RationalTest
 {	
   typedef Rational<short> Rshort;
@@ -184,5 +212,1220 @@ namespace RationalTest
 	  Assert::IsTrue((Rshort(1)+(int)INT_MAX)==INT_MIN);
     }
     
+    TEST_METHOD(Gcd)
+    {
+      long long values[] = { 0, 1, -1, 2, 3, 12, -18, 1024, 7 * 64, 97,
+        SHRT_MAX, SHRT_MIN + 1, INT_MAX, INT_MIN + 1, 1LL << 40, -(3LL << 50) };
+      for (long long a : values)
+        for (long long b : values) {
+          long long euclid = EuclidGcd(a, b);
+          if (euclid < 0)
+            euclid = -euclid;
+          Assert::IsTrue(BinaryGcd(a, b) == euclid);
+          if (a == (int) a && b == (int) b)
+            Assert::IsTrue(BinaryGcd((int) a, (int) b) == euclid);
+          if (a == (short) a && b == (short) b)
+            Assert::IsTrue(BinaryGcd((short) a, (short) b) == euclid);
+        }
+      Assert::IsTrue(BinaryGcd(INT_MIN, -1) == 1);
+      Assert::IsTrue(BinaryGcd((short) SHRT_MIN, (short) 6) == 2);
+
+      // Simplify() must give the same result whichever engine it uses
+      Assert::IsTrue(Rint(-48, 18) == Rint(-8, 3));
+      Assert::IsTrue(Rint(INT_MIN, 2) == Rint(INT_MIN / 2, 1));
+      Assert::IsTrue(Rshort((short) SHRT_MIN, (short) SHRT_MIN) == Rshort(1));
+      Assert::IsTrue(RLL(1LL << 62, -(1LL << 60)) == RLL(-4));
+    }
+
+    TEST_METHOD(Relational)
+    {
+      Assert::IsTrue(Rint(1, 3) < Rint(1, 2));
+      Assert::IsTrue(Rint(-1, 2) < Rint(-1, 3));
+      Assert::IsTrue(Rint(2, 4) <= Rint(1, 2) && Rint(2, 4) >= Rint(1, 2));
+      Assert::IsTrue(Rshort(1, 2) > Rint(-3, 2));
+      Assert::IsTrue(Rint(INT_MAX) > Rint(INT_MIN));
+      Assert::IsTrue(Rint(INT_MAX, INT_MAX - 1) < Rint(INT_MAX - 1, INT_MAX - 2));
+      Assert::IsTrue(RLL(LLONG_MAX) > RLL(LLONG_MIN + 1));
+      Assert::IsTrue(RLL(LLONG_MAX - 1, LLONG_MAX) > RLL(LLONG_MAX - 2, LLONG_MAX - 1));
+      Assert::IsTrue(RLL(LLONG_MAX, LLONG_MAX - 1) > RLL(1));
+
+      // Continued fraction path against exact cross-multiplication
+      int values[] = { 0, 1, -1, 2, -3, 7, 12, 100, -1000, SHRT_MAX, INT_MAX, INT_MIN + 1 };
+      for (int a : values)
+        for (int b : values)
+          for (int c : values)
+            for (int d : values) {
+              if (b <= 0 || d <= 0)
+                continue;
+              long long lhs = (long long) a * d, rhs = (long long) c * b;
+              int expected = lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+              Assert::IsTrue(CompareFractions(a, b, c, d) == expected);
+              Assert::IsTrue(Compare(Rint(a, b), Rint(c, d)) == expected);
+            }
+    }
+
+    TEST_METHOD(Widening)
+    {
+      // NextType is at least twice as wide, LargestType holds both ranges
+      Assert::IsTrue(sizeof(IntTraits::NextType<short>::Type) >= 2 * sizeof(short));
+      Assert::IsTrue(sizeof(IntTraits::NextType<int>::Type) >= 2 * sizeof(int));
+      Assert::IsTrue(sizeof(IntTraits::NextType<unsigned>::Type) >= 2 * sizeof(unsigned));
+      Assert::IsTrue(IntTraits::IsSigned<IntTraits::NextType<int>::Type>::value);
+      Assert::IsTrue(!IntTraits::IsSigned<IntTraits::NextType<unsigned>::Type>::value);
+      Assert::IsTrue((is_same<IntTraits::LargestType<short, int>::Type, int>::value));
+      Assert::IsTrue((is_same<IntTraits::LargestType<unsigned, unsigned short>::Type, unsigned>::value));
+      Assert::IsTrue((is_same<IntTraits::LargestType<unsigned short, int>::Type, int>::value));
+      Assert::IsTrue(sizeof(IntTraits::LargestType<int, unsigned>::Type) > sizeof(int));
+#ifdef RATIONAL_HAS_INT128
+      Assert::IsTrue(sizeof(IntTraits::NextType<long>::Type) >= 2 * sizeof(long));
+      Assert::IsTrue(sizeof(IntTraits::NextType<long long>::Type) == 16);
+
+      // 64 bit rationals have headroom for the products
+      RLL big(1LL << 40, 3), sum = big + big;
+      Assert::IsTrue(sum == RLL(1LL << 41, 3));
+      Assert::IsTrue(RLL(LLONG_MAX, 3) * RLL(3, LLONG_MAX) == RLL(1));
+      Rational<long> l1(LONG_MAX - 1, LONG_MAX), l2(1, LONG_MAX);
+      Assert::IsTrue(l1 + l2 == Rational<long>(1));
+#endif
+
+      Rational<unsigned> u1(6, 8), u2(1, 4);
+      Assert::IsTrue(u1 + u2 == Rational<unsigned>(1));
+      Assert::IsTrue(u1 * u2 == Rational<unsigned>(3, 16));
+      Assert::IsTrue(u2 < u1);
+    }
+
+    TEST_METHOD(CrossCancel)
+    {
+      // Pre-reduced arithmetic against reducing the full products afterwards
+      short values[] = { 0, 1, -1, 2, -3, 6, 8, 12, -15, 36, 120, -128, 181, 255 };
+      for (short a : values)
+        for (short b : values)
+          for (short c : values)
+            for (short d : values) {
+              if (b <= 0 || d <= 0)
+                continue;
+              Rshort x(a, b), y(c, d);
+              long long xn = x.Numerator(), xd = x.Denominator();
+              long long yn = y.Numerator(), yd = y.Denominator();
+              RLL expected[] = { RLL(xn * yd + yn * xd, xd * yd),
+                RLL(xn * yd - yn * xd, xd * yd), RLL(xn * yn, xd * yd),
+                RLL(xn * yd, xd * yn) };
+              Rshort actual[] = { x, x, x, x };
+              actual[0] += y;
+              actual[1] -= y;
+              actual[2] *= y;
+              if (c != 0)
+                actual[3] /= y;
+              for (int i = 0; i < (c != 0 ? 4 : 3); ++i)
+                if (expected[i].Numerator() == (short) expected[i].Numerator() &&
+                    expected[i].Denominator() == (short) expected[i].Denominator())
+                  Assert::IsTrue(actual[i] == expected[i]);
+            }
+
+      Rint r(6, 35);
+      r *= Rint(-14, 9);
+      Assert::IsTrue(r == Rint(-4, 15));
+      r /= Rint(-8, 25);
+      Assert::IsTrue(r == Rint(5, 6));
+      r += Rint(1, 6);
+      Assert::IsTrue(r == Rint(1));
+      r -= Rint(7, 12);
+      Assert::IsTrue(r == Rint(5, 12));
+      r -= r;
+      Assert::IsTrue(r == Rint(0) && r.Denominator() == 1);
+      r = Rint(3, 4);
+      r *= r;
+      Assert::IsTrue(r == Rint(9, 16));
+      r /= r;
+      Assert::IsTrue(r == Rint(1));
+    }
+
+    TEST_METHOD(Checked)
+    {
+      typedef CheckedRational<short, OverflowPolicy::Flag> Cshort;
+      typedef CheckedRational<int> Cint;
+      typedef CheckedRational<long long, OverflowPolicy::Flag> CLL;
+
+      // No overflow: same results as Rational, no flag
+      Cshort s1(2, 4), s2(-2, 16);
+      Assert::IsTrue((s1 + s2).Value() == Rshort(3, 8) && !(s1 + s2).Overflowed());
+      Assert::IsTrue((s1 - s2).Value() == Rshort(5, 8));
+      Assert::IsTrue((s1 * s2).Value() == Rshort(-1, 16));
+      Assert::IsTrue((s1 / s2).Value() == Rshort(-4));
+      Assert::IsTrue(s2 < s1 && !(s1 * s2).Overflowed());
+
+      // Overflow is flagged, the value is the one Rational gives, and the
+      // flag carries over
+      Cshort big(SHRT_MAX);
+      Cshort sum = big + Cshort(1);
+      Assert::IsTrue(sum.Overflowed() && sum.Value() == Rshort(1) + (short) SHRT_MAX);
+      Assert::IsTrue((sum * Cshort(0)).Overflowed());
+      Assert::IsTrue((Cshort(1, SHRT_MAX) * Cshort(1, 2)).Overflowed());
+      Assert::IsTrue(!(Cshort(SHRT_MAX, 2) * Cshort(2, 3)).Overflowed());
+      Assert::IsTrue((Cshort(1, 3) / Cshort(0)).Overflowed());
+      Assert::IsTrue((-Cshort((short) SHRT_MIN)).Overflowed());
+      Assert::IsTrue(Cshort((short) SHRT_MIN, -1).Overflowed());
+      Assert::IsTrue(!Cshort((short) SHRT_MIN, -2).Overflowed());
+
+      // A denominator of 0 is reported
+      Assert::IsTrue(Cshort(1, 0).Overflowed() && Cshort(1, 0).Denominator() == 0);
+      int failures = 0;
+      try {
+        Cint(1, 0);
+      }
+      catch (const overflow_error&) {
+        ++failures;
+      }
+      Assert::AreEqual(1, failures);
+
+      // Negative GCDs leave the denominator positive
+      typedef CheckedRational<signed char, OverflowPolicy::Flag> Cschar;
+      Cschar product = Cschar(-2, 3) * Cschar(3, 4);
+      Assert::IsTrue(product.Value() == Rational<signed char>(-1, 2) && product.Denominator() == 2);
+      Cschar difference = Cschar(1, 6) + Cschar(-1, 3);
+      Assert::IsTrue(difference.Value() == Rational<signed char>(-1, 6) && difference.Denominator() == 6);
+      Assert::IsTrue(Cschar(6, -4).Denominator() == 2 && !difference.Overflowed());
+
+      // Intermediate products that cancel are not overflow
+      Assert::IsTrue(!(Cshort(20001, 2) + Cshort(-30001, 3)).Overflowed());
+      Assert::IsTrue((Cshort(20001, 2) + Cshort(-30001, 3)).Value() == Rshort(1, 6));
+
+      // Throwing policy
+      bool thrown = false;
+      try {
+        Cint(INT_MAX) + Cint(INT_MAX);
+      }
+      catch (const overflow_error&) {
+        thrown = true;
+      }
+      Assert::IsTrue(thrown);
+      Assert::IsTrue((Cint(INT_MAX, 2) + Cint(1, 2)).Value() == Rint(INT_MAX / 2 + 1));
+
+      CLL l(LLONG_MAX, 3);
+      Assert::IsTrue(!(l * CLL(3, LLONG_MAX)).Overflowed());
+      Assert::IsTrue((l * CLL(4)).Overflowed());
+      Assert::IsTrue(!(l - l).Overflowed() && (l - l).Value() == RLL(0));
+    }
+
+    TEST_METHOD(Big)
+    {
+      // Inline values and spilled values compare and print the same way
+      BigInt a("123456789012345678901234567890"), b(LLONG_MAX);
+      Assert::IsTrue(b.FitsInline() && !a.FitsInline());
+      Assert::IsTrue((b + 1).ToString() == "9223372036854775808");
+      Assert::IsTrue(((b + 1) - 1).FitsInline());
+      Assert::IsTrue(a * a / a == a && a * a % a == 0);
+      Assert::IsTrue(-a / BigInt(1000000007) == BigInt("-123456788148148161864"));
+      Assert::IsTrue(-a % BigInt(1000000007) == BigInt(-197434842));
+      Assert::IsTrue(-BigInt(LLONG_MIN) == BigInt(LLONG_MAX) + 1);
+      Assert::IsTrue(-a < BigInt(LLONG_MIN) && BigInt(LLONG_MIN) < a);
+
+      // The Rational operators work on BigRational unchanged
+      BigRational h;
+      for (int i = 1; i <= 30; ++i)
+        h += BigRational(1, i);
+      Assert::IsTrue(h == BigRational(BigInt("9304682830147"), BigInt("2329089562800")));
+      Assert::IsTrue(h - h == 0 && h / h == 1);
+      Assert::IsTrue(BigRational(1, 3) < BigRational(1, 2) && h > 3 && h < 4);
+      Assert::IsTrue(Rint(1, 2) + BigRational(1, 3) == BigRational(5, 6));
+      Assert::IsTrue(2 * BigRational(1, 6) == Rint(1, 3));
+
+      // No overflow where Rational<long long> would
+      BigRational big(LLONG_MAX, 3);
+      Assert::IsTrue((big * big).Numerator() == BigInt(LLONG_MAX) * BigInt(LLONG_MAX));
+      Assert::IsTrue((big * big) / big == big);
+
+      stringstream ss;
+      ss << h;
+      BigRational in;
+      ss >> in;
+      Assert::IsTrue(in == h);
+    }
+
+    TEST_METHOD(ConstantExpressions)
+    {
+      using namespace RationalLiterals;
+      static_assert(Rint(1, 3) * Rint(3, 7) == Rint(1, 7), "folded product");
+      static_assert(Rint(2, -8).Numerator() == -1 && Rint(2, -8).Denominator() == 4, "folded Simplify");
+      static_assert(Rshort(1, 2) + Rshort(1, 3) == Rshort(5, 6), "folded sum");
+      static_assert(RLL(1, 2) - RLL(1, 3) > RLL(0), "folded comparison");
+      static_assert(3_r / 4 == Rint(3, 4), "literal");
+      static_assert(1_rll / 3 + 2_rll / 3 == 1, "literal sum");
+      static_assert(::Gcd(48, 18) == 6 && EuclidGcd(48, 18) == 6, "folded GCD");
+
+      constexpr Rint table[] = { 1_r / 2, 1_r / 3 * (3_r / 7), -(5_r / 10) };
+      Assert::IsTrue(table[0] == Rint(1, 2) && table[1] == Rint(1, 7) && table[2] == Rint(-1, 2));
+      constexpr Rint folded = table[0] + table[2];
+      Assert::IsTrue(folded == 0);
+    }
+
+    TEST_METHOD(Vector)
+    {
+      // The batched kernels give what the scalar operators give
+      vector<Rshort> a, b;
+      for (short i = -20; i <= 20; ++i) {
+        a.push_back(Rshort(i, short(i * i % 17 + 1)));
+        b.push_back(Rshort(short(i * 7 % 13), short(i % 5 + 6)));
+      }
+      RationalVector<short> va(a.begin(), a.end()), vb(b.begin(), b.end());
+      RationalVector<short> sum = va + vb, diff = va - vb, prod = va * vb;
+      vector<int> cmp(a.size());
+      Compare(va, vb, cmp.data());
+      for (size_t i = 0; i < a.size(); ++i) {
+        Assert::IsTrue(sum[i] == a[i] + b[i]);
+        Assert::IsTrue(diff[i] == a[i] - b[i]);
+        Assert::IsTrue(prod[i] == a[i] * b[i]);
+        Assert::IsTrue(cmp[i] == ::Compare(a[i], b[i]));
+        if (b[i] != 0)
+          Assert::IsTrue((RationalVector<short>(1, a[i]) / RationalVector<short>(1, b[i]))[0] == a[i] / b[i]);
+      }
+      Assert::IsTrue(sum.Denominators()[0] > 0 && (va - va)[3] == 0 && (va - va).Denominators()[3] == 1);
+
+      // More elements than one block
+      RationalVector<int> ones(1000, Rint(1, 3));
+      ones += ones;
+      Assert::IsTrue(ones[999] == Rint(2, 3) && Sum(ones) == Rint(2000, 3));
+      Assert::IsTrue(Dot(ones, ones) == Rint(4000, 9));
+
+      // Reductions past the headroom of the accumulator
+      RationalVector<short> terms;
+      Rshort sums, dots;
+      for (short i = 1; i < 600; ++i) {
+        Rshort r(short(i % 7 - 3), short(i % 4 + 1));
+        terms.PushBack(r);
+        sums += r;
+        dots += r * r;
+      }
+      Assert::IsTrue(Sum(terms) == sums && Dot(terms, terms) == dots);
+
+      // Unsigned sums whose unreduced numerator doesn't fit in NextType used
+      // to wrap. Only the blocks holding one go through the scalar operator.
+      Rational<unsigned> big(4294967295u, 4294967294u);
+      RationalVector<unsigned> vu(300, Rational<unsigned>(1, 2));
+      vu.Set(260, big);
+      vu += vu;
+      Assert::IsTrue(vu[0] == 1u && vu[260] == big + big && vu[299] == 1u);
+      Rational<unsigned short> top(65535, 65534), near(65533, 65534);
+      RationalVector<unsigned short> left(600, top), right(600, Rational<unsigned short>(1, 2));
+      right.Set(0, top);
+      right.Set(599, near);
+      left += right;
+      Assert::IsTrue(left[0] == Rational<unsigned short>(65535, 32767));
+      Assert::IsTrue(left[599] == Rational<unsigned short>(65534, 32767));
+      Assert::IsTrue(left[300] == Rational<unsigned short>(49151, 32767));
+
+      // No wider type, falls back to the scalar operators
+      RationalVector<BigInt> vbig = { BigRational(1, 2), BigRational(2, 3) };
+      vbig *= vbig;
+      Assert::IsTrue(vbig[1] == BigRational(4, 9) && Product(vbig) == BigRational(1, 9));
+
+      bool thrown = false;
+      try {
+        va += RationalVector<short>(1);
+      } catch (const invalid_argument&) {
+        thrown = true;
+      }
+      Assert::IsTrue(thrown);
+    }
+
+    TEST_METHOD(BatchGcd)
+    {
+      // The implementation selected for this CPU agrees with the scalar GCD,
+      // including zero operands, powers of two and the largest values
+      vector<uint32_t> u, v;
+      uint32_t edge[] = { 0, 1, 2, 3, 6, 1u << 31, 0x80000001u, 0xFFFFFFFFu, 0xFFFFFFFEu, 12345678 };
+      for (uint32_t a : edge)
+        for (uint32_t b : edge) {
+          u.push_back(a);
+          v.push_back(b);
+        }
+      uint32_t x = 12345;
+      for (int i = 0; i < 1000; ++i) {
+        x = x * 1103515245u + 12345u;
+        uint32_t common = (x >> 28) * (1u << (x & 7)) + 1;
+        u.push_back(x / common * common);
+        x = x * 1103515245u + 12345u;
+        v.push_back((x >> (x & 15)) / common * common);
+      }
+      vector<uint32_t> g(u.size()), portable(u.size());
+      SimdGcd::GcdBatch(u.data(), v.data(), g.data(), u.size());
+      SimdGcd::GcdBatchPortable(u.data(), v.data(), portable.data(), u.size());
+      for (size_t i = 0; i < u.size(); ++i) {
+        Assert::IsTrue(g[i] == EuclidGcd(u[i], v[i]));
+        Assert::IsTrue(portable[i] == g[i]);
+      }
+
+      // Normalization, with and without 32 bit magnitudes
+      long long n[] = { 0, -6, 6, 4, 1LL << 40, -(3LL << 33) };
+      long long d[] = { -5, -4, 9, -8, 3LL << 20, 1LL << 34 };
+      int outN[6], outD[6];
+      RationalKernels::Normalize(n, d, 4, outN, outD);
+      RationalKernels::Normalize(n + 4, d + 4, 2, outN + 4, outD + 4);
+      for (int i = 0; i < 6; ++i)
+        Assert::IsTrue(Rint(outN[i], outD[i]) == Rational<long long>(n[i], d[i]) &&
+                       outN[i] == Rint(outN[i], outD[i]).Numerator() && outD[i] > 0);
+    }
+
+    TEST_METHOD(Accumulator)
+    {
+      // Same results as reducing after every step
+      RationalAccumulator<int> acc;
+      Rint sum;
+      for (int i = 1; i <= 20; ++i) {
+        acc += Rint(1, i);
+        sum += Rint(1, i);
+        if (i % 3 == 0) {
+          acc -= Rint(i, 7);
+          sum -= Rint(i, 7);
+        }
+        Assert::IsTrue(acc == sum);
+      }
+      Assert::IsTrue(acc.Numerator() == sum.Numerator() && acc.Denominator() == sum.Denominator());
+
+      // Runs out of headroom and reduces on the way, many times
+      RationalAccumulator<short> accs;
+      Rshort sums;
+      for (short i = 0; i < 1000; ++i) {
+        accs += Rshort(short(i % 7 - 3), short(i % 4 + 1));
+        sums += Rshort(short(i % 7 - 3), short(i % 4 + 1));
+      }
+      Assert::IsTrue(sums == accs && Rshort(accs) == sums);
+
+      // Products added unreduced, also past the headroom
+      RationalAccumulator<short> dot;
+      Rshort dots;
+      for (short i = 1; i < 300; ++i) {
+        Rshort a(short(i % 9 - 4), short(i % 5 + 2)), b(short(i % 6 + 1), short(i % 4 + 3));
+        dot.AddProduct(a, b);
+        dots += a * b;
+      }
+      Assert::IsTrue(dot == dots);
+
+      // Shared denominators, and 0 is 0/1
+      RationalAccumulator<long long> accll(RLL(1, 3));
+      accll += RLL(2, 3);
+      accll -= RLL(1);
+      Assert::IsTrue(accll.Numerator() == 0 && accll.Denominator() == 1);
+
+      stringstream ss;
+      accll += RLL(4, 6);
+      ss << accll;
+      Assert::IsTrue(ss.str() == "2/3");
+
+      // Never out of headroom on BigRational
+      RationalAccumulator<BigInt> accbig;
+      BigRational sumbig;
+      for (int i = 1; i <= 30; ++i) {
+        BigRational a(i % 7 - 3, i), b(i, i % 4 + 1);
+        accbig += a;
+        accbig.AddProduct(a, b);
+        sumbig += a + a * b;
+        if (i % 5 == 0) {
+          accbig -= b;
+          accbig *= BigRational(i, 3);
+          sumbig = (sumbig - b) * BigRational(i, 3);
+        }
+      }
+      Assert::IsTrue(accbig == sumbig && BigRational(accbig) == sumbig);
+      Assert::IsTrue(accbig.Denominator() == sumbig.Denominator());
+    }
+
+    TEST_METHOD(Parallel)
+    {
+      // Exact, whatever the number of threads and however the chunks were
+      // shared out
+      vector<RLL> values;
+      for (int i = 0; i < 50000; ++i)
+        values.push_back(RLL(i % 201 - 100, i % 6 + 1));
+      RLL sum;
+      for (const RLL& r : values)
+        sum += r;
+      for (unsigned threads = 1; threads <= 8; threads *= 2) {
+        Assert::IsTrue(ParallelSum(values, threads) == sum);
+        Assert::IsTrue(ParallelSum(RationalVector<long long>(values.begin(), values.end()), threads) == sum);
+      }
+      Assert::IsTrue(ParallelSum(values) == sum);
+
+      vector<RLL> factors;
+      for (int i = 1; i <= 20000; ++i)
+        factors.push_back(RLL(i + 1, i));
+      Assert::IsTrue(ParallelProduct(factors, 4) == RLL(20001));
+      RationalVector<long long> column(values.begin(), values.end());
+      Assert::IsTrue(ParallelDot(values, values, 4) == Dot(column, column));
+      Assert::IsTrue(ParallelDot(column, column, 3) == Dot(column, column));
+      Assert::IsTrue(ParallelSum(vector<RLL>()) == 0 && ParallelProduct(vector<RLL>()) == 1);
+
+      // And on BigRational, past what any fixed width would hold
+      vector<BigRational> big, bigfactors;
+      for (int i = 0; i < 10000; ++i) {
+        big.push_back(BigRational(BigInt(LLONG_MAX) * (i % 201 - 100), i % 6 + 1));
+        bigfactors.push_back(BigRational(BigInt(LLONG_MAX) + i + 1, BigInt(LLONG_MAX) + i));
+      }
+      BigRational sumbig, dotbig;
+      for (const BigRational& r : big) {
+        sumbig += r;
+        dotbig += r * r;
+      }
+      Assert::IsTrue(ParallelSum(big, 4) == sumbig && ParallelDot(big, big, 3) == dotbig);
+      Assert::IsTrue(ParallelProduct(bigfactors, 4) ==
+                     BigRational(BigInt(LLONG_MAX) + 10000, BigInt(LLONG_MAX)));
+    }
+
+    TEST_METHOD(Chars)
+    {
+      // Round trip, the same text as operator<<
+      char buffer[RationalChars<long long>::MaxLength];
+      RLL values[] = { RLL(0), RLL(-3, 4), RLL(LLONG_MAX, 7), RLL(LLONG_MIN + 1, LLONG_MAX), RLL(100, 1) };
+      for (const RLL& r : values) {
+        ToCharsResult out = ToChars(buffer, buffer + sizeof buffer, r);
+        Assert::IsTrue(out.ec == errc());
+        stringstream ss;
+        ss << r;
+        Assert::IsTrue(string(buffer, out.ptr) == ss.str());
+        RLL parsed;
+        FromCharsResult in = FromChars(buffer, out.ptr, parsed);
+        Assert::IsTrue(in.ec == errc() && in.ptr == out.ptr && parsed == r);
+      }
+
+      // Reduced unless told the input already is, sign moved to the numerator
+      const char text[] = "6/-8 tail";
+      Rint r;
+      FromCharsResult in = FromChars(text, text + 9, r);
+      Assert::IsTrue(in.ec == errc() && in.ptr == text + 4 && r == Rint(-3, 4));
+      FromChars(text, text + 9, r, true);
+      Assert::IsTrue(r.Numerator() == -6 && r.Denominator() == 8);
+      Assert::IsTrue(FromChars(text, text + 1, r).ptr == text + 1 && r == 6);
+
+      // Errors leave the value unchanged
+      const char bad[] = "x -/2 40000/3 3/0 -5";
+      Rshort s(1, 2);
+      in = FromChars(bad, bad + 1, s);
+      Assert::IsTrue(in.ec == errc::invalid_argument && in.ptr == bad);
+      in = FromChars(bad + 2, bad + 5, s);
+      Assert::IsTrue(in.ec == errc::invalid_argument && in.ptr == bad + 2);
+      in = FromChars(bad + 6, bad + 13, s);
+      Assert::IsTrue(in.ec == errc::result_out_of_range && in.ptr == bad + 11);
+      in = FromChars(bad + 14, bad + 17, s);
+      Assert::IsTrue(in.ec == errc::invalid_argument && in.ptr == bad + 14 && s == Rshort(1, 2));
+      Rational<unsigned> u;
+      Assert::IsTrue(FromChars(bad + 18, bad + 20, u).ec == errc::invalid_argument);
+      Assert::IsTrue(ToChars(buffer, buffer + 3, RLL(-10, 3)).ec == errc::value_too_large);
+      Assert::IsTrue(ToChars(buffer, buffer + 4, RLL(-10, 3)).ec == errc::value_too_large);
+      Assert::IsTrue(ToChars(buffer, buffer + 5, RLL(-10, 3)).ec == errc());
+
+      // Bulk
+      const char csv[] = "1/2,3/4\n-5/10, 7\r\n0/3\n";
+      RationalVector<int> column;
+      in = FromChars(csv, csv + sizeof csv - 1, column);
+      Assert::IsTrue(in.ec == errc() && column.Size() == 5);
+      Assert::IsTrue(column[2] == Rint(-1, 2) && column[3] == 7 && column[4] == 0);
+      in = FromChars(bad, bad + sizeof bad - 1, column);
+      Assert::IsTrue(in.ec == errc::invalid_argument && in.ptr == bad && column.Size() == 5);
+    }
+
+    TEST_METHOD(ColumnFile)
+    {
+      RationalVector<long long> values;
+      for (int i = -500; i < 500; ++i)
+        values.PushBack(RLL(i * 977LL, 13 + (i & 15)));
+      values.PushBack(RLL(LLONG_MIN + 1, LLONG_MAX));
+      values.PushBack(RLL(LLONG_MIN));
+
+      // Both encodings decode to the same values, varint being smaller
+      stringstream fixed, varint;
+      WriteColumns(fixed, values);
+      WriteColumns(varint, values, RationalFormat::VarintEncoding);
+      string fixedBytes = fixed.str(), varintBytes = varint.str();
+      Assert::IsTrue(varintBytes.size() < fixedBytes.size() / 3);
+      RationalVector<long long> decoded = ReadColumns<long long>(fixedBytes.data(), fixedBytes.size());
+      RationalVector<long long> decodedVarint = ReadColumns<long long>(varintBytes.data(), varintBytes.size());
+      Assert::IsTrue(decoded.Size() == values.Size() && decodedVarint.Size() == values.Size());
+      for (size_t i = 0; i < values.Size(); ++i)
+        Assert::IsTrue(decoded[i] == values[i] && decodedVarint[i] == values[i]);
+
+      // Zero copy view of an aligned buffer, and of a mapped file
+      vector<long long> aligned(fixedBytes.size() / sizeof(long long));
+      memcpy(aligned.data(), fixedBytes.data(), fixedBytes.size());
+      RationalColumnView<long long> view(aligned.data(), fixedBytes.size());
+      Assert::IsTrue(view.Size() == values.Size() && view.Reduced() && view[1001] == RLL(LLONG_MIN));
+      Assert::IsTrue(view.Numerators() == (const long long*) aligned.data() + 4);
+
+      string path = "columnfile_test.ratc";
+      {
+        ofstream file(path.c_str(), ios::binary);
+        WriteColumns(file, values);
+      }
+      {
+        MappedRationalFile<long long> mapped(path);
+        Assert::IsTrue(mapped.Size() == values.Size());
+        for (size_t i = 0; i < values.Size(); ++i)
+          Assert::IsTrue(mapped[i] == values[i]);
+      }
+      remove(path.c_str());
+
+      // Unreduced input is reduced on access
+      short n[] = { 2, -3, 0, 5 }, d[] = { 4, -6, 7, 1 };
+      stringstream raw;
+      WriteColumns(raw, n, d, 4, false, RationalFormat::VarintEncoding);
+      RationalVector<short> shorts = ReadColumns<short>(raw.str().data(), raw.str().size());
+      Assert::IsTrue(shorts[0] == Rshort(1, 2) && shorts[1] == Rshort(1, 2) && shorts[2] == 0);
+
+      // Wrong type or truncated
+      int failures = 0;
+      try { ReadColumns<int>(fixedBytes.data(), fixedBytes.size()); } catch (const runtime_error&) { ++failures; }
+      try { ReadColumns<long long>(fixedBytes.data(), fixedBytes.size() - 1); } catch (const runtime_error&) { ++failures; }
+      try { RationalColumnView<long long>(varintBytes.data(), varintBytes.size()); } catch (const runtime_error&) { ++failures; }
+      Assert::IsTrue(failures == 3);
+
+      // Varints that overflow or aren't in their shortest form, and columns
+      // with bytes left over
+      short wide[] = { 64, SHRT_MAX }, ones[] = { 1, 1 };
+      stringstream two;
+      WriteColumns(two, wide, ones, 2, true, RationalFormat::VarintEncoding);
+      string good = two.str(), overlong = good, overflow = good, extra = good;
+      size_t column = RationalFormat::HeaderSize;
+      Assert::IsTrue(ReadColumns<short>(good.data(), good.size())[1] == SHRT_MAX);
+      overlong[column] = char(0x82);  // 1 in two bytes
+      overlong[column + 1] = 0;
+      overflow[column + 4] = 0x07;    // 2^16 + SHRT_MAX * 2
+      extra[8] = 1;                   // count
+      failures = 0;
+      try { ReadColumns<short>(overlong.data(), overlong.size()); } catch (const runtime_error&) { ++failures; }
+      try { ReadColumns<short>(overflow.data(), overflow.size()); } catch (const runtime_error&) { ++failures; }
+      try { ReadColumns<short>(extra.data(), extra.size()); } catch (const runtime_error&) { ++failures; }
+      Assert::AreEqual(3, failures);
+    }
+
+    TEST_METHOD(FromDouble)
+    {
+      // Exact: the mantissa and exponent of the double
+      Assert::IsTrue(Rint(0.5) == Rint(1, 2) && Rint(-0.375) == Rint(-3, 8) && Rint(0.0) == 0);
+      Assert::IsTrue(Rint(-2147483648.0) == Rint(INT_MIN) && Rint(1e9) == 1000000000);
+      Assert::IsTrue(RLL(0.1) == RLL(3602879701896397LL, 36028797018963968LL));
+      Assert::IsTrue(RLL(0.1f) == RLL(13421773, 134217728));
+      Assert::IsTrue(BigRational(1e300).Denominator() == 1 && BigRational(ldexp(3.0, -1070)) ==
+                     BigRational(BigInt(3), Pow2<BigInt>(1070)));
+      Assert::IsTrue((double) RLL(-1234.5678) == -1234.5678);
+
+      // Values that don't fit
+      int failures = 0;
+      try { Rint(0.1); } catch (const overflow_error&) { ++failures; }
+      try { Rint(2147483648.0); } catch (const overflow_error&) { ++failures; }
+      try { Rational<unsigned>(-1.0); } catch (const overflow_error&) { ++failures; }
+      try { RLL(numeric_limits<double>::quiet_NaN()); } catch (const domain_error&) { ++failures; }
+      try { RLL(-numeric_limits<double>::infinity()); } catch (const domain_error&) { ++failures; }
+      Assert::IsTrue(failures == 5);
+
+      // Best approximations
+      const double pi = 3.14159265358979323846;
+      Assert::IsTrue(BestApproximation(pi, 10) == Rint(22, 7));
+      Assert::IsTrue(BestApproximation(pi, 100) == Rint(311, 99));
+      Assert::IsTrue(BestApproximation(-pi, 1000) == Rint(-355, 113));
+      Assert::IsTrue(BestApproximation(0.1, 1000) == Rint(1, 10));
+      Assert::IsTrue(BestApproximation(0.1, 1LL << 60) == RLL(0.1));
+      Assert::IsTrue(BestApproximation(1e-30, 1000000) == 0 && BestApproximation(7.0, 3) == 7);
+      Assert::IsTrue(BestApproximation(0.99999, (short) 100) == Rshort(1));
+      Assert::IsTrue(BestApproximation(1.0 / 3, BigInt(1000)) == BigRational(1, 3));
+      failures = 0;
+      try { BestApproximation(0.5, 0); } catch (const invalid_argument&) { ++failures; }
+      try { BestApproximation(1e10, 5); } catch (const overflow_error&) { ++failures; }
+      Assert::IsTrue(failures == 2);
+    }
+
+    TEST_METHOD(FloatingPoint)
+    {
+      // Components beyond 2^53 are rounded once, not twice
+      Assert::IsTrue((double) RLL((1LL << 53) + 1, 3) == 3002399751580331.0);
+      Assert::IsTrue((double) RLL(LLONG_MAX, 3) == 3074457345618258602.0);
+      Assert::IsTrue((double) RLL((1LL << 53) + 1) == 9007199254740992.0);
+      Assert::IsTrue((double) RLL((1LL << 53) + 3) == 9007199254740996.0);
+      Assert::IsTrue((double) RLL(-((1LL << 54) + 3), 1LL << 55) == -(0.5 + ldexp(1.0, -53)));
+      Assert::IsTrue((float) RLL(LLONG_MAX - 1, LLONG_MAX) == 1.0f && (float) Rint(1, 3) == 1.0f / 3);
+      Assert::IsTrue((double) Rint(2, 3) == 2.0 / 3 && (double) RLL(0) == 0.0);
+
+      // Unsigned components above the signed range are exact in a double,
+      // and used to send the long division into an endless loop
+      Assert::IsTrue((double) Rational<unsigned>(3000000001u, 7) == 3000000001.0 / 7);
+      Assert::IsTrue((double) Rational<unsigned>(4294967295u, 4294967294u) == 4294967295.0 / 4294967294.0);
+      Assert::IsTrue((float) Rational<unsigned>(1, 4294967291u) == (float) (1.0 / 4294967291.0));
+      Assert::IsTrue((float) Rational<unsigned short>(1, 65535) == (float) (1.0 / 65535));
+      Assert::IsTrue((double) Rational<unsigned short>(65535, 32771) == 65535.0 / 32771);
+      RationalVector<unsigned> high;
+      for (unsigned i = 0; i < 300; ++i)
+        high.PushBack(Rational<unsigned>(4294967295u - 2 * i, 2147483649u + i));
+      vector<double> highs(high.Size());
+      ::ToDouble(high, highs.data());
+      for (size_t i = 0; i < high.Size(); ++i)
+        Assert::IsTrue(highs[i] == (double) high.Numerators()[i] / high.Denominators()[i]);
+
+      // Batched, the same values as the scalar conversion
+      RationalVector<long long> values;
+      unsigned long long u = 1;
+      for (int i = 0; i < 300; ++i) {
+        u = u * 6364136223846793005ULL + 1442695040888963407ULL;
+        long long x = (long long) u;
+        values.PushBack(RLL(x >> (i % 60), (x >> 40 | 1) << (i % 23)));
+      }
+      vector<double> doubles(values.Size());
+      vector<float> floats(values.Size());
+      ::ToDouble(values, doubles.data());
+      ::ToFloat(values, floats.data());
+      for (size_t i = 0; i < values.Size(); ++i)
+        Assert::IsTrue(doubles[i] == (double) values[i] && floats[i] == (float) values[i]);
+    }
+
+    TEST_METHOD(Counters)
+    {
+      using namespace RationalCounters;
+      Counts before = Collect();
+      Rint a(6, 4), b(3, 5);
+      bool less = a < b;
+      Rational<short> narrowed = Rint(100000, 3);
+      thread([]() { Rint c(10, 4); }).join();
+      Counts after = Collect();
+      Assert::IsFalse(less || narrowed == Rshort(0));
+
+      if (!Enabled) {
+        for (int c = 0; c < CounterCount; ++c)
+          Assert::IsTrue(after[Counter(c)] == 0);
+        return;
+      }
+      // Three from this thread, one from the thread that has exited
+      Assert::IsTrue(after[Simplifications] - before[Simplifications] == 4);
+      Assert::IsTrue(after[GcdIterations] > before[GcdIterations]);
+      Assert::IsTrue(after[TrivialReductions] - before[TrivialReductions] == 2);
+      Assert::IsTrue(after[LossyNarrowings] - before[LossyNarrowings] == 1);
+      Assert::IsTrue(after[Comparisons] - before[Comparisons] == 1);
+
+      Reset();
+      Assert::IsTrue(Collect()[Simplifications] == 0);
+    }
+
+    TEST_METHOD(IntegerOperands)
+    {
+      Assert::IsTrue(Rint(3, 4) + 2 == Rint(11, 4) && 2 - Rint(3, 4) == Rint(5, 4));
+      Assert::IsTrue(Rint(3, 4) * 6 == Rint(9, 2) && Rint(3, 4) * -4 == Rint(-3));
+      Assert::IsTrue(Rint(3, 4) / 6 == Rint(1, 8) && Rint(3, 4) / -3 == Rint(-1, 4));
+      Assert::IsTrue(6 / Rint(-4, 3) == Rint(-9, 2) && Rint(3, 4) * 0 == 0 && Rint(0) / 5 == 0);
+      Rint r(5, 6);
+      r += 1; r -= 3; r *= 3; r /= 7;
+      Assert::IsTrue(r == Rint(-1, 2));
+      Assert::IsTrue(Rint(1, 6) + Rint(1, 6) == Rint(1, 3) && Rint(1, 6) - Rint(1, 6) == 0);
+
+      // Against the products computed in long long, for integer, unit and
+      // shared denominators on either side
+      for (int a = -12; a <= 12; ++a)
+        for (int b = 1; b <= 6; ++b)
+          for (int c = -12; c <= 12; ++c)
+            for (int d : { 1, b, 5 }) {
+              Rint x(a, b), y(c, d);
+              long long n1 = x.Numerator(), d1 = x.Denominator();
+              long long n2 = y.Numerator(), d2 = y.Denominator();
+              Assert::IsTrue(x + y == Rint(RLL(n1 * d2 + n2 * d1, d1 * d2)));
+              Assert::IsTrue(x - y == Rint(RLL(n1 * d2 - n2 * d1, d1 * d2)));
+              Assert::IsTrue(x * y == Rint(RLL(n1 * n2, d1 * d2)));
+              if (c != 0)
+                Assert::IsTrue(x / y == Rint(RLL(n1 * d2, d1 * n2)));
+              Assert::IsTrue(x + c == x + y * d && x * c == x * (y * d));
+            }
+    }
+
+    TEST_METHOD(Hash)
+    {
+      hash<Rint> h;
+      Assert::IsTrue(h(Rint(2, 4)) == h(Rint(-3, -6)) && h(Rint(1, 2)) != h(Rint(2, 1)));
+      Assert::IsTrue(h(Rint(1, 2)) != h(Rint(-1, 2)) && hash<RLL>()(RLL(0)) == hash<RLL>()(RLL(0, 7)));
+      unordered_set<Rint> seen;
+      for (int n = -50; n <= 50; ++n)
+        for (int d = 1; d <= 50; ++d)
+          seen.insert(Rint(n, d));
+      Assert::IsTrue(seen.size() == 3095);
+
+      // Group by, growing from empty
+      RationalHashMap<int, int> counts;
+      for (int n = -50; n <= 50; ++n)
+        for (int d = 1; d <= 50; ++d)
+          ++counts[Rint(n, d)];
+      Assert::IsTrue(counts.Size() == seen.size() && *counts.Find(Rint(0)) == 50);
+      Assert::IsTrue(*counts.Find(Rint(1, 2)) == 25 && counts.Find(Rint(1, 51)) == 0);
+      size_t total = 0;
+      counts.ForEach([&total](const Rint&, int count) { total += count; });
+      Assert::IsTrue(total == 101 * 50);
+
+      // Erase every other key, the rest must still be found
+      RationalHashSet<long long> set;
+      for (long long i = 0; i < 5000; ++i)
+        Assert::IsTrue(set.Insert(RLL(i, 7)) && !set.Insert(RLL(2 * i, 14)));
+      for (long long i = 0; i < 5000; i += 2)
+        Assert::IsTrue(set.Erase(RLL(i, 7)));
+      Assert::IsTrue(set.Size() == 2500 && !set.Erase(RLL(0)));
+      for (long long i = 0; i < 5000; ++i)
+        Assert::IsTrue(set.Contains(RLL(i, 7)) == (i % 2 == 1));
+      Assert::IsTrue(counts.Insert(Rint(1, 2), 7) == make_pair(counts.Find(Rint(1, 2)), false));
+      Assert::IsTrue(*counts.Insert(Rint(7, 3), 7).first == 7 && counts.Erase(Rint(7, 3)));
+
+      // Keys with a denominator of 0 would read as empty slots
+      int failures = 0;
+      size_t before = counts.Size();
+      try { counts.Insert(Rint(1, 0), 1); } catch (const invalid_argument&) { ++failures; }
+      try { set.Insert(RLL(1) / RLL(0)); } catch (const invalid_argument&) { ++failures; }
+      Assert::AreEqual(2, failures);
+      Assert::IsTrue(counts.Size() == before && counts.Find(Rint(1, 0)) == 0 && set.Size() == 2500);
+
+      // BigRational keys, inline and spilled
+      BigInt huge("123456789012345678901234567890");
+      Assert::IsTrue(hash<BigInt>()(huge * 3 / 3) == hash<BigInt>()(huge));
+      Assert::IsTrue(hash<BigRational>()(BigRational(2, 4)) == hash<BigRational>()(BigRational(1, 2)));
+      RationalHashMap<BigInt, int> bigs;
+      for (int i = 1; i <= 100; ++i) {
+        bigs.Insert(BigRational(huge, BigInt(i)), i);
+        bigs.Insert(BigRational(i, 7), -i);
+      }
+      Assert::IsTrue(bigs.Size() == 200 && *bigs.Find(BigRational(huge, BigInt(40))) == 40);
+      Assert::IsTrue(*bigs.Find(BigRational(14, 49)) == -2 && bigs.Find(BigRational(huge + 1)) == 0);
+    }
+
+    TEST_METHOD(FusedExpressions)
+    {
+      Rint a(1, 2), b(2, 3), c(3, 4), d(5, 6), e(7, 8);
+      Rint x = Lazy(a) * b + Lazy(c) * d - e;
+      Assert::IsTrue(x == a * b + c * d - e && x == Rint(1, 12));
+      Assert::IsTrue(Evaluate(-(Lazy(a) / b) + 3 * Lazy(c) - 2) == Rint(-1, 2));
+      Assert::IsTrue(Evaluate(Lazy(RLL(1, 3)) + a) == RLL(5, 6));
+
+      // Against the Rational operators, also where the unreduced values
+      // overflow and for division by zero
+      long long state = 12345;
+      for (int i = 0; i < 2000; ++i) {
+        Rint v[4];
+        for (Rint& r : v) {
+          state = (long long) ((unsigned long long) state * 6364136223846793005ULL + 1);
+          int range = i % 2 ? 1 << 30 : 20;
+          r = Rint(int(state >> 33) % range, int(state >> 13 & 0xFFFFF) % range + 1);
+        }
+        Assert::IsTrue((Rint) (Lazy(v[0]) * v[1] + v[2] / Lazy(v[3])) == v[0] * v[1] + v[2] / v[3]);
+        Assert::IsTrue((Rint) (Lazy(v[0]) - v[1] - v[2] * (v[3] + Lazy(v[0]))) ==
+                       v[0] - v[1] - v[2] * (v[3] + v[0]));
+      }
+      Rint zero;
+      Assert::IsTrue((Rint) (Lazy(a) / zero + b) == a / zero + b);
+
+      BigRational p(BigInt(1), BigInt(3)), q = Lazy(p) * p - p / Lazy(p);
+      Assert::IsTrue(q == p * p - p / p && q == BigRational(BigInt(-8), BigInt(9)));
+
+      // One reduction for the whole expression
+      RationalCounters::Counts before = RationalCounters::Collect();
+      x = Lazy(a) * b + Lazy(c) * d - e;
+      RationalCounters::Counts after = RationalCounters::Collect();
+      Assert::IsTrue(!RationalCounters::Enabled ||
+        after[RationalCounters::Simplifications] - before[RationalCounters::Simplifications] == 1);
+    }
+
+    TEST_METHOD(LinearSolve)
+    {
+      RationalMatrix<int> a = {
+        { Rint(2), Rint(1, 2), Rint(-1) },
+        { Rint(0), Rint(0), Rint(3, 4) },
+        { Rint(1, 3), Rint(5), Rint(2) } };
+      vector<Rint> b = { Rint(1), Rint(-2, 3), Rint(7, 5) };
+      vector<Rint> x = Solve(a, b);
+      Assert::IsTrue(a * x == b);
+      // The zero pivot swaps the last two rows
+      Assert::IsTrue(Determinant(a) == Rint(-59, 8));
+      Assert::IsTrue(Determinant(RationalMatrix<int>::Identity(4)) == 1);
+      Assert::IsTrue(RationalMatrix<int>::Identity(3) * a == a);
+      // For types narrower than int, the sign is flipped in the work type
+      typedef Rational<signed char> Rschar;
+      RationalMatrix<signed char> swapped = { { Rschar(0), Rschar(1, 2) }, { Rschar(3), Rschar(1) } };
+      Assert::IsTrue(Determinant(swapped) == Rschar(-3, 2));
+
+      RationalMatrix<int> singular = { { Rint(1), Rint(2) }, { Rint(1, 2), Rint(1) } };
+      Assert::IsTrue(Determinant(singular) == 0);
+      int failures = 0;
+      try { Solve(singular, vector<Rint>(2)); } catch (const domain_error&) { ++failures; }
+      try { Solve(a, vector<Rint>(2)); } catch (const invalid_argument&) { ++failures; }
+
+      // The minors of the scaled Hilbert matrix overflow 128 bits, so this
+      // runs in BigInt. The first column of its inverse: 64, -2016, ...
+      const int n = 8;
+      RationalMatrix<long long> h(n, n);
+      for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+          h(i, j) = RLL(1, i + j + 1);
+      vector<RLL> e(n);
+      e[0] = 1;
+      vector<RLL> column = Solve(h, e);
+      Assert::IsTrue(h * column == e);
+      Assert::IsTrue(column[0] == 64 && column[1] == -2016);
+      // Its determinant is about 1/(2.7 * 10^33)
+      try { Determinant(h); } catch (const overflow_error&) { ++failures; }
+      Assert::AreEqual(3, failures);
+
+      // A minor that is the minimum of the work type over a pivot of -1
+      // doesn't fit there (and would trap), so this runs in BigInt
+      RationalMatrix<int> corner = { { Rint(-1), Rint(INT_MIN), Rint(0) },
+                                     { Rint(INT_MIN), Rint(0), Rint(0) },
+                                     { Rint(0), Rint(0), Rint(-2) } };
+      vector<Rint> unit = Solve(corner, vector<Rint>{ Rint(INT_MIN), Rint(0), Rint(0) });
+      Assert::IsTrue(unit[0] == 0 && unit[1] == 1 && unit[2] == 0);
+      failures = 0;
+      try { Determinant(corner); } catch (const overflow_error&) { ++failures; }
+      try { Solve(corner, vector<Rint>(3, Rint(1))); } catch (const overflow_error&) { ++failures; }
+      Assert::AreEqual(2, failures);
+    }
+
+    TEST_METHOD(Atomic)
+    {
+      AtomicRational<int> a(Rint(1, 2));
+      Assert::IsTrue(a.IsLockFree());
+      Assert::IsTrue(a.FetchAdd(Rint(1, 3)) == Rint(1, 2) && a.Load() == Rint(5, 6));
+      Assert::IsTrue((a -= Rint(1, 3)) == Rint(1, 2));
+      Assert::IsTrue(a.Exchange(Rint(3)) == Rint(1, 2) && a.Load() == 3);
+      Rint expected(2);
+      Assert::IsFalse(a.CompareExchange(expected, Rint(7)));
+      Assert::IsTrue(expected == 3 && a.CompareExchange(expected, Rint(7)) && a.Load() == 7);
+
+      // An unreduced sum over an equal denominator, then another denominator
+      AtomicRational<short> b(Rshort(1, 181));
+      b.Add(Rshort(180, 181));
+      b.Add(Rshort(1, 200));
+      Assert::IsTrue(b.Load() == Rshort(201, 200));
+
+      // Contended: the shares add up exactly, whether or not they were
+      // stored reduced
+      const int threads = 8, adds = 20000;
+      AtomicRational<int> total;
+      ShardedRational<int> sharded;
+      vector<thread> pool;
+      for (int t = 0; t < threads; ++t)
+        pool.push_back(thread([&, t]() {
+          Rint share(1, t % 2 ? 12 : 8);
+          for (int i = 0; i < adds; ++i) {
+            total.FetchAdd(share);
+            sharded += share;
+          }
+        }));
+      for (thread& t : pool)
+        t.join();
+      Rint sum = Rint(threads / 2 * adds, 12) + Rint(threads / 2 * adds, 8);
+      Assert::IsTrue(total.Load() == sum && sharded.Load() == sum);
+      Rint value = total;
+      Assert::IsTrue(value.Numerator() == 50000 && value.Denominator() == 3);
+
+      expected = sum;
+      Assert::IsTrue(total.CompareExchange(expected, Rint(0)) && total.Load() == 0);
+      sharded.Store(Rint(1, 3));
+      sharded -= Rint(1, 2);
+      Assert::IsTrue(sharded.Load() == Rint(-1, 6));
+    }
+
+    TEST_METHOD(IntegerParts)
+    {
+      Rint a(-7, 2), b(7, 3);
+      Assert::AreEqual(-4, Floor(a));
+      Assert::AreEqual(-3, Ceil(a));
+      Assert::AreEqual(-3, Trunc(a));
+      Assert::AreEqual(-4, Round(a));
+      Assert::AreEqual(-3, Round(a, RoundHalfUp));
+      Assert::AreEqual(-4, Round(a, RoundHalfAwayFromZero));
+      Assert::AreEqual(-3, Round(a, RoundHalfTowardZero));
+      Assert::AreEqual(2, Round(Rint(5, 2)));
+      Assert::AreEqual(3, Round(Rint(5, 2), RoundHalfUp));
+      Assert::AreEqual(2, Round(b, RoundHalfUp));
+      Assert::AreEqual(3, Round(b, RoundAwayFromZero));
+      Assert::IsTrue(Frac(a) == Rint(-1, 2) && Frac(b) == Rint(1, 3) && Frac(Rint(4)) == 0);
+      Assert::AreEqual(1, Frac(Rint(4)).Denominator());
+
+      // (-7/2) / (7/3) = -1.5, truncated to -1 with -7/2 + 7/3 left
+      RationalDivision<int> division = DivMod(a, b);
+      Assert::IsTrue(division.quotient == -1 && division.remainder == Rint(-7, 6));
+      Assert::IsTrue(a % b == Rint(-7, 6) && b % a == b && a % -b == Rint(-7, 6));
+      Assert::IsTrue(Rint(7) % 3 == 1 && 7 % Rint(3, 2) == 1 && Rint(-7) % 3 == -7 % 3);
+      Assert::IsTrue(RLL(17, 4) % Rint(1, 3) == RLL(1, 4));
+      // The minimum by -1: the quotient doesn't fit, the remainder 0 does
+      Assert::IsTrue(Rint(INT_MIN) % Rint(-1) == 0 && Rint(INT_MIN) % -1 == 0);
+      Assert::IsTrue(DivMod(RLL(LLONG_MIN), RLL(-1)).remainder == 0 && DivMod(Rint(5), Rint(-1)).quotient == -5);
+      int failures = 0;
+      try { DivMod(a, Rint(0)); } catch (const domain_error&) { ++failures; }
+      Assert::AreEqual(1, failures);
+
+      // Against their definitions, and the batched versions against the
+      // scalar ones
+      const RoundingMode modes[] = {
+        RoundDown, RoundUp, RoundTowardZero, RoundAwayFromZero, RoundHalfEven,
+        RoundHalfUp, RoundHalfDown, RoundHalfAwayFromZero, RoundHalfTowardZero };
+      RationalVector<int> values;
+      vector<Rint> scalars;
+      for (int n = -40; n <= 40; ++n)
+        for (int d = 1; d <= 8; ++d) {
+          Rint r(n, d);
+          values.PushBack(r);
+          scalars.push_back(r);
+          Assert::IsTrue(Floor(r) <= r && r < Floor(r) + 1 && Ceil(r) - 1 < r && r <= Ceil(r));
+          Assert::IsTrue(Trunc(r) + Frac(r) == r && Frac(r) * r >= 0);
+          Rint half = r - Floor(r) - Rint(1, 2);
+          int nearest = half < 0 ? Floor(r) : half > 0 ? Ceil(r) : Floor(r) % 2 == 0 ? Floor(r) : Ceil(r);
+          Assert::AreEqual(nearest, Round(r));
+          for (int m = -3; m <= 3; ++m) {
+            if (m == 0)
+              continue;
+            Rint divisor(m, 3);
+            RationalDivision<int> qr = DivMod(r, divisor);
+            Assert::IsTrue(qr.quotient == Trunc(r / divisor) &&
+                           qr.quotient * divisor + qr.remainder == r);
+          }
+        }
+      values.PushBack(Rint(INT_MAX, 3));
+      values.PushBack(Rint(INT_MIN + 1, 7));
+      scalars.push_back(Rint(INT_MAX, 3));
+      scalars.push_back(Rint(INT_MIN + 1, 7));
+      vector<int> out(values.Size());
+      Floor(values, out.data());
+      for (size_t i = 0; i < out.size(); ++i)
+        Assert::AreEqual(Floor(scalars[i]), out[i]);
+      Ceil(values, out.data());
+      for (size_t i = 0; i < out.size(); ++i)
+        Assert::AreEqual(Ceil(scalars[i]), out[i]);
+      Trunc(values, out.data());
+      for (size_t i = 0; i < out.size(); ++i)
+        Assert::AreEqual(Trunc(scalars[i]), out[i]);
+      for (RoundingMode mode : modes) {
+        Round(values, out.data(), mode);
+        for (size_t i = 0; i < out.size(); ++i)
+          Assert::AreEqual(Round(scalars[i], mode), out[i]);
+      }
+      RationalVector<int> fracs = Frac(values);
+      for (size_t i = 0; i < out.size(); ++i)
+        Assert::IsTrue(fracs[i].Numerator() == Frac(scalars[i]).Numerator() &&
+                       fracs[i].Denominator() == Frac(scalars[i]).Denominator());
+
+      RationalVector<long long> wide = { RLL(-9, 4), RLL(LLONG_MAX, 2) };
+      vector<long long> wideOut(2);
+      Round(wide, wideOut.data());
+      Assert::IsTrue(wideOut[0] == -2 && wideOut[1] == LLONG_MAX / 2 + 1);
+      Assert::AreEqual(7u, Floor(Rational<unsigned>(15, 2)));
+      Assert::AreEqual(8u, Round(Rational<unsigned>(15, 2)));
+    }
+
+    TEST_METHOD(GcdTable)
+    {
+#ifdef RATIONAL_HAS_GCD_TABLE
+      typedef GcdTraits::Lookup<GcdTraits::Binary> Lookup;
+      static_assert(Lookup::Gcd(48, 18) == 6 && Lookup::Gcd(255, 0) == 255 &&
+                    Lookup::Gcd(0, 0) == 0, "table built at compile time");
+      // The whole table, its edge and the fallback beyond it, with signs
+      for (int a = -300; a <= 300; ++a)
+        for (int b = -300; b <= 300; ++b) {
+          int g = Lookup::Gcd(a, b);
+          Assert::IsTrue(g == BinaryGcd(a, b));
+          Assert::IsTrue(Lookup::Gcd((short) a, (short) b) == (short) g);
+        }
+      Assert::IsTrue(Lookup::Gcd(INT_MIN, 6) == 2 && Lookup::Gcd(-255LL, 85LL) == 85);
+      Assert::IsTrue(Lookup::Gcd((unsigned char) 200, (unsigned char) 150) == 50);
+      Assert::IsTrue(Rshort(-96, 36) == Rshort(-8, 3));
+#endif
+    }
+
+    TEST_METHOD(RawBuffers)
+    {
+      static_assert(is_trivially_copyable<Rint>::value && is_standard_layout<RLL>::value &&
+                    sizeof(Rint) == 2 * sizeof(int), "Rational is a pair");
+      static_assert(Rint::FromReducedUnchecked(3, 4).Denominator() == 4, "constant");
+      Rint unchecked = Rint::FromReducedUnchecked(-3, 4);
+      Assert::IsTrue(unchecked == Rint(-3, 4));
+
+      // memcpy both ways
+      Rint values[3] = { Rint(1, 2), Rint(-2, 3), Rint(5) };
+      int32_t raw[6];
+      memcpy(raw, values, sizeof(values));
+      Assert::IsTrue(raw[0] == 1 && raw[1] == 2 && raw[2] == -2 && raw[3] == 3 && raw[5] == 1);
+      Rint copies[3];
+      memcpy(copies, raw, sizeof(raw));
+      Assert::IsTrue(copies[1] == Rint(-2, 3));
+
+      // Views of the pairs in place, reading and writing
+      RationalSpan<Rint> view = AsRationals(raw, 3);
+      Assert::IsTrue(view.Size() == 3 && view[0] == Rint(1, 2) && view[2] == 5);
+      view[1] += Rint(1, 6);
+      Assert::IsTrue(raw[2] == -1 && raw[3] == 2);
+      Rint sum;
+      for (const Rint& r : view)
+        sum += r;
+      Assert::IsTrue(sum == 5);
+      RationalSpan<const Rint> constant = view.Subspan(1, 2);
+      Assert::IsTrue(constant.Size() == 2 && constant[1] == 5 && Pairs(constant) == raw + 2);
+      const int32_t* readOnly = raw;
+      Assert::IsTrue(AsRationals(readOnly, 3)[0] == Rint(1, 2) && Pairs(view) == raw);
+
+      // Nothing is simplified
+      RationalCounters::Counts before = RationalCounters::Collect();
+      Rint trusted = Rint::FromReducedUnchecked(7, 9);
+      RationalCounters::Counts after = RationalCounters::Collect();
+      Assert::IsTrue(trusted == Rint(7, 9) &&
+        after[RationalCounters::Simplifications] == before[RationalCounters::Simplifications]);
+    }
+
+    TEST_METHOD(MixedWidth)
+    {
+      // Mixed operands against converting the narrower one first
+      short shorts[] = { 0, 1, -1, 2, -3, 6, 12, -15, 120, -128, 181, SHRT_MAX, -SHRT_MAX };
+      int ints[] = { 0, 1, -1, 3, -4, 8, 36, -45, 1000, 65536, -65535, INT_MAX, -INT_MAX };
+      for (short n1 : shorts)
+        for (short d1 : shorts)
+          for (int n2 : ints)
+            for (int d2 : ints) {
+              if (d1 == 0 || d2 == 0)
+                continue;
+              Rshort a(n1, d1);
+              RLL b(n2, d2);
+              Rint c(n2, d2), wide = a;
+              Assert::IsTrue(a + c == wide + c && c + a == c + wide);
+              Assert::IsTrue(a - c == wide - c && c - a == c - wide);
+              Assert::IsTrue(a * c == wide * c && c * a == c * wide);
+              if (c != 0)
+                Assert::IsTrue(a / c == wide / c);
+              if (a != 0)
+                Assert::IsTrue(c / a == c / wide);
+              Assert::IsTrue(b + a == b + RLL(a) && b * a == b * RLL(a));
+            }
+
+      // Compound assignment from a narrower Rational, and the result types
+      Rint x(1, 3);
+      x += Rshort(1, 6);
+      Assert::IsTrue(x == Rint(1, 2));
+      x -= Rshort(-3, 4);
+      x *= Rshort(4, 3);
+      x /= Rshort(-5, 9);
+      Assert::IsTrue(x == Rint(-3));
+      Assert::IsTrue((is_same<decltype(Rshort(1) + Rint(1)), Rint>::value));
+      Assert::IsTrue((is_same<decltype(Rint(1) / Rshort(1)), Rint>::value));
+
+      // Unsigned with signed: the result type holds both ranges
+      Rational<unsigned> u(UINT_MAX, 2);
+      Rint s(-1, 3);
+      Assert::IsTrue(u + s == RLL(UINT_MAX, 2) + RLL(-1, 3));
+      Assert::IsTrue(u * s == RLL(-(long long) UINT_MAX, 6));
+      RLL y(u);
+      y -= s;
+      Assert::IsTrue(y == RLL(3LL * UINT_MAX + 2, 6));
+    }
+
+    TEST_METHOD(ContinuedFractions)
+    {
+      // 415/93 = [4; 2, 6, 7], -7/3 = [-3; 1, 2], integers have one quotient
+      vector<int> quotients;
+      for (int a : Quotients(Rint(415, 93)))
+        quotients.push_back(a);
+      Assert::IsTrue(quotients == vector<int>({ 4, 2, 6, 7 }));
+      quotients.clear();
+      for (int a : Quotients(Rint(-7, 3)))
+        quotients.push_back(a);
+      Assert::IsTrue(quotients == vector<int>({ -3, 1, 2 }));
+      Assert::IsTrue(*Quotients(Rint(5)).begin() == 5 && ++Quotients(Rint(5)).begin() == Quotients(Rint(5)).end());
+      Assert::IsTrue(*Quotients(Rint(0)).begin() == 0);
+
+      // 355/113 = [3; 7, 16]
+      vector<Rint> convergents(Convergents(Rint(355, 113)).begin(), Convergents(Rint(355, 113)).end());
+      Assert::IsTrue(convergents == vector<Rint>({ Rint(3), Rint(22, 7), Rint(355, 113) }));
+      Assert::IsTrue(Convergents(Rint(355, 113)).begin().Quotient() == 3);
+
+      // Round trips, down to the extremes of the range
+      int values[] = { 0, 1, -1, 2, -3, 7, 13, -64, 1000, 65537, INT_MAX, -INT_MAX };
+      for (int n : values)
+        for (int d : values) {
+          if (d == 0)
+            continue;
+          Rint r(n, d), last;
+          auto q = Quotients(r);
+          Assert::IsTrue((FromContinuedFraction<int>(q.begin(), q.end()) == r));
+          for (const Rint& c : Convergents(r))
+            last = c;
+          Assert::IsTrue(last == r);
+        }
+      BigRational big(BigInt("314159265358979323846264338327950288419716939937510"),
+                      BigInt("100000000000000000000000000000000000000000000000000"));
+      auto bigQuotients = Quotients(big);
+      Assert::IsTrue(*bigQuotients.begin() == 3 &&
+        (FromContinuedFraction<BigInt>(bigQuotients.begin(), bigQuotients.end()) == big));
+
+      // From a stream, one quotient at a time
+      istringstream stream("3 7 15 1");
+      Assert::IsTrue((FromContinuedFraction<int>(istream_iterator<int>(stream), istream_iterator<int>()) == Rint(355, 113)));
+      ContinuedFractionBuilder<short> builder;
+      Assert::IsTrue(builder.Empty() && builder.Value() == 0);
+      Assert::IsTrue(builder.Push(1) == 1 && builder.Push(1) == 2 && builder.Push(2) == Rshort(5, 3));
+
+      // Quotients after the first must be positive, and the value must fit
+      int failures = 0;
+      try { builder.Push(0); } catch (const invalid_argument&) { ++failures; }
+      try { builder.Push(SHRT_MAX); } catch (const overflow_error&) { ++failures; }
+      Assert::IsTrue(failures == 2 && builder.Value() == Rshort(5, 3));
+#ifdef RATIONAL_HAS_INT128
+      // No wider type to compute the convergents in
+      typedef IntTraits::Int128 Int128;
+      ContinuedFractionBuilder<Int128> wide;
+      wide.Push(Int128(1) << 120);
+      try { wide.Push(Int128(1) << 120); } catch (const overflow_error&) { ++failures; }
+      try { wide.Push(Int128(1) << 120); } catch (const overflow_error&) { ++failures; }
+      Assert::IsTrue(failures == 4 && wide.Value() == Rational<Int128>(Int128(1) << 120));
+#endif
+    }
+
+    TEST_METHOD(Sort)
+    {
+      // Against stable_sort with operator<, over a few types and threads
+      mt19937_64 random(11);
+      vector<Rint> ints;
+      for (int i = 0; i < 300000; ++i) {
+        int d = int(random() % 3 ? random() % 12 + 1 : random() % INT_MAX + 1);
+        ints.push_back(Rint(int(random() % 2001) - 1000 + (i % 7 ? 0 : INT_MAX / 2), d));
+      }
+      // Closer than 2^-32, so with the same key, and out of order
+      ints.push_back(Rint(INT_MAX - 1, INT_MAX - 2));
+      ints.push_back(Rint(INT_MAX, INT_MAX - 1));
+      ints.push_back(Rint(-INT_MAX, 1));
+      vector<Rint> expected = ints, sorted = ints;
+      stable_sort(expected.begin(), expected.end());
+      SortRationals(sorted, 1);
+      Assert::IsTrue(sorted == expected);
+      sorted = ints;
+      SortRationals(sorted, 4);
+      Assert::IsTrue(sorted == expected);
+
+      RationalVector<int> columns(ints.begin(), ints.end());
+      SortRationals(columns);
+      Assert::IsTrue(columns[0] == -INT_MAX && columns[ints.size() - 1] == expected.back() &&
+                     columns[1000] == expected[1000]);
+
+      // Wider types are sorted by comparison
+      vector<RLL> longs = { RLL(LLONG_MAX - 1, LLONG_MAX), RLL(1, 3), RLL(LLONG_MAX - 2, LLONG_MAX - 1),
+                            RLL(-5), RLL(LLONG_MAX, 2), RLL(LLONG_MAX - 3, LLONG_MAX - 2), RLL(1, 3) };
+      vector<RLL> expectedLongs = longs;
+      stable_sort(expectedLongs.begin(), expectedLongs.end());
+      SortRationals(longs);
+      Assert::IsTrue(longs == expectedLongs);
+
+      vector<Rshort> shorts;
+      for (int i = 0; i < 1000; ++i)
+        shorts.push_back(Rshort(short(int(random() % 65535) - 32767), short(random() % 32767 + 1)));
+      vector<Rshort> expectedShorts = shorts;
+      stable_sort(expectedShorts.begin(), expectedShorts.end());
+      SortRationals(AsRationals(reinterpret_cast<short*>(shorts.data()), shorts.size()));
+      Assert::IsTrue(shorts == expectedShorts);
+
+      vector<Rational<unsigned> > unsigneds = { Rational<unsigned>(UINT_MAX, 2), Rational<unsigned>(0),
+                                                Rational<unsigned>(1, UINT_MAX), Rational<unsigned>(2, UINT_MAX) };
+      SortRationals(unsigneds);
+      Assert::IsTrue(unsigneds[0] == 0u && unsigneds[1] == Rational<unsigned>(1, UINT_MAX) &&
+                     unsigneds[3] == Rational<unsigned>(UINT_MAX, 2));
+
+      vector<BigRational> bigs = { BigRational(2, 3), BigRational(-1), BigRational(1, 2) };
+      SortRationals(bigs);
+      Assert::IsTrue(bigs[0] == -1 && bigs[2] == BigRational(2, 3));
+      vector<Rint> empty;
+      SortRationals(empty);
+      Assert::IsTrue(empty.empty());
+    }
+
 	};
 }
\ No newline at end of file